@@ -5,7 +5,7 @@ set BUILD_TOOLS=true
 set PREPROCESS_CODE=true
 set BAKE_ASSETS=true
 
-:: Possible graphics apis: OPEN_GL, DX12(Todo)
+:: Possible graphics apis: OPEN_GL, NULL_GPU (no gpu, records commands), DX12(Todo)
 set GFX_API=OPEN_GL
 
 set BIN_DIR=run_tree/bin/
@@ -42,6 +42,9 @@ if %BUILD_TOOLS% == true (
       
    cl %COMPILER_FLAGS% src/tools/asset_baker.cpp ^
       -link %LINKER_FLAGS% -SUBSYSTEM:Console -Out:run_tree/asset_baker.exe
+
+   cl %COMPILER_FLAGS% src/tools/replay.cpp ^
+      -link %LINKER_FLAGS% -SUBSYSTEM:Console -Out:run_tree/replay.exe
 )
 
 if %PREPROCESS_CODE% == true (
@@ -83,6 +83,34 @@ s64 cstring_compare(const char *a, const char *b, u64 n) {
     return n == 0 ? 0 : (*(u8 *)a - *(u8 *)b);
 }
 
+u32 utf8_next(const u8 *data, u64 size, u64 *i) {
+    const u8 lead = data[*i];
+    
+    u32 count = 0, codepoint = 0, min = 0;
+    if      (lead < 0x80)           { *i += 1; return lead; }
+    else if ((lead & 0xE0) == 0xC0) { count = 1; codepoint = lead & 0x1F; min = 0x80;    }
+    else if ((lead & 0xF0) == 0xE0) { count = 2; codepoint = lead & 0x0F; min = 0x800;   }
+    else if ((lead & 0xF8) == 0xF0) { count = 3; codepoint = lead & 0x07; min = 0x10000; }
+    else { *i += 1; return UTF8_REPLACEMENT; }
+
+    if (*i + count >= size) { *i += 1; return UTF8_REPLACEMENT; }
+
+    for (u32 j = 1; j <= count; ++j) {
+        const u8 c = data[*i + j];
+        if ((c & 0xC0) != 0x80) { *i += 1; return UTF8_REPLACEMENT; }
+        codepoint = (codepoint << 6) | (c & 0x3F);
+    }
+
+    // Overlong encodings, surrogates and out of range values are not valid.
+    if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        *i += 1;
+        return UTF8_REPLACEMENT;
+    }
+    
+    *i += count + 1;
+    return codepoint;
+}
+
 f32 Floor(f32 f) {
 #if 0
     f32 t = (f32) (int) value;
@@ -134,6 +162,10 @@ f32 Log2(f32 f) {
     return log2f(f);
 }
 
+f32 Pow(f32 b, f32 e) {
+    return powf(b, e);
+}
+
 f32 Sin (f32 r) { return sinf(r); }
 f32 Cos (f32 r) { return cosf(r); }
 f32 Tan (f32 r) { return tanf(r); }
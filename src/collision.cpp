@@ -2,6 +2,9 @@
 #include "collision.h"
 #include "profile.h"
 #include "viewport.h"
+#include "matrix.h"
+
+#include <intrin.h>
 
 bool overlap(AABB a, AABB b) {
     if (Abs(a.c.x - b.c.x) >= (a.r.x + b.r.x)) return false;
@@ -42,6 +45,125 @@ bool inside(Vector2 point, Vector2 p0, Vector2 p1) {
     return point.x > x0 && point.x < x1 && point.y > y0 && point.y < y1;
 }
 
+bool inside(AABB b, const Frustum &f) {
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+        const auto &p = f.planes[i];
+        const auto d = p.x * b.c.x + p.y * b.c.y + p.z * b.c.z + p.w;
+        const auto r = Abs(p.x) * b.r.x + Abs(p.y) * b.r.y + Abs(p.z) * b.r.z;
+        if (d + r < 0.0f) return false;
+    }
+    
+    return true;
+}
+
+Frustum make_frustum(const Matrix4 &view_proj) {
+    return make_frustum(view_proj, -1.0f, -1.0f, 1.0f, 1.0f);
+}
+
+Frustum make_frustum(const Matrix4 &view_proj, f32 x0, f32 y0, f32 x1, f32 y1) {
+    // Points are transformed as row vectors (p * view_proj), so clip space coords
+    // are dot products of point with matrix columns and planes are column sums,
+    // side planes keep x / w and y / w within given rect.
+    const auto &m = view_proj;
+    const auto col = [&m] (s32 j) { return Vector4(m[0][j], m[1][j], m[2][j], m[3][j]); };
+
+    const auto x = col(0);
+    const auto y = col(1);
+    const auto z = col(2);
+    const auto w = col(3);
+    
+    Frustum f;
+    f.planes[FRUSTUM_PLANE_LEFT]   = x - w * x0;
+    f.planes[FRUSTUM_PLANE_RIGHT]  = w * x1 - x;
+    f.planes[FRUSTUM_PLANE_BOTTOM] = y - w * y0;
+    f.planes[FRUSTUM_PLANE_TOP]    = w * y1 - y;
+    f.planes[FRUSTUM_PLANE_NEAR]   = w + z;
+    f.planes[FRUSTUM_PLANE_FAR]    = w - z;
+
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+        auto &p = f.planes[i];
+        const auto len = Sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        if (len > 0.0f) p = p / len;
+    }
+
+    return f;
+}
+
+u32 cull_frustum(const Frustum &f, const AABB *aabbs, u32 count, u32 *visible_indices) {
+    Profile_Zone(__func__);
+
+    const auto sign_mask = _mm_set1_ps(-0.0f);
+    const auto zero      = _mm_setzero_ps();
+
+    __m128 px[FRUSTUM_PLANE_COUNT], py[FRUSTUM_PLANE_COUNT], pz[FRUSTUM_PLANE_COUNT], pw[FRUSTUM_PLANE_COUNT];
+    __m128 ax[FRUSTUM_PLANE_COUNT], ay[FRUSTUM_PLANE_COUNT], az[FRUSTUM_PLANE_COUNT];
+    for (u32 i = 0; i < FRUSTUM_PLANE_COUNT; ++i) {
+        const auto &p = f.planes[i];
+        px[i] = _mm_set1_ps(p.x);
+        py[i] = _mm_set1_ps(p.y);
+        pz[i] = _mm_set1_ps(p.z);
+        pw[i] = _mm_set1_ps(p.w);
+        ax[i] = _mm_andnot_ps(sign_mask, px[i]);
+        ay[i] = _mm_andnot_ps(sign_mask, py[i]);
+        az[i] = _mm_andnot_ps(sign_mask, pz[i]);
+    }
+    
+    u32 visible_count = 0;
+    u32 i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        const auto *a = aabbs + i;
+        
+        const auto cx = _mm_setr_ps(a[0].c.x, a[1].c.x, a[2].c.x, a[3].c.x);
+        const auto cy = _mm_setr_ps(a[0].c.y, a[1].c.y, a[2].c.y, a[3].c.y);
+        const auto cz = _mm_setr_ps(a[0].c.z, a[1].c.z, a[2].c.z, a[3].c.z);
+        const auto rx = _mm_setr_ps(a[0].r.x, a[1].r.x, a[2].r.x, a[3].r.x);
+        const auto ry = _mm_setr_ps(a[0].r.y, a[1].r.y, a[2].r.y, a[3].r.y);
+        const auto rz = _mm_setr_ps(a[0].r.z, a[1].r.z, a[2].r.z, a[3].r.z);
+
+        // Box is outside if its center is farther behind any plane than its
+        // extent projected onto plane normal.
+        auto outside = _mm_setzero_ps();
+        for (u32 j = 0; j < FRUSTUM_PLANE_COUNT; ++j) {
+            auto d = _mm_add_ps(_mm_mul_ps(px[j], cx), pw[j]);
+            d = _mm_add_ps(d, _mm_mul_ps(py[j], cy));
+            d = _mm_add_ps(d, _mm_mul_ps(pz[j], cz));
+
+            auto r = _mm_mul_ps(ax[j], rx);
+            r = _mm_add_ps(r, _mm_mul_ps(ay[j], ry));
+            r = _mm_add_ps(r, _mm_mul_ps(az[j], rz));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+        }
+
+        // Branchless compaction, index is always written and count is advanced
+        // only for visible lanes, written slot never exceeds current index.
+        const u32 mask = ~(u32)_mm_movemask_ps(outside) & 0xF;
+        visible_indices[visible_count] = i + 0; visible_count += (mask >> 0) & 1;
+        visible_indices[visible_count] = i + 1; visible_count += (mask >> 1) & 1;
+        visible_indices[visible_count] = i + 2; visible_count += (mask >> 2) & 1;
+        visible_indices[visible_count] = i + 3; visible_count += (mask >> 3) & 1;
+    }
+
+    for (; i < count; ++i) {
+        if (inside(aabbs[i], f)) {
+            visible_indices[visible_count] = i;
+            visible_count += 1;
+        }
+    }
+
+    return visible_count;
+}
+
+AABB transform_aabb(const AABB &b, const Matrix4 &m) {
+    AABB result;
+    for (s32 j = 0; j < 3; ++j) {
+        result.c[j] = b.c.x * m[0][j] + b.c.y * m[1][j] + b.c.z * m[2][j] + m[3][j];
+        result.r[j] = b.r.x * Abs(m[0][j]) + b.r.y * Abs(m[1][j]) + b.r.z * Abs(m[2][j]);
+    }
+    return result;
+}
+
 // bool overlap(Ray ray, AABB aabb, f32 *near_distance) {
 //     f32 tmin = 0.0f;
 //     f32 tmax = F32_MAX;
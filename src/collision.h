@@ -3,6 +3,7 @@
 struct Camera;
 struct Viewport;
 struct Entity;
+struct Matrix4;
 
 struct Collision_Result {
     bool    hit  = false;
@@ -25,6 +26,22 @@ struct Ray {
     Vector3 direction;
 };
 
+// Planes are stored as (normal, distance) with normals pointing inside, so point is
+// inside frustum if dot(normal, p) + distance >= 0 for all planes.
+enum Frustum_Plane : u8 {
+    FRUSTUM_PLANE_LEFT,
+    FRUSTUM_PLANE_RIGHT,
+    FRUSTUM_PLANE_BOTTOM,
+    FRUSTUM_PLANE_TOP,
+    FRUSTUM_PLANE_NEAR,
+    FRUSTUM_PLANE_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+struct Frustum {
+    Vector4 planes[FRUSTUM_PLANE_COUNT];
+};
+
 bool overlap (AABB a, AABB b);
 bool overlap (Sphere a, Sphere b);
 bool overlap (Sphere s, AABB b);
@@ -32,6 +49,20 @@ bool overlap (Ray r, AABB b, f32 *n = null);
 bool inside  (Vector3 p, AABB b);
 bool inside  (Vector3 p, Sphere s);
 bool inside  (Vector2 p, Vector2 p0, Vector2 p1);
+bool inside  (AABB b, const Frustum &f); // true if aabb is at least partially inside
+
+Frustum make_frustum (const Matrix4 &view_proj);
+
+// Bounds of transformed aabb, points are transformed as row vectors (p * m).
+AABB transform_aabb (const AABB &b, const Matrix4 &m);
+
+// Frustum of ndc rect of view projection, make_frustum is the one of [-1, 1] rect.
+Frustum make_frustum (const Matrix4 &view_proj, f32 x0, f32 y0, f32 x1, f32 y1);
+
+// Test aabbs against frustum 4 at a time using sse and write indices of visible
+// ones to visible_indices, which should have space for count items.
+// Return visible aabb count.
+u32 cull_frustum (const Frustum &f, const AABB *aabbs, u32 count, u32 *visible_indices);
 
 Ray ray_from_mouse (const Camera &camera, const Viewport &viewport, s16 x, s16 y);
 
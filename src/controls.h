@@ -10,8 +10,10 @@ inline constexpr auto KEY_SWITCH_PROFILER_VIEW  = KEY_V;
 inline constexpr auto KEY_SWITCH_EDITOR_MODE    = KEY_F11;
 inline constexpr auto KEY_SWITCH_POLYGON_MODE   = KEY_F1;
 inline constexpr auto KEY_SWITCH_COLLISION_VIEW = KEY_F2;
+inline constexpr auto KEY_SWITCH_OCCLUSION_VIEW = KEY_F3;
 inline constexpr auto KEY_SAVE_LEVEL            = KEY_S;
 inline constexpr auto KEY_RELOAD_LEVEL          = KEY_R;
 inline constexpr auto KEY_SWITCH_VSYNC          = KEY_V;
 inline constexpr auto KEY_SELECT_ENTITY         = MOUSE_LEFT;
 inline constexpr auto KEY_UNSELECT_ENTITY       = MOUSE_RIGHT;
+inline constexpr auto KEY_TOGGLE_OCCLUDER       = KEY_O;
@@ -4,10 +4,20 @@
 
 inline const auto CONSOLE_CMD_UNKNOWN_WARNING = S("unknown command: ");
 
-inline const auto CONSOLE_CMD_CLEAR       = S("clear");
-inline const auto CONSOLE_CMD_LEVEL       = S("level");
-inline const auto CONSOLE_CMD_USAGE_CLEAR = S("usage: clear");
-inline const auto CONSOLE_CMD_USAGE_LEVEL = S("usage: level name_with_extension");
+inline const auto CONSOLE_CMD_CLEAR            = S("clear");
+inline const auto CONSOLE_CMD_LEVEL            = S("level");
+inline const auto CONSOLE_CMD_BENCH_SORT       = S("bench_sort");
+inline const auto CONSOLE_CMD_BENCH_OCCLUSION  = S("bench_occlusion");
+inline const auto CONSOLE_CMD_CHECK_RING       = S("check_ring");
+inline const auto CONSOLE_CMD_CHECK_GRAPH      = S("check_graph");
+inline const auto CONSOLE_CMD_CHECK_PORTALS    = S("check_portals");
+inline const auto CONSOLE_CMD_ADD_CELL         = S("add_cell");
+inline const auto CONSOLE_CMD_ADD_PORTAL       = S("add_portal");
+inline const auto CONSOLE_CMD_CAPTURE_GPU      = S("capture_gpu");
+inline const auto CONSOLE_CMD_USAGE_CLEAR      = S("usage: clear");
+inline const auto CONSOLE_CMD_USAGE_LEVEL      = S("usage: level name_with_extension");
+inline const auto CONSOLE_CMD_USAGE_ADD_CELL   = S("usage: add_cell half_x half_y half_z");
+inline const auto CONSOLE_CMD_USAGE_ADD_PORTAL = S("usage: add_portal half_x half_y half_z");
 
 struct Window_Event;
 
@@ -13,6 +13,8 @@
 #include "ui.h"
 #include "viewport.h"
 #include "render_frame.h"
+#include "gpu_capture.h"
+#include "gpu_heap.h"
 #include "triangle_mesh.h"
 #include "shader.h"
 #include "texture.h"
@@ -21,6 +23,7 @@
 #include "profile.h"
 #include "font.h"
 #include "collision.h"
+#include "ring_buffer.h"
 #include "stb_image.h"
 #include "stb_sprintf.h"
 #include <algorithm>
@@ -549,6 +552,10 @@ void update_editor() {
         //         e->position += move_speed * dt * direction;
         //     }
         // }
+
+        // if (e->type == E_STATIC_MESH && (down(KEY_LEFT) || down(KEY_RIGHT) || down(KEY_UP) || down(KEY_DOWN))) {
+        //     invalidate_static_render_list();
+        // }
     } else {
         // @Cleanup: more like a temp hack, clear ui hot id if we are not in editor.
         ui.id_hot = UIID_NONE;
@@ -602,67 +609,39 @@ void update_editor() {
     }
 }
 
-static void cb_queue_for_hot_reload(const File_Callback_Data *data) {    
-    Assert(data->user_data);
-    auto catalog = (Hot_Reload_Catalog *)data->user_data;
-
-    // @Cleanup @Robustness: we allocate path in temp storage in hot reload thread, this
-    // data will be passed to main thread during hot reload check which may lead to bugs.
-    auto path  = copy_string(data->path, __temporary_allocator);
-    auto entry = find_by_path(&catalog->catalog, path);
-    
-    if (entry && entry->last_write_time != data->last_write_time) {
-        array_add(catalog->paths_to_hot_reload, path);
-        entry->last_write_time = data->last_write_time;
-    }
-}
-
-static u32 proc_hot_reload(void *data) {    
-    Assert(data);
-    auto catalog = (Hot_Reload_Catalog *)data;
-
-    while (1) {
-        reset_temporary_storage();
-
-        if (catalog->paths_to_hot_reload.count == 0) {
-            For (catalog->directories) {
-                visit_directory(it, cb_queue_for_hot_reload, true, catalog);
-            }
-        }
-        
-        if (catalog->paths_to_hot_reload.count > 0) {
-            release_semaphore(catalog->semaphore, 1);
-        }
-    }
-}
-
 static Hot_Reload_Catalog *hot_reload = null;
 
 void init_hot_reload() {
     Assert(!hot_reload);
     hot_reload = New(Hot_Reload_Catalog);
-    array_realloc(hot_reload->paths_to_hot_reload, 16);
+    hot_reload->watcher = create_file_watcher();
 }
 
 Thread start_hot_reload_thread() {
-    hot_reload->semaphore = create_semaphore(0, 1);
-    return create_thread(proc_hot_reload, 0, hot_reload);
+    return start_file_watcher(hot_reload->watcher);
+}
+
+void stop_hot_reload() {
+    destroy_file_watcher(hot_reload->watcher);
 }
 
 void add_hot_reload_directory(String path) {
     array_add(hot_reload->directories, path);
     add_directory_files(&hot_reload->catalog, path);
+    add_file_watch(hot_reload->watcher, path);
 	log("Hot reload directory %S", path);
 }
 
 void update_hot_reload() {
     Profile_Zone(__func__);
 
-    if (hot_reload->paths_to_hot_reload.count == 0) return;
-
-    wait_semaphore(hot_reload->semaphore, WAIT_INFINITE);
+    Array <String> paths = { .allocator = __temporary_allocator };
+    if (!poll_file_watcher(hot_reload->watcher, paths, __temporary_allocator)) return;
 
-    For (hot_reload->paths_to_hot_reload) {
+    For (paths) {
+        // Only files that were present on startup are reloaded.
+        if (!find_by_path(&hot_reload->catalog, it)) continue;
+        
         START_TIMER(0);
         
         const auto ext = get_extension(it);
@@ -672,26 +651,409 @@ void update_hot_reload() {
             // Ensure we have fresh slang session for proper hot reload.
             init_slang_local_session();
             new_shader(it);
+            resolve_entity_constant_handles();
         } else if (is_texture_path(it)) {
             new_texture(it);
         } else if (ext == FLIP_BOOK_EXT) {
             new_flip_book(it);
         } else if (ext == MATERIAL_EXT) {
             new_material(it);
+        } else if (ext == OBJ_EXT) {
+            new_mesh(it);
         } else {
             success = false;
         }
 
-        if (success) log("Hot reloaded %S %.2fms", it, CHECK_TIMER_MS(0));
+        if (success) {
+            // Static render list keeps shaders, textures and cbuffers of materials.
+            invalidate_static_render_list();
+            log("Hot reloaded %S %.2fms", it, CHECK_TIMER_MS(0));
+        }
     }
-    
-    array_clear(hot_reload->paths_to_hot_reload);
 }
 
 // console
 
 static Console console;
 
+// Console benchmarks and self-checks log each failed condition with their name and
+// end with one summary line, which is an error if any condition failed.
+struct Console_Check {
+    const char *name   = null;
+    u32         errors = 0;
+};
+
+typedef void (*Console_Check_Proc)();
+
+static void console_check(Console_Check *c, bool condition, String what) {
+    if (condition) return;
+    add_to_console_history(LOG_ERROR, tprint("%s: %S", c->name, what));
+    c->errors += 1;
+}
+
+static void console_check_report(const Console_Check *c, String summary) {
+    add_to_console_history(c->errors ? LOG_ERROR : LOG_DEFAULT,
+                           tprint("%S%S", summary, c->errors ? tprint(", %u CHECKS FAILED", c->errors) : S("")));
+}
+
+// Compare render batch entry radix sort with std::stable_sort on keys that look
+// like real ones: few materials with random depth in one viewport.
+static void bench_render_batch_sort() {
+    const u32 counts[] = { 1000, 10000, 100000 };
+
+    for (const u32 count : counts) {
+        const u64 size = count * sizeof(Render_Batch_Entry);
+        auto a = (Render_Batch_Entry *)alloc(size, __temporary_allocator);
+        auto b = (Render_Batch_Entry *)alloc(size, __temporary_allocator);
+
+        for (u32 i = 0; i < count; ++i) {
+            const u64 material = hash_pcg(i) % 64;
+            const u64 depth    = hash_pcg(i + count) % (1u << RENDER_KEY_DEPTH_BITS);
+
+            auto &entry = a[i];
+            entry.render_key._u64 = make_render_key(SCREEN_GAME_LAYER, 0, VIEWPORT_GAME_LAYER, NOT_TRANSLUCENT, false, depth, material);
+            entry.primitive = (Render_Primitive *)(u64)(i + 1); // original order to check stability
+        }
+
+        copy(b, a, size);
+
+        START_TIMER(radix);
+        radix_sort(a, count);
+        const f32 radix_ms = CHECK_TIMER_MS(radix);
+
+        START_TIMER(std);
+        std::stable_sort(b, b + count);
+        const f32 std_ms = CHECK_TIMER_MS(std);
+
+        bool same = true;
+        for (u32 i = 0; i < count; ++i) {
+            if (a[i].render_key._u64 != b[i].render_key._u64 || a[i].primitive != b[i].primitive) {
+                same = false;
+                break;
+            }
+        }
+
+        Console_Check c = { "sort" };
+        console_check(&c, same, S("radix and std::stable_sort order must match"));
+        console_check_report(&c, tprint("sort %u entries: radix %.3fms, std::stable_sort %.3fms", count, radix_ms, std_ms));
+    }
+}
+
+// Rasterize random boxes in front of camera with simd and reference rasterizers,
+// check that their depth buffers match and test random aabbs against result.
+static void bench_occlusion() {
+    constexpr u32 AABB_COUNT = 10000;
+    
+    const Vector3 cube_positions[8] = {
+        Vector3(-1, -1, -1), Vector3( 1, -1, -1), Vector3( 1,  1, -1), Vector3(-1,  1, -1),
+        Vector3(-1, -1,  1), Vector3( 1, -1,  1), Vector3( 1,  1,  1), Vector3(-1,  1,  1),
+    };
+    
+    const u32 cube_indices[36] = {
+        0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+        3, 7, 6, 3, 6, 2, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5,
+    };
+
+    const auto random = [] (u32 seed, f32 min, f32 max) {
+        return min + (max - min) * (f32)(hash_pcg(seed) & 0xFFFFFF) / (f32)0xFFFFFF;
+    };
+    
+    const auto view      = make_view(Vector3_zero, Vector3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 1.0f, 0.0f));
+    const auto proj      = make_perspective(To_Radians(60.0f), 2.0f, 0.1f, 200.0f);
+    const auto view_proj = view * proj;
+
+    auto simd      = New(Occlusion_Buffer);
+    auto reference = New(Occlusion_Buffer);
+    
+    auto aabbs   = New(AABB, AABB_COUNT, __temporary_allocator);
+    auto indices = New(u32,  AABB_COUNT, __temporary_allocator);
+
+    for (u32 i = 0; i < AABB_COUNT; ++i) {
+        const auto c = Vector3(random(3 * i + 0, -80.0f, 80.0f), random(3 * i + 1, -40.0f, 40.0f), random(3 * i + 2, -150.0f, -5.0f));
+        aabbs[i] = make_aabb(c, Vector3(random(i, 0.2f, 2.0f)));
+    }
+    
+    const u32 counts[] = { 16, 64, 256 };
+
+    for (const u32 count : counts) {
+        auto transforms = New(Matrix4, count, __temporary_allocator);
+        for (u32 i = 0; i < count; ++i) {
+            const u32 seed = AABB_COUNT + 6 * i;
+            const auto pos   = Vector3(random(seed + 0, -30.0f, 30.0f), random(seed + 1, -15.0f, 15.0f), random(seed + 2, -60.0f, -10.0f));
+            const auto scale = Vector3(random(seed + 3, 0.5f, 4.0f), random(seed + 4, 0.5f, 4.0f), random(seed + 5, 0.5f, 4.0f));
+            transforms[i] = make_transform(pos, Quaternion(), scale);
+        }
+
+        START_TIMER(simd);
+        begin_occlusion(simd, view_proj);
+        for (u32 i = 0; i < count; ++i) {
+            draw_occluder(simd, transforms[i], cube_positions, cube_indices, carray_count(cube_indices));
+        }
+        end_occlusion(simd);
+        const f32 simd_ms = CHECK_TIMER_MS(simd);
+
+        START_TIMER(reference);
+        begin_occlusion(reference, view_proj);
+        for (u32 i = 0; i < count; ++i) {
+            draw_occluder_reference(reference, transforms[i], cube_positions, cube_indices, carray_count(cube_indices));
+        }
+        end_occlusion(reference);
+        const f32 reference_ms = CHECK_TIMER_MS(reference);
+
+        u32 mismatch_count = 0;
+        const auto a = get_occlusion_level(simd, 0);
+        const auto b = get_occlusion_level(reference, 0);
+        for (u32 i = 0; i < Occlusion_Buffer::WIDTH * Occlusion_Buffer::HEIGHT; ++i) {
+            mismatch_count += a[i] != b[i];
+        }
+
+        for (u32 i = 0; i < AABB_COUNT; ++i) indices[i] = i;
+        
+        START_TIMER(test);
+        const u32 visible_count = cull_occlusion(simd, aabbs, indices, AABB_COUNT);
+        const f32 test_ms = CHECK_TIMER_MS(test);
+
+        Console_Check c = { "occlusion" };
+        console_check(&c, mismatch_count == 0, tprint("%u pixels of simd and reference depth differ", mismatch_count));
+        console_check_report(&c, tprint("occlusion %u occluders: simd %.3fms, reference %.3fms, %u aabbs tested %.3fms, %u occluded",
+                                        count, simd_ms, reference_ms, AABB_COUNT, test_ms, AABB_COUNT - visible_count));
+    }
+
+    Delete(simd);
+    Delete(reference);
+}
+
+// Push variable sized records through a small ring many times around, so writes and
+// reads keep crossing its end, and check that mirrored memory reads them back intact.
+static void check_ring_buffer() {
+    constexpr u32 RECORD_COUNT = 100000;
+    
+    Console_Check c = { "ring" };
+    
+    Ring_Buffer ring;
+    if (!init(&ring, get_allocation_granularity())) {
+        console_check(&c, false, S("failed to init"));
+        return;
+    }
+
+    u32 written  = 0;
+    u32 read     = 0;
+    u32 wrapped  = 0;
+    u32 mismatch = 0;
+
+    START_TIMER(ring);
+    while (read < RECORD_COUNT) {
+        while (written < RECORD_COUNT) {
+            const u32 size  = 4 + 4 * (hash_pcg(written) % 1024);
+            const auto write = reserve_write(&ring, size);
+            if (!write.data) break;
+
+            auto values = (u32 *)write.data;
+            values[0] = size;
+            for (u32 i = 1; i < size / 4; ++i) values[i] = written + i;
+
+            const u64 start = write.offset & (ring.size - 1);
+            wrapped += start + size > ring.size;
+            
+            commit_write(&ring, write);
+            written += 1;
+        }
+
+        u64 size = 0;
+        auto data = peek_read(&ring, &size);
+        while (size) {
+            const auto values = (u32 *)data;
+            const u32 record_size = values[0];
+            mismatch += record_size != 4 + 4 * (hash_pcg(read) % 1024);
+            for (u32 i = 1; i < record_size / 4; ++i) mismatch += values[i] != read + i;
+
+            commit_read(&ring, record_size);
+            data += record_size;
+            size -= record_size;
+            read += 1;
+        }
+    }
+    const f32 ring_ms = CHECK_TIMER_MS(ring);
+
+    release(&ring);
+    release(&ring); // second release must be a no-op
+    
+    console_check(&c, mismatch == 0, tprint("%u values read back differ from written ones", mismatch));
+    console_check_report(&c, tprint("ring %llu bytes: %u records, %u wrapped, %.3fms",
+                                    get_allocation_granularity(), RECORD_COUNT, wrapped, ring_ms));
+}
+
+// Compile small fixed render graph and check that unread pass is culled, barrier is
+// placed after storage write only and targets with disjoint lifetimes share pooled
+// framebuffers. Compile does not touch gpu, so graph is never executed.
+static void check_render_graph() {
+    Render_Graph graph;
+    graph.physicals.allocator = __temporary_allocator;
+    
+    begin_render_graph(&graph);
+
+    Render_Target_Desc desc;
+    desc.width        = 256;
+    desc.height       = 256;
+    desc.color_format = GPU_IMAGE_FORMAT_RGBA_8;
+
+    const u32 backbuffer = import_render_target(&graph, S("backbuffer"), 0);
+    const u32 shadow     = create_render_target(&graph, S("shadow"), desc);
+    const u32 scene      = create_render_target(&graph, S("scene"),  desc);
+    const u32 debug      = create_render_target(&graph, S("debug"),  desc);
+    const u32 bloom      = create_render_target(&graph, S("bloom"),  desc);
+    const u32 tonemap    = create_render_target(&graph, S("tonemap"), desc);
+
+    const u32 shadow_pass  = add_render_pass(&graph, S("shadow"),  null);
+    const u32 scene_pass   = add_render_pass(&graph, S("scene"),   null);
+    const u32 debug_pass   = add_render_pass(&graph, S("debug"),   null);
+    const u32 bloom_pass   = add_render_pass(&graph, S("bloom"),   null);
+    const u32 tonemap_pass = add_render_pass(&graph, S("tonemap"), null);
+    const u32 present_pass = add_render_pass(&graph, S("present"), null);
+
+    write_render_target(&graph, shadow_pass,  shadow);
+    read_render_target (&graph, scene_pass,   shadow);
+    write_render_target(&graph, scene_pass,   scene);
+    write_render_target(&graph, debug_pass,   debug); // never read
+    read_render_target (&graph, bloom_pass,   scene);
+    write_render_target(&graph, bloom_pass,   bloom, RENDER_GRAPH_ACCESS_STORAGE);
+    read_render_target (&graph, tonemap_pass, bloom);
+    write_render_target(&graph, tonemap_pass, tonemap);
+    read_render_target (&graph, present_pass, tonemap);
+    write_render_target(&graph, present_pass, backbuffer);
+
+    compile_render_graph(&graph);
+
+    const auto &passes  = graph.passes;
+    const auto &targets = graph.targets;
+
+    Console_Check c = { "graph" };
+    console_check(&c, graph.culled_pass_count == 1 && passes[debug_pass].culled, S("only debug pass must be culled"));
+    console_check(&c, graph.order.count == 5, S("five passes must be executed"));
+    console_check(&c, graph.barrier_count == 1 && passes[tonemap_pass].barrier, S("only tonemap pass must have barrier"));
+    console_check(&c, !passes[bloom_pass].barrier, S("bloom pass must not have barrier"));
+    console_check(&c, graph.transient_target_count == 4, S("four transient targets must be used"));
+    console_check(&c, graph.physicals.count == 2, S("two pooled framebuffers must be used"));
+    console_check(&c, targets[shadow].physical == targets[bloom].physical, S("shadow and bloom must share framebuffer"));
+    console_check(&c, targets[scene].physical == targets[tonemap].physical, S("scene and tonemap must share framebuffer"));
+    console_check(&c, targets[shadow].physical != targets[scene].physical, S("shadow and scene must not share framebuffer"));
+    console_check(&c, targets[debug].physical == Render_Graph::NONE, S("target of culled pass must not be allocated"));
+    
+    console_check_report(&c, tprint("graph %u passes: %u culled, %u barriers, %u transient targets in %u framebuffers",
+                                    passes.count, graph.culled_pass_count, graph.barrier_count,
+                                    graph.transient_target_count, graph.physicals.count));
+}
+
+// Walk fixed level of three cells from camera in first one looking down -z: cell
+// behind door in front is seen only through it, door to side cell is out of view,
+// geometry outside of cells is never culled.
+static void check_portal_visibility() {
+    Entity_Manager manager;
+    manager.entities.allocator = __temporary_allocator;
+
+    const auto add_volume = [&] (Entity_Type type, Vector3 c, Vector3 r) {
+        Entity e = {};
+        e.type   = type;
+        e.aabb.c = c;
+        e.aabb.r = r;
+        array_add(manager.entities, e);
+    };
+
+    add_volume(E_CELL,   Vector3( 0.0f, 0.0f,  -5.0f), Vector3(5.0f, 3.0f, 5.0f)); // camera cell
+    add_volume(E_CELL,   Vector3( 0.0f, 0.0f, -15.0f), Vector3(5.0f, 3.0f, 5.0f)); // behind door
+    add_volume(E_CELL,   Vector3(10.0f, 0.0f,  -5.0f), Vector3(5.0f, 3.0f, 5.0f)); // to the side
+    add_volume(E_PORTAL, Vector3( 0.0f, 0.0f, -10.0f), Vector3(1.0f, 1.5f, 0.5f));
+    add_volume(E_PORTAL, Vector3( 5.0f, 0.0f,  -5.0f), Vector3(0.5f, 1.5f, 1.0f));
+
+    Camera camera;
+    camera.position  = Vector3(-3.0f, 0.0f, -2.0f);
+    camera.view_proj = make_view(camera.position, Vector3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 1.0f, 0.0f))
+                     * make_perspective(To_Radians(60.0f), 2.0f, 0.1f, 200.0f);
+
+    const AABB aabbs[] = {
+        make_aabb(Vector3( 0.0f, 0.0f,  -5.0f), Vector3(0.5f)), // in camera cell
+        make_aabb(Vector3( 0.0f, 0.0f, -15.0f), Vector3(0.5f)), // seen through door
+        make_aabb(Vector3(-4.0f, 2.0f, -18.0f), Vector3(0.3f)), // behind door wall
+        make_aabb(Vector3(10.0f, 0.0f,  -5.0f), Vector3(0.5f)), // in side cell
+        make_aabb(Vector3( 0.0f, 0.0f, -50.0f), Vector3(0.5f)), // outside of cells
+    };
+
+    constexpr u32 AABB_COUNT = carray_count(aabbs);
+    
+    u32 indices[AABB_COUNT];
+    for (u32 i = 0; i < AABB_COUNT; ++i) indices[i] = i;
+
+    Portal_Visibility visibility;
+    visibility.cells.allocator   = __temporary_allocator;
+    visibility.portals.allocator = __temporary_allocator;
+    
+    build_portal_cells(&visibility, &manager);
+    update_portal_visibility(&visibility, camera);
+    const u32 visible_count = cull_portals(&visibility, aabbs, indices, AABB_COUNT);
+
+    const auto &stats = visibility.stats;
+    
+    Console_Check c = { "portals" };
+    console_check(&c, stats.cell_count == 3 && stats.portal_count == 2, S("three cells and two portals must be built"));
+    console_check(&c, visibility.camera_cell == 0, S("camera must be in first cell"));
+    console_check(&c, stats.visible_cell_count == 2, S("side cell must not be visible"));
+    console_check(&c, visible_count == 3, S("three aabbs must be visible"));
+    console_check(&c, visible_count == 3 && indices[0] == 0 && indices[1] == 1 && indices[2] == 4,
+                  S("aabbs in camera cell, behind door and outside of cells must be visible"));
+
+    For (visibility.cells) array_reset(it.portals);
+    
+    console_check_report(&c, tprint("portals %u cells, %u portals: %u visible cells, %u/%u aabbs culled",
+                                    stats.cell_count, stats.portal_count, stats.visible_cell_count,
+                                    AABB_COUNT - visible_count, AABB_COUNT));
+}
+
+static Console_Check_Proc find_console_check(String command) {
+    struct Entry { String command; Console_Check_Proc proc; };
+    
+    static const Entry entries[] = {
+        { CONSOLE_CMD_BENCH_SORT,      bench_render_batch_sort },
+        { CONSOLE_CMD_BENCH_OCCLUSION, bench_occlusion },
+        { CONSOLE_CMD_CHECK_RING,      check_ring_buffer },
+        { CONSOLE_CMD_CHECK_GRAPH,     check_render_graph },
+        { CONSOLE_CMD_CHECK_PORTALS,   check_portal_visibility },
+    };
+
+    for (const auto &it : entries) {
+        if (it.command == command) return it.proc;
+    }
+
+    return null;
+}
+
+// Add cell or portal at camera position to current level, its volume is aabb with
+// given half extents and is saved with level like any other entity.
+static void add_portal_volume(Entity_Type type, const Array <String> &tokens) {
+    const auto usage = type == E_CELL ? CONSOLE_CMD_USAGE_ADD_CELL : CONSOLE_CMD_USAGE_ADD_PORTAL;
+    if (tokens.count != 4) {
+        add_to_console_history(usage);
+        return;
+    }
+
+    const auto r = Vector3((f32)string_to_float(tokens[1]),
+                           (f32)string_to_float(tokens[2]),
+                           (f32)string_to_float(tokens[3]));
+    if (r.x <= 0.0f || r.y <= 0.0f || r.z <= 0.0f) {
+        add_to_console_history(usage);
+        return;
+    }
+
+    auto manager = get_entity_manager();
+    auto e = New_Entity(manager, type);
+    e->position = manager->camera.position;
+    e->scale    = r * 2.0f;
+    e->aabb.c   = e->position;
+    e->aabb.r   = r;
+
+    add_to_console_history(tprint("added %s 0x%X at (%.2f %.2f %.2f)", type == E_CELL ? "cell" : "portal",
+                                  e->eid, e->position.x, e->position.y, e->position.z));
+}
+
 Console *get_console() { return &console; }
 
 void on_push_console(Program_Layer *layer) {
@@ -752,6 +1114,14 @@ bool on_event_console(Program_Layer *layer, const Window_Event *e) {
                         } else {
                             add_to_console_history(CONSOLE_CMD_USAGE_CLEAR);
                         }
+                    } else if (const auto check = find_console_check(tokens[0])) {
+                        check();
+                    } else if (tokens[0] == CONSOLE_CMD_ADD_CELL) {
+                        add_portal_volume(E_CELL, tokens);
+                    } else if (tokens[0] == CONSOLE_CMD_ADD_PORTAL) {
+                        add_portal_volume(E_PORTAL, tokens);
+                    } else if (tokens[0] == CONSOLE_CMD_CAPTURE_GPU) {
+                        request_gpu_capture();
                     } else if (tokens[0] == CONSOLE_CMD_LEVEL) {
                         if (tokens.count > 1) {   
                             //auto path = tprint("%S%S", PATH_LEVEL(""), tokens[1]);
@@ -1168,7 +1538,7 @@ void update_profiler() {
 
         p.y -= line_height * 1.5f;
 
-        const u64 hz = get_perf_hz_ms();
+        const u64 hz = get_cpu_hz_ms();
 
         auto &selected_zone_index = profiler.selected_zone_index;
         selected_zone_index = Clamp(selected_zone_index, 0, (s32)draw_order.count - 1);
@@ -1299,14 +1669,15 @@ void update_profiler() {
     case PROFILER_VIEW_MEMORY: {
         // Prepare draw data.
         
-        const String titles[3] = {
-            S("Name"), S("Used"), S("Size")
+        const String titles[4] = {
+            S("Name"), S("Used"), S("Size"), S("Pages")
         };
 
         const f32 max_lengths[carray_count(titles)] = {
             24 * space_width_px,
             10 * space_width_px,
             10 * space_width_px,
+            6  * space_width_px,
         };
 
         f32 offsets[carray_count(titles)] = { MARGIN + PADDING };
@@ -1315,21 +1686,25 @@ void update_profiler() {
         }
 
         extern Virtual_Arena virtual_arena;
+        extern Virtual_Arena overflow_virtual_arena;
         const auto &va  = virtual_arena;
+        const auto &ova = overflow_virtual_arena;
         const auto &ts  = context.temporary_storage;
         
         const struct Memory_Zone {
             String name;
             u64 used;
             u64 size;
+            bool large_pages = false;
         };
 
         const auto gpu_read_buffer  = gpu_get_buffer(gpu_read_allocator.buffer);
         const auto gpu_write_buffer = gpu_get_buffer(gpu_write_allocator.buffer);
         
         Array <Memory_Zone> zones = { .allocator = __temporary_allocator };
-        array_realloc(zones, 4);
-        array_add(zones, { S("virtual_arena"),     va.used, va.reserved });
+        array_realloc(zones, 5);
+        array_add(zones, { S("virtual_arena"),     va.used, va.reserved, va.large_pages });
+        array_add(zones, { S("overflow_arena"),    ova.used, ova.reserved, ova.large_pages });
         array_add(zones, { S("temporary_storage"), ts->total_occupied, ts->total_size });
         array_add(zones, { S("gpu_read_memory"),   gpu_read_allocator.used, gpu_read_buffer->size });
         array_add(zones, { S("gpu_write_memory"),  gpu_write_allocator.used, gpu_write_buffer->size });
@@ -1376,6 +1751,9 @@ void update_profiler() {
 
             p.x = offsets[2];
             ui_text(tprint("%llu", size), p, c, z, atlas);
+
+            p.x = offsets[3];
+            ui_text(it.large_pages ? S("large") : S("small"), p, c, z, atlas);
             
             p.y -= line_height;
         }
@@ -1409,7 +1787,7 @@ void push_profile_time_zone(String name) {
     Assert(zone->depth == profiler.active_zones.count, "For now zones must have unique names across different usage scopes");
     
     zone->calls += 1;
-    zone->start  = get_perf_counter();
+    zone->start  = get_cpu_cycles();
     
     array_add(profiler.active_zones, zone);
 }
@@ -1419,7 +1797,7 @@ void pop_profile_time_zone() {
 
     auto zone = array_pop(profiler.active_zones);
 
-    auto time = get_perf_counter() - zone->start;
+    auto time = get_cpu_cycles() - zone->start;
     auto exc  = time - zone->children;
     
     zone->exclusive += exc;
@@ -1507,6 +1885,75 @@ void draw_dev_stats() {
         ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
 		pos.y -= atlas->line_height;
 
+        count = stbsp_snprintf(text, sizeof(text), "entities visible %u culled %u (portals %u, occluded %u)", get_visible_entity_count(), get_culled_entity_count(), get_portal_culled_entity_count(), get_occluded_entity_count());
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        const auto &occlusion = get_occlusion_buffer()->stats;
+        count = stbsp_snprintf(text, sizeof(text), "occluders %u, triangles %u (skipped %u)", occlusion.occluder_count, occlusion.triangle_count, occlusion.skipped_triangle_count);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        const auto &portals = get_portal_visibility()->stats;
+        count = stbsp_snprintf(text, sizeof(text), "cells %u visible %u (%u visits), portals %u tested %u", portals.cell_count, portals.visible_cell_count, portals.visit_count, portals.portal_count, portals.portal_test_count);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        const auto &lights = get_light_clusters()->stats;
+        count = stbsp_snprintf(text, sizeof(text), "point lights %u in %u/%u clusters, %u indices (max %u, dropped %u), %u threads", lights.light_count, lights.lit_cluster_count, Light_Cluster_Grid::CLUSTER_COUNT, lights.index_count, lights.max_cluster_lights, lights.dropped_index_count, lights.worker_count);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        count = stbsp_snprintf(text, sizeof(text), "ui glyphs %u vertices %u in %u runs, layouts %u (hit %u, miss %u)", ui.stats.glyph_count, ui.stats.vertex_count, ui.stats.run_count, ui.stats.layout_count, ui.stats.layout_hit_count, ui.stats.layout_miss_count);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        if (const auto cache = atlas->glyph_cache) {
+            const auto &glyphs = cache->stats;
+            count = stbsp_snprintf(text, sizeof(text), "glyph cache %u glyphs in %u shelves, rasterized %u evicted %u failed %u", glyphs.glyph_count, glyphs.shelf_count, glyphs.miss_count, glyphs.evict_count, glyphs.failed_count);
+            pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+            ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+            pos.y -= atlas->line_height;
+        }
+
+        count = stbsp_snprintf(text, sizeof(text), "gpu commands %u (%.1fkb) filtered %u", get_emitted_command_count(), get_emitted_command_bytes() / 1024.0f, get_filtered_command_count());
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        const auto ring = get_upload_ring();
+        count = stbsp_snprintf(text, sizeof(text), "upload ring %.1fkb peak %.1fkb of %.1fkb", ring->last_frame_used / 1024.0f, ring->high_water / 1024.0f, ring->size / 1024.0f);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        const auto static_list = get_static_render_list();
+        count = stbsp_snprintf(text, sizeof(text), "static list %u entities in %u groups, rebuilt %u times", static_list->entity_count, static_list->groups.count, static_list->rebuild_count);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        // Render graph of previous frame, current one is built after dev stats.
+        const auto graph = get_render_graph();
+        u32 framebuffer_count = 0;
+        For (graph->physicals) framebuffer_count += it.framebuffer != 0;
+        
+        count = stbsp_snprintf(text, sizeof(text), "render graph %u passes (%u culled), %u barriers, %u targets in %u framebuffers", graph->passes.count, graph->culled_pass_count, graph->barrier_count, graph->transient_target_count, framebuffer_count);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
+        const auto &heap_stats = gpu_mesh_heap.stats;
+        count = stbsp_snprintf(text, sizeof(text), "mesh heap %.1fkb free %.1fkb (largest %.1fkb, %u blocks) pending %.1fkb moved %.1fkb", heap_stats.used_size / 1024.0f, heap_stats.free_size / 1024.0f, heap_stats.largest_free_size / 1024.0f, heap_stats.free_block_count, heap_stats.pending_size / 1024.0f, heap_stats.moved_size / 1024.0f);
+        pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
+        ui_text_with_shadow(make_string(text, count), pos, COLOR32_WHITE, shadow_offset, COLOR32_BLACK, Z);
+		pos.y -= atlas->line_height;
+
         const auto input = get_input_table();
         count = stbsp_snprintf(text, sizeof(text), "cursor %d %d (viewport %.0f %.0f)", input->cursor_x, input->cursor_y, screen_viewport.cursor_pos.x, screen_viewport.cursor_pos.y);
         pos.x = screen_viewport.width - get_line_width_px(atlas, make_string(text, count)) - padding;
@@ -1528,4 +1975,5 @@ void draw_dev_stats() {
 	}
 
     reset_draw_call_count();
+    reset_command_counts();
 }
@@ -1,18 +1,18 @@
 #pragma once
 
-#include "sync.h"
+#include "file_system.h"
 #include "thread.h"
 
 struct Hot_Reload_Catalog {
     Catalog catalog;
 
     Array <String> directories;
-    Array <String> paths_to_hot_reload;
     
-    Semaphore semaphore = SEMAPHORE_NONE;
+    File_Watcher *watcher = null;
 };
 
 void   init_hot_reload          ();
 Thread start_hot_reload_thread  ();
+void   stop_hot_reload          ();
 void   add_hot_reload_directory (String path);
 void   update_hot_reload        ();
@@ -3,7 +3,187 @@
 #include "stb_truetype.h"
 #include "file_system.h"
 #include "render.h"
+#include "gpu.h"
 #include "texture.h"
+#include "hash.h"
+#include "hash_table.h"
+#include "ui.h"
+
+static void scale_font_atlas(Font_Atlas *atlas, const Font_Atlas *baked, s32 px_height) {
+    const f32 scale = (f32)px_height / baked->px_height;
+
+    *atlas = *baked;
+    atlas->px_height      = px_height;
+    atlas->px_h_scale     = baked->px_h_scale * scale;
+    atlas->line_height    = (s32)((baked->ascent - baked->descent + baked->line_gap) * atlas->px_h_scale);
+    atlas->space_xadvance = baked->space_xadvance * scale;
+    atlas->glyph_scale    = baked->glyph_scale * scale;
+}
+
+// Free page rows start below baked glyphs.
+static void reset_glyph_cache(const Font_Atlas *atlas) {
+    auto cache = atlas->glyph_cache;
+
+    u16 top = 0;
+    for (s32 i = 0; i <= atlas->end_charcode - atlas->start_charcode; ++i) {
+        top = Max(top, atlas->glyphs[i].y1);
+    }
+
+    For (cache->shelves) array_reset(it.codepoints);
+    
+    table_clear(cache->glyph_table);
+    cache->shelves.count = 0;
+    cache->top        = top + 1;
+    cache->image_view = atlas->texture ? atlas->texture->image_view : 0;
+    cache->stats      = {};
+}
+
+// Find shelf for w x h slot and reserve it, evict least recently used shelf if
+// page is full. Return shelf index or NO_SHELF.
+static u16 reserve_glyph_slot(Glyph_Cache *cache, u16 w, u16 h, u16 *x) {
+    // Shelves much taller than glyph are left for taller glyphs.
+    u16 best = Cached_Glyph::NO_SHELF;
+    for (u16 i = 0; i < cache->shelves.count; ++i) {
+        const auto &shelf = cache->shelves[i];
+        if (shelf.height < h || shelf.height > h + h / 2) continue;
+        if (shelf.width + w > FONT_PAGE_SIZE) continue;
+        
+        if (best == Cached_Glyph::NO_SHELF || shelf.height < cache->shelves[best].height) best = i;
+    }
+
+    if (best == Cached_Glyph::NO_SHELF) {
+        const u16 height = Align(h, Glyph_Cache::SHELF_HEIGHT_STEP);
+        if (cache->top + height <= FONT_PAGE_SIZE && cache->shelves.count < Cached_Glyph::NO_SHELF) {
+            Glyph_Shelf shelf;
+            shelf.y      = cache->top;
+            shelf.height = height;
+
+            array_add(cache->shelves, shelf);
+            cache->top += height;
+            best = (u16)(cache->shelves.count - 1);
+        }
+    }
+    
+    if (best == Cached_Glyph::NO_SHELF) {
+        for (u16 i = 0; i < cache->shelves.count; ++i) {
+            const auto &shelf = cache->shelves[i];
+            if (shelf.height < h || shelf.last_used_frame >= frame_index) continue;
+            
+            if (best == Cached_Glyph::NO_SHELF || shelf.last_used_frame < cache->shelves[best].last_used_frame) best = i;
+        }
+
+        if (best == Cached_Glyph::NO_SHELF) return best;
+        
+        auto &shelf = cache->shelves[best];
+        For (shelf.codepoints) table_remove(cache->glyph_table, it);
+        
+        shelf.codepoints.count = 0;
+        shelf.width = 0;
+        cache->stats.evict_count += 1;
+    }
+
+    auto &shelf = cache->shelves[best];
+    *x = shelf.width;
+    shelf.width += w;
+    
+    return best;
+}
+
+// Rasterize glyph distance field to free slot of atlas page.
+static bool rasterize_glyph(const Font_Atlas *atlas, u32 codepoint, Cached_Glyph *cached) {
+    auto cache = atlas->glyph_cache;
+    if (!cache->font_file.data) return false;
+    
+    const auto info  = cache->font_info;
+    const s32  index = stbtt_FindGlyphIndex(info, codepoint);
+    if (index == 0) return false;
+    
+    s32 advance, left_side_bearing;
+    stbtt_GetGlyphHMetrics(info, index, &advance, &left_side_bearing);
+
+    *cached = {};
+    cached->glyph.xadvance = advance * cache->sdf_scale;
+
+    constexpr f32 dist_scale = (f32)FONT_SDF_ON_EDGE / FONT_SDF_PADDING;
+
+    s32 w, h, xoff, yoff;
+    auto sdf = stbtt_GetGlyphSDF(info, cache->sdf_scale, index, FONT_SDF_PADDING, FONT_SDF_ON_EDGE, dist_scale, &w, &h, &xoff, &yoff);
+    if (!sdf) return true; // no pixels, like space
+    defer { stbtt_FreeSDF(sdf, null); };
+
+    // Slot has 1 pixel gap at right and bottom, so linear filter does not pick
+    // pixels of neighbour glyph or evicted one.
+    const u16 slot_w = (u16)(w + 1);
+    const u16 slot_h = (u16)(h + 1);
+    if (slot_w > FONT_PAGE_SIZE || slot_h > FONT_PAGE_SIZE) return false;
+
+    u16 x = 0;
+    const auto shelf = reserve_glyph_slot(cache, slot_w, slot_h, &x);
+    if (shelf == Cached_Glyph::NO_SHELF) return false;
+
+    const u16 y = cache->shelves[shelf].y;
+    
+    auto pixels = (u8 *)talloc(slot_w * slot_h);
+    set(pixels, 0, slot_w * slot_h);
+    for (s32 row = 0; row < h; ++row) {
+        copy(pixels + row * slot_w, sdf + row * w, w);
+    }
+
+    const auto image_view = gpu_get_image_view(atlas->texture->image_view);
+    gpu_update_image(image_view->image, 0, x, y, slot_w, slot_h, pixels);
+    
+    cached->glyph.x0   = x;
+    cached->glyph.y0   = y;
+    cached->glyph.x1   = x + w;
+    cached->glyph.y1   = y + h;
+    cached->glyph.xoff = (f32)xoff;
+    cached->glyph.yoff = (f32)yoff;
+    cached->shelf      = shelf;
+
+    array_add(cache->shelves[shelf].codepoints, codepoint);
+    
+    return true;
+}
+
+const Glyph *get_glyph(const Font_Atlas *atlas, u32 codepoint, bool *dynamic, u64 draw_frame) {
+    constexpr u32 fallback = '?';
+    
+    if (dynamic) *dynamic = false;
+    
+    if (codepoint >= (u32)atlas->start_charcode && codepoint <= (u32)atlas->end_charcode) {
+        return &atlas->glyphs[codepoint - atlas->start_charcode];
+    }
+    
+    const auto fallback_glyph = &atlas->glyphs[fallback - atlas->start_charcode];
+
+    auto cache = atlas->glyph_cache;
+    if (!cache || !atlas->texture) return fallback_glyph;
+
+    if (cache->image_view != atlas->texture->image_view) reset_glyph_cache(atlas);
+    
+    auto cached = table_find(cache->glyph_table, codepoint);
+    if (!cached) {
+        Cached_Glyph glyph;
+        if (!rasterize_glyph(atlas, codepoint, &glyph)) {
+            cache->stats.failed_count += 1;
+            return fallback_glyph;
+        }
+
+        cached = &table_add(cache->glyph_table, codepoint, glyph);
+        cache->stats.miss_count += 1;
+    }
+
+    if (cached->shelf != Cached_Glyph::NO_SHELF) {
+        auto &shelf = cache->shelves[cached->shelf];
+        shelf.last_used_frame = Max(shelf.last_used_frame, Max(frame_index, draw_frame));
+    }
+
+    cache->stats.glyph_count = cache->glyph_table.count;
+    cache->stats.shelf_count = cache->shelves.count;
+    
+    if (dynamic) *dynamic = true;
+    return &cached->glyph;
+}
 
 Font_Atlas *new_font_atlas(String name, Buffer contents) {
     auto p = (void **)&contents.data;
@@ -11,11 +191,21 @@ Font_Atlas *new_font_atlas(String name, Buffer contents) {
     auto meta   = *Eat(p, Baked_Font_Meta);
     auto cpath  =  Eat(p, char, meta.atlas_path_size);
     auto glyphs =  Eat(p, Glyph, meta.charcode_count);
+    auto file   =  Eat(p, u8, meta.font_file_size);
 
     auto font_name  = get_file_name_no_ext(name);
     auto atlas_name = get_file_name_no_ext(make_string(cpath));
         
     auto &atlas = font_atlas_table[font_name];
+
+    // Hot reload keeps glyphs if charcode count did not change, sized atlases get
+    // new pointer from scale_font_atlas below anyway.
+    const s32 glyph_count = atlas.glyphs ? atlas.end_charcode - atlas.start_charcode + 1 : 0;
+    if (glyph_count != (s32)meta.charcode_count) {
+        if (atlas.glyphs) release(atlas.glyphs, __default_allocator);
+        atlas.glyphs = New(Glyph, meta.charcode_count, __default_allocator);
+    }
+    
     atlas.texture_name   = copy_string(atlas_name);
     atlas.font_name      = copy_string(font_name);
     atlas.start_charcode = meta.start_charcode;
@@ -27,40 +217,77 @@ Font_Atlas *new_font_atlas(String name, Buffer contents) {
     atlas.px_height      = meta.px_height;
     atlas.line_height    = meta.line_height;
     atlas.space_xadvance = glyphs[0].xadvance;
-    atlas.glyphs         = New(Glyph, meta.charcode_count);
 
     copy(atlas.glyphs, glyphs, meta.charcode_count * sizeof(atlas.glyphs[0]));
 
+    if (!atlas.glyph_cache) {
+        atlas.glyph_cache = New(Glyph_Cache);
+        atlas.glyph_cache->font_info = New(stbtt_fontinfo);
+        table_set_hash(atlas.glyph_cache->glyph_table, [] (const u32 &codepoint) { return (u64)hash_pcg(codepoint); });
+    }
+
+    auto cache = atlas.glyph_cache;
+    if (cache->font_file.data) release(cache->font_file.data, __default_allocator);
+    
+    cache->font_file = make_buffer(alloc(meta.font_file_size, __default_allocator), meta.font_file_size);
+    copy(cache->font_file.data, file, meta.font_file_size);
+
+    if (!stbtt_InitFont(cache->font_info, cache->font_file.data, 0)) {
+        log(LOG_ERROR, "Failed to init font file of %S, only baked glyphs are available", font_name);
+        release(cache->font_file.data, __default_allocator);
+        cache->font_file = {};
+    }
+
+    cache->sdf_scale = meta.px_h_scale;
+    reset_glyph_cache(&atlas);
+    
+    For (sized_font_atlases) {
+        if (it->font_name == atlas.font_name) scale_font_atlas(it, &atlas, it->px_height);
+    }
+
+    // Reloaded atlas keeps its address, so cached layouts of old glyphs are dropped.
+    invalidate_ui_text_layouts();
+
     return &atlas;
 }
 
 Font_Atlas *get_font_atlas(String name) { return table_find(font_atlas_table, name); }
 
-f32 get_char_width_px(const Font_Atlas *atlas, const char c) {
-    if (c == C_SPACE) {
+Font_Atlas *get_font_atlas(String name, s32 px_height) {
+    auto baked = get_font_atlas(name);
+    if (!baked) return null;
+
+    For (sized_font_atlases) {
+        if (it->font_name == baked->font_name && it->px_height == px_height) return it;
+    }
+
+    auto atlas = New(Font_Atlas);
+    scale_font_atlas(atlas, baked, px_height);
+    
+    array_add(sized_font_atlases, atlas);
+    return atlas;
+}
+
+f32 get_char_width_px(const Font_Atlas *atlas, u32 codepoint) {
+    if (codepoint == C_SPACE) {
         return atlas->space_xadvance;
     }
 
-    if (c == C_TAB) {
+    if (codepoint == C_TAB) {
         return 4 * atlas->space_xadvance;
     }
 
-    if (c == C_NEW_LINE) {
+    if (codepoint == C_NEW_LINE) {
         return 0;
     }
 
-    Assert(Is_Ascii_Ex(c));
-
-    const u32 ci = c - atlas->start_charcode;
-    const auto &glyph = atlas->glyphs[ci];
-
-    return glyph.xadvance;
+    return get_glyph(atlas, codepoint)->xadvance * atlas->glyph_scale;
 }
 
 f32 get_line_width_px(const Font_Atlas *atlas, String text) {
 	f32 width = 0;
-	for (s32 i = 0; i < text.size; ++i) {
-        width += get_char_width_px(atlas, text.data[i]);
+	for (u64 i = 0; i < text.size;) {
+        width += get_char_width_px(atlas, utf8_next(text.data, text.size, &i));
 	}
 	return width;
 }
@@ -1,6 +1,15 @@
 #pragma once
 
 struct Texture;
+struct stbtt_fontinfo;
+
+// Glyphs are signed distance fields, edge maps to FONT_SDF_ON_EDGE and each pixel
+// of distance changes value by FONT_SDF_ON_EDGE / FONT_SDF_PADDING. Baker and
+// runtime glyph cache rasterize with the same parameters to the same atlas page.
+inline constexpr s32 FONT_SDF_PIXEL_HEIGHT = 32;
+inline constexpr s32 FONT_SDF_PADDING      = 4;
+inline constexpr u8  FONT_SDF_ON_EDGE      = 128;
+inline constexpr s32 FONT_PAGE_SIZE        = 512; // width and height of atlas texture
 
 struct Glyph {
     u16 x0, y0, x1, y1; // position in baked texture atlas
@@ -17,16 +26,66 @@ struct Baked_Font_Meta {
     f32 px_h_scale;
     s32 px_height;
     s32 line_height;
+    u32 font_file_size;
 
     // Baked font atlas texture path of size atlas_path_size.
     // Baked font charcode_count Glyph's.
+    // Font file of font_file_size, glyphs out of baked range are rasterized from it.
+};
+
+// Glyphs out of baked range are rasterized on demand to rows of atlas page below
+// baked glyphs and uploaded with sub image updates. Rows are split to shelves of
+// similar glyph height, if page is full, least recently used shelf is evicted as
+// a whole. Shelves used in current frame are never evicted, so glyphs that are
+// already drawn stay valid, glyph that does not fit falls back to '?'. Glyph that
+// is drawn in later frame (e.g. ui text recorded after ui flush) marks its shelf
+// with that frame, so shelf is kept until then.
+struct Glyph_Shelf {
+    u16         y      = 0;
+    u16         height = 0;
+    u16         width  = 0; // used from left
+    u64         last_used_frame = 0; // may be ahead of current one
+    Array <u32> codepoints;
 };
 
+struct Cached_Glyph {
+    static constexpr u16 NO_SHELF = U16_MAX; // glyph without pixels, like space
+
+    Glyph glyph;
+    u16   shelf = NO_SHELF;
+};
+
+struct Glyph_Cache_Stats {
+    u32 glyph_count  = 0;
+    u32 shelf_count  = 0;
+    u32 miss_count   = 0; // rasterized
+    u32 evict_count  = 0; // shelves
+    u32 failed_count = 0; // did not fit or not in font
+};
+
+struct Glyph_Cache {
+    static constexpr u16 SHELF_HEIGHT_STEP = 4;
+    
+    Buffer          font_file; // in heap, replaced by hot reload
+    stbtt_fontinfo *font_info  = null;
+    f32             sdf_scale  = 0.0f;
+    u32             image_view = 0; // glyphs are dropped if texture is reloaded
+    u16             top        = 0; // first free row of page
+
+    Table <u32, Cached_Glyph> glyph_table;
+    Array <Glyph_Shelf>       shelves;
+    
+    Glyph_Cache_Stats stats;
+};
+
+// Baked atlases are signed distance fields of px_height glyphs, sized atlases share
+// glyphs, glyph cache and texture of baked one and scale them to their own height.
+
 struct Font_Atlas {
     String   font_name;
     String   texture_name;
     Texture *texture;
-    Glyph   *glyphs;
+    Glyph   *glyphs = null; // in heap, reused by hot reload of same charcode range
     s32      start_charcode;
     s32      end_charcode;
     s32      ascent;
@@ -36,6 +95,8 @@ struct Font_Atlas {
     s32      px_height;
     f32      px_h_scale;
     f32      space_xadvance;
+    f32      glyph_scale = 1.0f; // from baked glyph pixels to this atlas pixels
+    Glyph_Cache *glyph_cache = null;
 };
 
 struct {
@@ -45,9 +106,15 @@ struct {
 } global_font_atlases;
 
 inline Table <String, Font_Atlas> font_atlas_table;
+inline Array <Font_Atlas *>        sized_font_atlases; // not in table, so pointers stay valid
 
 Font_Atlas *new_font_atlas(String name, Buffer contents);
 Font_Atlas *get_font_atlas(String name);
+Font_Atlas *get_font_atlas(String name, s32 px_height); // sized from baked atlas
+
+// Glyph in baked pixels, rasterized to glyph cache if it is out of baked range.
+// Draw frame is frame glyph is drawn in, if it is later than current one.
+const Glyph *get_glyph(const Font_Atlas *atlas, u32 codepoint, bool *dynamic = null, u64 draw_frame = 0);
 
-f32 get_char_width_px(const Font_Atlas *atlas, char c);
-f32 get_line_width_px(const Font_Atlas *atlas, String text);
+f32 get_char_width_px(const Font_Atlas *atlas, u32 codepoint);
+f32 get_line_width_px(const Font_Atlas *atlas, String text); // utf-8
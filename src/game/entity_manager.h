@@ -28,6 +28,7 @@ enum Entity_Type : u8 {
     E_POINT_LIGHT,
     E_SOUND_EMITTER,
     E_PORTAL,
+    E_CELL, // volume of portal visibility, see portal.h
     
     E_COUNT
 };
@@ -37,6 +38,7 @@ enum Entity_Bits : u32 {
     E_MOUSE_PICKED_BIT = 0x2,
     E_INVISIBLE_BIT    = 0x4,
     E_OVERLAP_BIT      = 0x8,
+    E_OCCLUDER_BIT     = 0x10, // mesh is drawn to software occlusion buffer
 };
 
 // Reflection does not support enums for now, so their underlying types are used instead.
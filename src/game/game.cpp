@@ -11,6 +11,7 @@
 #include "editor.h"
 #include "console.h"
 #include "render.h"
+#include "render_frame.h"
 #include "shader_binding_model.h"
 #include "ui.h"
 #include "viewport.h"
@@ -127,15 +128,14 @@ void load_game_assets() {
     load_game_pak(GAME_PAK_PATH);
     
     {
-        auto &atlas = global_font_atlases.main_small;
-        atlas = get_font_atlas(S("better_vcr_16"));
-        atlas->texture = get_texture(make_atom(atlas->texture_name));
-    }
+        // Distance field is sampled between texels, so it needs linear filter.
+        auto baked = get_font_atlas(S("better_vcr_sdf"));
+        baked->texture = get_texture(make_atom(baked->texture_name));
+        baked->texture->sampler = gpu.sampler_linear_color;
 
-    {
-        auto &atlas = global_font_atlases.main_medium;
-        atlas = get_font_atlas(S("better_vcr_24"));
-        atlas->texture = get_texture(make_atom(atlas->texture_name));
+        global_font_atlases.main_small  = get_font_atlas(S("better_vcr_sdf"), 16);
+        global_font_atlases.main_medium = get_font_atlas(S("better_vcr_sdf"), 24);
+        global_font_atlases.main_big    = get_font_atlas(S("better_vcr_sdf"), 32);
     }
     
     // Shader constants.
@@ -161,12 +161,14 @@ void load_game_assets() {
 
         {
             auto &table = cbi_level_parameters.value_table;
-            cv_direct_light_count = table_find(table, S("direct_light_count"));
-            cv_point_light_count  = table_find(table, S("point_light_count"));
-            cv_direct_lights      = table_find(table, S("direct_lights"));
-            cv_point_lights       = table_find(table, S("point_lights"));
+            cv_direct_light_count   = table_find(table, S("direct_light_count"));
+            cv_direct_lights        = table_find(table, S("direct_lights"));
+            cv_light_cluster_counts = table_find(table, S("light_cluster_counts"));
+            cv_light_cluster_depth  = table_find(table, S("light_cluster_depth"));
         }
 
+        resolve_entity_constant_handles();
+        
         {
             auto &table = cbi_frame_buffer_constants.value_table;
             cv_fb_transform                = table_find(table, S("transform"));
@@ -334,6 +336,16 @@ void init_program_layers() {
         };
         table_add(layer.input_mapping_table, KEY_SWITCH_COLLISION_VIEW, im);
 
+        im = {};
+        im.on_press = []() {
+            if (game_state.view_mode_flags & VIEW_MODE_FLAG_OCCLUSION) {
+                game_state.view_mode_flags &= ~VIEW_MODE_FLAG_OCCLUSION;
+            } else {
+                game_state.view_mode_flags |= VIEW_MODE_FLAG_OCCLUSION;
+            }
+        };
+        table_add(layer.input_mapping_table, KEY_SWITCH_OCCLUSION_VIEW, im);
+
         im = {};
         im.on_press = []() {
             const auto layer = get_program_layer();
@@ -405,6 +417,19 @@ void init_program_layers() {
         im = {};
         im.on_press = mouse_unpick_entity;
         table_add(layer.input_mapping_table, KEY_UNSELECT_ENTITY, im);
+
+        im = {};
+        im.on_press = []() {
+            // Occluder bit is saved with level like other entity bits.
+            auto e = editor.mouse_picked_entity;
+            if (!down(KEY_CTRL) || !e || !e->mesh) return;
+            
+            e->bits ^= E_OCCLUDER_BIT;
+            invalidate_static_render_list();
+            
+            screen_report("Entity %u %s occluder", e->eid, (e->bits & E_OCCLUDER_BIT) ? "is" : "is not");
+        };
+        table_add(layer.input_mapping_table, KEY_TOGGLE_OCCLUDER, im);
     }
 
     {
@@ -1311,6 +1336,11 @@ void simulate_game() {
     }
 
     For (manager->entities) {
+        // Static render list keeps transforms, so moved static meshes rebuild it.
+        if (it.type == E_STATIC_MESH && it.velocity != Vector3_zero) {
+            invalidate_static_render_list();
+        }
+        
         it.position += it.velocity * dt;
         it.object_to_world = make_transform(it.position, it.orientation, it.scale);
         move_aabb_along_with_entity(&it);
@@ -1346,11 +1376,17 @@ void reset(Entity_Manager *manager) {
     manager->player = 0;
     manager->skybox = 0;
 
+    invalidate_static_render_list();
+
     // Add default nil entity.
     array_add(manager->entities, {});
 }
 
 void post_frame_cleanup(Entity_Manager *manager) {
+    if (manager->entities_to_delete.count) {
+        invalidate_static_render_list();
+    }
+    
     For (manager->entities_to_delete) {
         auto e = get_entity(manager, it);
         e->bits |= E_DELETED_BIT;
@@ -1387,6 +1423,9 @@ Pid new_entity(Entity_Manager *manager, Entity_Type type) {
     e.eid      = make_eid(index, generation);
     e.scale    = Vector3(1.0f);
     e.uv_scale = Vector2(1.0f);
+
+    // Entity is set up after creation, list is rebuilt on render anyway.
+    invalidate_static_render_list();
     
     return e.eid;
 }
@@ -14,6 +14,7 @@ void flush_game_logger ();
 
 enum View_Mode_Flag : u32 {
     VIEW_MODE_FLAG_COLLISION = 0x1,
+    VIEW_MODE_FLAG_OCCLUSION = 0x2,
 };
 
 enum Camera_Behavior {
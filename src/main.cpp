@@ -34,6 +34,11 @@
 #include "math.cpp"
 #include "os.cpp"
 #include "render.cpp"
+#include "gpu_command.cpp"
+#include "render_graph.cpp"
+#include "occlusion.cpp"
+#include "light_cluster.cpp"
+#include "portal.cpp"
 #include "ui.cpp"
 #include "asset.cpp"
 
@@ -44,6 +49,8 @@
 #include "gl.cpp"
 #include "glad.cpp"
 #include "wgl.cpp"
+#elif NULL_GPU
+#include "gpu_null.cpp"
 #else
 #error "Unsupported rendering backend"
 #endif
@@ -57,8 +64,8 @@ static void do_one_frame();
 static void update_time();
 static void handle_window_events();
 
-Virtual_Arena virtual_arena          = { .reserve_size = Megabytes(2)  };
-Virtual_Arena overflow_virtual_arena = { .reserve_size = Megabytes(64) };
+Virtual_Arena virtual_arena          = { .reserve_size = Megabytes(2),  .use_large_pages = true };
+Virtual_Arena overflow_virtual_arena = { .reserve_size = Megabytes(64) }; // reserved on temporary storage overflow
 
 s32 main() {
     stbi_set_flip_vertically_on_load(true);
@@ -69,6 +76,8 @@ s32 main() {
     context.logger    = { game_logger_proc, &game_logger_data };
     context.allocator = { virtual_arena_allocator_proc, &virtual_arena };
     context.temporary_storage->overflow_allocator = { virtual_arena_allocator_proc, &overflow_virtual_arena };
+
+    init_cpu_timer();
     
     set_process_cwd(get_process_directory());
 
@@ -97,6 +106,7 @@ s32 main() {
 
     init_shader_platform();
     init_render_frame();
+    defer { shutdown_render_frame(); };
     init_missing_assets();
     init_line_geometry();
     init_profiler();
@@ -117,7 +127,21 @@ s32 main() {
     add_hot_reload_directory(DIR_MESHES);
 
     const auto hot_reload_thread = start_hot_reload_thread();
-    defer { terminate_thread(hot_reload_thread); };
+    defer { stop_hot_reload(); };
+
+    {
+        // Keep main thread and hot reload apart, the latter is mostly asleep.
+        const auto topology = get_cpu_topology();
+        log("Cpu cores %u physical, %u logical", topology->physical_core_count, topology->logical_core_count);
+
+        set_thread_name(get_current_thread(), S("main"));
+        set_thread_name(hot_reload_thread, S("hot_reload"));
+        set_thread_priority(hot_reload_thread, THREAD_LOW_PRIORITY);
+
+        if (topology->physical_core_count > 1) {
+            set_thread_affinity(hot_reload_thread, topology->physical_core_masks[topology->physical_core_count - 1]);
+        }
+    }
     
     game_state.polygon_mode = GPU_POLYGON_FILL;
 
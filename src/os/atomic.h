@@ -8,3 +8,4 @@ s32	atomic_swap(s32 *dst, s32 val); // swap dst and val and return dst before op
 s32	atomic_add(s32 *dst, s32 val); // add val to dst and return dst before op
 s32	atomic_increment(s32 *dst);
 s32	atomic_decrement(s32 *dst);
+s64	atomic_cmp_swap(s64 *dst, s64 val, s64 cmp);
@@ -5,3 +5,21 @@ u64 get_perf_counter       ();
 u64 get_perf_hz            ();
 u64 get_perf_hz_ms         ();
 u64 get_perf_hz_us         ();
+
+// Cpu cycle counter is read directly from invariant tsc if cpu supports it,
+// otherwise it falls back to perf counter. Its frequency is calibrated against
+// perf counter once in init_cpu_timer, so get_cpu_hz* should be used to convert
+// cycle deltas to time instead of get_perf_hz*.
+void init_cpu_timer             ();
+bool has_invariant_tsc          ();
+bool is_cpu_timer_tsc           ();
+u64  get_cpu_cycles             ();
+u64  get_cpu_cycles_serialized  (); // waits for previous instructions to finish
+u64  get_cpu_hz                 ();
+u64  get_cpu_hz_ms              ();
+u64  get_cpu_hz_us              ();
+u64  cycles_to_ns               (u64 cycles);
+
+// Time and cycles spent by current thread on cpu, sleeping/waiting is not counted.
+u64  get_thread_cpu_time_ns     ();
+u64  get_thread_cpu_cycles      ();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "thread.h"
+
 typedef void *File;
 
 extern const File FILE_NONE;
@@ -40,6 +42,18 @@ void   write_text_file  (String path, String source);
 void   visit_directory  (String path, void (*callback) (const File_Callback_Data *),
                          bool recursive = true, void *user_data = null);
 
+// Watches directories for file changes on its own thread. Several changes of the same
+// path are coalesced into one, and path is reported only after it was not changed for
+// debounce time, as some editors write file in several steps.
+struct File_Watcher;
+
+File_Watcher *create_file_watcher  (u32 debounce_ms = 100);
+bool          add_file_watch       (File_Watcher *watcher, String directory, bool recursive = true); // before start only
+Thread        start_file_watcher   (File_Watcher *watcher);
+void          destroy_file_watcher (File_Watcher *watcher);
+// Thread safe, pops settled changed paths and adds their copies to given array.
+u32           poll_file_watcher    (File_Watcher *watcher, Array <String> &paths, Allocator alc);
+
 String extract_file_from_path   (String path, Allocator alc);
 String fix_directory_delimiters (String path);
 String remove_extension         (String path);
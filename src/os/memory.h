@@ -2,6 +2,7 @@
 
 u64 get_page_size              ();
 u64 get_allocation_granularity ();
+u64 get_large_page_size        (); // 0 if large pages are not supported or not permitted
 
 void *heap_alloc (u64 size);
 bool  heap_free  (void *p);
@@ -10,3 +11,13 @@ void *virtual_reserve  (void *addr, u64 size);
 void *virtual_commit   (void *vm, u64 size);
 bool  virtual_decommit (void *vm, u64 size);
 bool  virtual_release  (void *vm);
+
+// Reserve and commit memory backed by large pages at once, as some platforms do not
+// allow to commit large pages separately. Size must be aligned to get_large_page_size.
+// Such memory can not be decommited, only released as a whole.
+void *virtual_reserve_large (void *addr, u64 size);
+
+// Reserve 2 * size of address space with the same physical memory mapped twice in a row,
+// so access past the first half wraps to its start. Size must be aligned to allocation granularity.
+void *virtual_reserve_ring (u64 size);
+bool  virtual_release_ring (void *vm, u64 size);
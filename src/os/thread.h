@@ -9,11 +9,46 @@ enum Thread_Bits : u32 {
     THREAD_SUSPENDED_BIT,
 };
 
+enum Thread_Priority : u8 {
+    THREAD_LOW_PRIORITY,
+    THREAD_NORMAL_PRIORITY,
+    THREAD_HIGH_PRIORITY,
+    THREAD_CRITICAL_PRIORITY,
+};
+
+// Only first 64 logical cores are reported, so core masks fit in u64.
+inline constexpr u32 MAX_CPU_CORES        = 64;
+inline constexpr u32 MAX_CPU_CACHE_GROUPS = 64;
+
+struct Cpu_Cache_Group {
+    u32 level = 0;
+    u64 size  = 0;
+    u64 logical_core_mask = 0; // logical cores sharing this cache
+};
+
+struct Cpu_Topology {
+    u32 physical_core_count = 0;
+    u32 logical_core_count  = 0;
+    u32 cache_group_count   = 0;
+
+    u64             physical_core_masks[MAX_CPU_CORES]; // logical cores of each physical one
+    Cpu_Cache_Group cache_groups[MAX_CPU_CACHE_GROUPS]; // l2 and l3 only
+};
+
+const Cpu_Topology *get_cpu_topology (); // queried once and cached
+
 Thread create_thread    (u32 (*entry)(void *), u32 bits, void *user_data = null);
 bool   resume_thread    (Thread handle);
 bool   suspend_thread   (Thread handle);
 bool   terminate_thread (Thread handle);
 bool   is_active_thread (Thread handle);
+bool   wait_thread      (Thread handle, u32 ms); // true if thread exited
+bool   close_thread     (Thread handle);
+
+bool   set_thread_affinity (Thread handle, u64 logical_core_mask);
+bool   set_thread_priority (Thread handle, Thread_Priority priority);
+bool   set_thread_name     (Thread handle, String name);
+Thread get_current_thread  ();
 
 void sleep                 (u32 ms);
 u64	 get_current_thread_id ();
@@ -244,6 +244,233 @@ void visit_directory(String path, void (*callback) (const File_Callback_Data *),
     FindClose(file);
 }
 
+struct File_Watcher {
+    struct Directory {
+        const char *path   = null;
+        HANDLE      handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED  overlapped = {};
+        bool        recursive  = true;
+        
+        alignas(DWORD) u8 buffer[Kilobytes(16)];
+    };
+
+    struct Change {
+        String path;
+        u64    time = 0; // last change time in ms
+    };
+
+    // First wait object is reserved for stop event.
+    static constexpr u32 MAX_DIRECTORIES = MAXIMUM_WAIT_OBJECTS - 1;
+    
+    Directory *directories[MAX_DIRECTORIES];
+    u32        directory_count = 0;
+    u32        debounce_ms     = 0;
+
+    Thread thread     = THREAD_NONE;
+    HANDLE stop_event = NULL;
+
+    // Changes are added by watcher thread and popped by any other, so
+    // they are allocated with thread safe heap allocator.
+    Critical_Section cs = null;
+    Array <Change>   changes;
+};
+
+File_Watcher *create_file_watcher(u32 debounce_ms) {
+    auto watcher = New(File_Watcher);
+    watcher->debounce_ms       = debounce_ms;
+    watcher->stop_event        = CreateEvent(null, TRUE, FALSE, null);
+    watcher->cs                = create_cs();
+    watcher->changes.allocator = __default_allocator;
+    
+    return watcher;
+}
+
+bool add_file_watch(File_Watcher *watcher, String directory, bool recursive) {
+    Assert(watcher->thread == THREAD_NONE, "Directories must be added before file watcher start");
+    
+    if (watcher->directory_count >= watcher->MAX_DIRECTORIES) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "Failed to watch directory %S, max count %u reached", directory, watcher->MAX_DIRECTORIES);
+        return false;
+    }
+
+    const auto cpath  = to_c_string(directory, context.allocator);
+    const auto handle = CreateFileA(cpath, FILE_LIST_DIRECTORY,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    null, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, null);
+
+    if (handle == INVALID_HANDLE_VALUE) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to open directory %s for watch", GetLastError(), cpath);
+        return false;
+    }
+
+    auto dir = New(File_Watcher::Directory);
+    dir->path      = cpath;
+    dir->handle    = handle;
+    dir->recursive = recursive;
+    dir->overlapped.hEvent = CreateEvent(null, FALSE, FALSE, null);
+    
+    watcher->directories[watcher->directory_count] = dir;
+    watcher->directory_count += 1;
+    
+    return true;
+}
+
+static bool win32_read_directory_changes(File_Watcher::Directory *dir) {
+    constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+    
+    if (!ReadDirectoryChangesW(dir->handle, dir->buffer, sizeof(dir->buffer), dir->recursive, filter, null, &dir->overlapped, null)) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to read directory changes in %s", GetLastError(), dir->path);
+        return false;
+    }
+
+    return true;
+}
+
+static void win32_queue_file_changes(File_Watcher *watcher, File_Watcher::Directory *dir, u32 size) {
+    if (size == 0) {
+        log(LOG_IDENT_WIN32, LOG_WARNING, "Directory %s change buffer overflow, some changes are lost", dir->path);
+        return;
+    }
+
+    auto info = (FILE_NOTIFY_INFORMATION *)dir->buffer;
+    
+    while (1) {
+        if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+            char name[MAX_PATH];
+            const s32 name_length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+                                                        name, sizeof(name) - 1, null, null);
+            if (name_length > 0) {
+                name[name_length] = '\0';
+
+                char file_path[MAX_PATH];
+                PathCombineA(file_path, dir->path, name);
+
+                // Path format matches the one from visit_directory.
+                const auto path = fix_directory_delimiters(make_string(file_path));
+
+                enter_cs(watcher->cs);
+
+                File_Watcher::Change *change = null;
+                For (watcher->changes) {
+                    if (it.path == path) {
+                        change = &it;
+                        break;
+                    }
+                }
+
+                if (!change) {
+                    change = &array_add(watcher->changes);
+                    change->path = copy_string(path, watcher->changes.allocator);
+                }
+
+                change->time = get_time_since_boot_ms();
+                
+                leave_cs(watcher->cs);
+            }
+        }
+
+        if (info->NextEntryOffset == 0) break;
+        info = (FILE_NOTIFY_INFORMATION *)((u8 *)info + info->NextEntryOffset);
+    }
+}
+
+static u32 win32_file_watcher_proc(void *data) {
+    Assert(data);
+    auto watcher = (File_Watcher *)data;
+
+    HANDLE events[MAXIMUM_WAIT_OBJECTS];
+    events[0] = watcher->stop_event;
+
+    for (u32 i = 0; i < watcher->directory_count; ++i) {
+        auto dir = watcher->directories[i];
+        events[i + 1] = dir->overlapped.hEvent;
+        win32_read_directory_changes(dir);
+    }
+
+    const u32 event_count = watcher->directory_count + 1;
+    
+    while (1) {
+        const auto res = WaitForMultipleObjects(event_count, events, FALSE, INFINITE);
+        if (res == WAIT_OBJECT_0) return 0;
+        
+        if (res == WAIT_FAILED) {
+            log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to wait for directory changes", GetLastError());
+            return INVALID_THREAD_RESULT;
+        }
+
+        const u32 index = res - WAIT_OBJECT_0 - 1;
+        if (index >= watcher->directory_count) continue;
+
+        auto dir = watcher->directories[index];
+
+        DWORD size = 0;
+        if (GetOverlappedResult(dir->handle, &dir->overlapped, &size, FALSE)) {
+            win32_queue_file_changes(watcher, dir, size);
+        } else {
+            log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to get directory %s changes", GetLastError(), dir->path);
+        }
+
+        win32_read_directory_changes(dir);
+    }
+}
+
+Thread start_file_watcher(File_Watcher *watcher) {
+    Assert(watcher->thread == THREAD_NONE);
+    watcher->thread = create_thread(win32_file_watcher_proc, 0, watcher);
+    return watcher->thread;
+}
+
+void destroy_file_watcher(File_Watcher *watcher) {
+    if (watcher->thread != THREAD_NONE) {
+        SetEvent(watcher->stop_event);
+        WaitForSingleObject(watcher->thread, INFINITE);
+        CloseHandle(watcher->thread);
+    }
+
+    for (u32 i = 0; i < watcher->directory_count; ++i) {
+        auto dir = watcher->directories[i];
+        CancelIoEx(dir->handle, &dir->overlapped);
+        CloseHandle(dir->handle);
+        CloseHandle(dir->overlapped.hEvent);
+    }
+
+    For (watcher->changes) release(it.path.data, watcher->changes.allocator);
+    array_reset(watcher->changes);
+
+    CloseHandle(watcher->stop_event);
+    delete_cs(watcher->cs);
+
+    watcher->thread          = THREAD_NONE;
+    watcher->directory_count = 0;
+}
+
+u32 poll_file_watcher(File_Watcher *watcher, Array <String> &paths, Allocator alc) {
+    u32 count = 0;
+    
+    enter_cs(watcher->cs);
+
+    const auto now = get_time_since_boot_ms();
+    
+    for (u32 i = 0; i < watcher->changes.count;) {
+        auto &change = watcher->changes[i];
+        
+        if ((s64)(now - change.time) < (s64)watcher->debounce_ms) {
+            i += 1;
+            continue;
+        }
+
+        array_add(paths, copy_string(change.path, alc));
+        release(change.path.data, watcher->changes.allocator);
+        
+        change = array_pop(watcher->changes);
+        count += 1;
+    }
+    
+    leave_cs(watcher->cs);
+    
+    return count;
+}
+
 String extract_file_from_path(String path, Allocator alc) {
     auto cpath = to_c_string(path, alc);
     PathStripPath(cpath);
@@ -266,6 +493,96 @@ void *virtual_commit   (void *vm, u64 size)   { return VirtualAlloc(vm, size, ME
 bool  virtual_decommit (void *vm, u64 size)   { return VirtualFree(vm, size, MEM_DECOMMIT); }
 bool  virtual_release  (void *vm)             { return VirtualFree(vm, 0, MEM_RELEASE); }
 
+// No logging here, first call comes from reserve of arena that may be allocating
+// for logger itself. Whether large pages are used is seen in arena large_pages.
+static bool win32_enable_lock_memory_privilege() {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return false;
+    }
+
+    defer { CloseHandle(token); };
+
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    if (!LookupPrivilegeValue(null, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)) {
+        return false;
+    }
+
+    // AdjustTokenPrivileges succeeds even if privilege was not assigned, so check last error.
+    AdjustTokenPrivileges(token, FALSE, &privileges, 0, null, null);
+    return GetLastError() == ERROR_SUCCESS;
+}
+
+u64 get_large_page_size() {
+    static bool checked = false;
+    static u64  size    = 0;
+
+    if (!checked) {
+        checked = true;
+        if (win32_enable_lock_memory_privilege()) {
+            size = GetLargePageMinimum();
+        }
+    }
+
+    return size;
+}
+
+void *virtual_reserve_large(void *addr, u64 size) {
+    const auto page_size = get_large_page_size();
+    if (!page_size) return null;
+
+    Assert(size % page_size == 0);
+
+    // No logging here, caller may be in the middle of temporary storage overflow.
+    return VirtualAlloc(addr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
+void *virtual_reserve_ring(u64 size) {
+    Assert(size % get_allocation_granularity() == 0);
+
+    auto mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, null, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, null);
+    if (!mapping) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to create ring mapping of size %llu bytes", GetLastError(), size);
+        return null;
+    }
+
+    // Views keep mapping alive.
+    defer { CloseHandle(mapping); };
+
+    constexpr u32 MAX_ATTEMPTS = 16;
+    for (u32 i = 0; i < MAX_ATTEMPTS; ++i) {
+        // Find free address range for both views, then release it and map views there.
+        // Other thread may occupy the range in between, so retry in such case.
+        auto base = (u8 *)VirtualAlloc(null, 2 * size, MEM_RESERVE, PAGE_NOACCESS);
+        if (!base) break;
+        
+        VirtualFree(base, 0, MEM_RELEASE);
+
+        auto view = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, base);
+        if (!view) continue;
+
+        auto mirror = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, base + size);
+        if (!mirror) {
+            UnmapViewOfFile(view);
+            continue;
+        }
+
+        return base;
+    }
+
+    log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to map ring views of size %llu bytes", GetLastError(), size);
+    return null;
+}
+
+bool virtual_release_ring(void *vm, u64 size) {
+    const bool a = UnmapViewOfFile(vm);
+    const bool b = UnmapViewOfFile((u8 *)vm + size);
+    return a && b;
+}
+
 static BOOL win32_wait_res_check(void *handle, DWORD res) {
 	switch (res) {
 	case WAIT_OBJECT_0:
@@ -313,6 +630,105 @@ bool terminate_thread(Thread handle) {
 	return TerminateThread(handle, code);
 }
 
+bool wait_thread(Thread handle, u32 ms) {
+    const DWORD res = WaitForSingleObject(handle, ms);
+    return win32_wait_res_check(handle, res);
+}
+
+bool close_thread(Thread handle) { return CloseHandle(handle); }
+
+Thread get_current_thread() { return GetCurrentThread(); }
+
+bool set_thread_affinity(Thread handle, u64 logical_core_mask) {
+    if (!SetThreadAffinityMask(handle, (DWORD_PTR)logical_core_mask)) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to set thread 0x%X affinity mask 0x%llX", GetLastError(), handle, logical_core_mask);
+        return false;
+    }
+    
+    return true;
+}
+
+static s32 to_win32_thread_priority(Thread_Priority priority) {
+    constexpr s32 lut[] = {
+        THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL,
+        THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_TIME_CRITICAL,
+    };
+    return lut[priority];
+}
+
+bool set_thread_priority(Thread handle, Thread_Priority priority) {
+    if (!SetThreadPriority(handle, to_win32_thread_priority(priority))) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to set thread 0x%X priority %u", GetLastError(), handle, priority);
+        return false;
+    }
+    
+    return true;
+}
+
+bool set_thread_name(Thread handle, String name) {
+    WCHAR wname[128];
+    const s32 length = MultiByteToWideChar(CP_UTF8, 0, (char *)name.data, (s32)name.size, wname, carray_count(wname) - 1);
+    wname[length] = L'\0';
+
+    const auto result = SetThreadDescription(handle, wname);
+    if (FAILED(result)) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to set thread 0x%X name %S", result, handle, name);
+        return false;
+    }
+
+    return true;
+}
+
+const Cpu_Topology *get_cpu_topology() {
+    static Cpu_Topology topology;
+    static bool queried = false;
+
+    if (queried) return &topology;
+    queried = true;
+
+    DWORD size = 0;
+    GetLogicalProcessorInformation(null, &size);
+    
+    auto infos = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)alloc(size, __temporary_allocator);
+    if (!GetLogicalProcessorInformation(infos, &size)) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to get logical processor information", GetLastError());
+        return &topology;
+    }
+
+    const u32 count = size / sizeof(infos[0]);
+    for (u32 i = 0; i < count; ++i) {
+        const auto &info = infos[i];
+        
+        switch (info.Relationship) {
+        case RelationProcessorCore: {
+            if (topology.physical_core_count < MAX_CPU_CORES) {
+                topology.physical_core_masks[topology.physical_core_count] = info.ProcessorMask;
+                topology.physical_core_count += 1;
+            }
+
+            topology.logical_core_count += (u32)__popcnt64(info.ProcessorMask);
+            break;
+        }
+        case RelationCache: {
+            const auto &cache = info.Cache;
+            if (cache.Level < 2) break;
+            if (cache.Type != CacheUnified && cache.Type != CacheData) break;
+            if (topology.cache_group_count >= MAX_CPU_CACHE_GROUPS) break;
+            
+            auto &group = topology.cache_groups[topology.cache_group_count];
+            group.level = cache.Level;
+            group.size  = cache.Size;
+            group.logical_core_mask = info.ProcessorMask;
+            
+            topology.cache_group_count += 1;
+            break;
+        }
+        }
+    }
+
+    return &topology;
+}
+
 Semaphore create_semaphore  (s32 init_count, s32 max_count)                { return CreateSemaphore(NULL, (LONG)init_count, (LONG)max_count, NULL); }
 bool      release_semaphore (Semaphore handle, s32 count, s32 *prev_count) { return ReleaseSemaphore(handle, count, (LPLONG)prev_count); }
 bool      wait_semaphore    (Semaphore handle, u32 ms)                     { return win32_wait_res_check(handle, WaitForSingleObjectEx(handle, ms, FALSE)); }
@@ -351,6 +767,7 @@ void *atomic_cmp_swap  (void **dst, void *val, void *cmp) { return InterlockedCo
 s32   atomic_add       (s32 *dst, s32 val)                { return InterlockedAdd((LONG *)dst, val); }
 s32   atomic_increment (s32 *dst)                         { return InterlockedIncrement((LONG *)dst); }
 s32   atomic_decrement (s32 *dst)                         { return InterlockedDecrement((LONG *)dst); }
+s64   atomic_cmp_swap  (s64 *dst, s64 val, s64 cmp)       { return InterlockedCompareExchange64((LONG64 *)dst, val, cmp); }
 
 u64 get_time_since_boot_ms() { return GetTickCount64(); }
 
@@ -375,6 +792,100 @@ u64 get_perf_hz() {
 u64 get_perf_hz_ms() { static u64 hz = get_perf_hz()    / 1000; return hz; }
 u64 get_perf_hz_us() { static u64 hz = get_perf_hz_ms() / 1000; return hz; }
 
+static bool Cpu_timer_uses_tsc = false;
+static u64  Cpu_timer_hz       = 0;
+
+bool has_invariant_tsc() {
+    s32 regs[4];
+
+    __cpuid(regs, 0x80000000);
+    if ((u32)regs[0] < 0x80000007) return false;
+
+    __cpuid(regs, 0x80000007);
+    return regs[3] & (1 << 8);
+}
+
+void init_cpu_timer() {
+    if (Cpu_timer_hz) return;
+
+    if (!has_invariant_tsc()) {
+        log(LOG_IDENT_WIN32, LOG_WARNING, "Cpu does not have invariant tsc, falling back to perf counter");
+        Cpu_timer_hz = get_perf_hz();
+        return;
+    }
+
+    // Calibrate tsc against perf counter during short busy wait.
+    const u64 perf_hz   = get_perf_hz();
+    const u64 wait_time = perf_hz / 100;
+
+    const u64 perf_start = get_perf_counter();
+    const u64 tsc_start  = __rdtsc();
+
+    u64 perf_end = perf_start;
+    while (perf_end - perf_start < wait_time) {
+        perf_end = get_perf_counter();
+    }
+
+    const u64 tsc_end = __rdtsc();
+
+    Cpu_timer_hz       = (tsc_end - tsc_start) * perf_hz / (perf_end - perf_start);
+    Cpu_timer_uses_tsc = true;
+
+    log(LOG_IDENT_WIN32, LOG_VERBOSE, "Calibrated invariant tsc to %.3fGHz", Cpu_timer_hz / 1e9);
+}
+
+bool is_cpu_timer_tsc() { return Cpu_timer_uses_tsc; }
+
+u64 get_cpu_cycles() {
+    if (Cpu_timer_uses_tsc) return __rdtsc();
+    return get_perf_counter();
+}
+
+u64 get_cpu_cycles_serialized() {
+    if (Cpu_timer_uses_tsc) {
+        u32 aux;
+        return __rdtscp(&aux);
+    }
+    return get_perf_counter();
+}
+
+u64 get_cpu_hz() {
+    if (!Cpu_timer_hz) init_cpu_timer();
+    return Cpu_timer_hz;
+}
+
+u64 get_cpu_hz_ms() { static u64 hz = get_cpu_hz()    / 1000; return hz; }
+u64 get_cpu_hz_us() { static u64 hz = get_cpu_hz_ms() / 1000; return hz; }
+
+u64 cycles_to_ns(u64 cycles) {
+    // Split to whole seconds and remainder to avoid overflow on large deltas.
+    const u64 hz = get_cpu_hz();
+    return (cycles / hz) * 1000000000 + (cycles % hz) * 1000000000 / hz;
+}
+
+u64 get_thread_cpu_time_ns() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to get thread times", GetLastError());
+        return 0;
+    }
+
+    const u64 kernel_time = ((u64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    const u64 user_time   = ((u64)user.dwHighDateTime   << 32) | user.dwLowDateTime;
+
+    return (kernel_time + user_time) * 100; // filetime is in 100ns units
+}
+
+u64 get_thread_cpu_cycles() {
+    ULONG64 cycles = 0;
+    if (!QueryThreadCycleTime(GetCurrentThread(), &cycles)) {
+        log(LOG_IDENT_WIN32, LOG_ERROR, "[0x%X] Failed to query thread cycle time", GetLastError());
+        return 0;
+    }
+
+    return cycles;
+}
+
 static LRESULT CALLBACK win32_window_proc(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lparam) {        
 	auto *w = (Window *)GetProp(hwnd, window_prop_name);
 	if (!w) return DefWindowProc(hwnd, umsg, wparam, lparam);
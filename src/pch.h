@@ -13,7 +13,7 @@
 // typedef u64 sid; // string id
 // typedef u32 eid; // entity id
 
-#if OPEN_GL
+#if OPEN_GL || NULL_GPU
 //typedef u32 rid; // render id, used by underlying gfx api
 #else
 #error "Unsupported graphics api"
@@ -115,7 +115,7 @@ struct Rect {
 void sort (void *data, u32 count, u32 size, s32 (*compare)(const void *, const void *));
 
 inline constexpr u32 MAX_DIRECT_LIGHTS = 4;
-inline constexpr u32 MAX_POINT_LIGHTS  = 32;
+inline constexpr u32 MAX_POINT_LIGHTS  = 1024; // binned to clusters, see light_cluster.h
 
 struct Time_Info {
     u64 frame_start_counter = 0;
@@ -281,11 +281,18 @@ u64   cstring_count   (const char *s);
 s64   cstring_compare (const char *a, const char *b);
 s64   cstring_compare (const char *a, const char *b, u64 n);
 
+inline constexpr u32 UTF8_REPLACEMENT = 0xFFFD;
+
+// Decode utf-8 codepoint at *i and advance *i past it, invalid or truncated
+// sequence decodes to UTF8_REPLACEMENT and skips one byte.
+u32   utf8_next       (const u8 *data, u64 size, u64 *i);
+
 f32 Floor (f32 f);
 f32 Ceil  (f32 f);
 f32 Sqrt  (f32 f);
 f32 Rsqrt (f32 f);
 f32 Log2  (f32 f);
+f32 Pow   (f32 b, f32 e);
 f32 Sin   (f32 r);
 f32 Cos   (f32 r);
 f32 Tan   (f32 r);
@@ -4,17 +4,17 @@
 #include "cpu_time.h"
 
 #define TIMER_NAME(name)     __concat(_timer_, name)
-#define START_TIMER(name)    const auto TIMER_NAME(name) = get_perf_counter()
-#define CHECK_TIMER(name)    (get_perf_counter() - TIMER_NAME(name)) / (f32)get_perf_hz()
-#define CHECK_TIMER_MS(name) (get_perf_counter() - TIMER_NAME(name)) / (f32)get_perf_hz_ms()
+#define START_TIMER(name)    const auto TIMER_NAME(name) = get_cpu_cycles()
+#define CHECK_TIMER(name)    (get_cpu_cycles() - TIMER_NAME(name)) / (f32)get_cpu_hz()
+#define CHECK_TIMER_MS(name) (get_cpu_cycles() - TIMER_NAME(name)) / (f32)get_cpu_hz_ms()
 
 #define SCOPE_TIMER(info) const Scope_Timer TIMER_NAME(__LINE__)(info)
 struct Scope_Timer {
     const char *info = null;
 	u64 start = 0;
     
-	Scope_Timer(const char *info) : info(info), start(get_perf_counter()) {}
-	~Scope_Timer() { log("%s %.2fms", info, (f32)(get_perf_counter() - start) / get_perf_hz_ms()); }
+	Scope_Timer(const char *info) : info(info), start(get_cpu_cycles()) {}
+	~Scope_Timer() { log("%s %.2fms", info, (f32)(get_cpu_cycles() - start) / get_cpu_hz_ms()); }
 };
 
 enum Profiler_View_Mode : u8 {
@@ -59,10 +59,7 @@ void gpu_memory_barrier() {
 }
 
 bool post_init_render_backend() {
-    auto read_buffer  = gpu_get_buffer(gpu_read_allocator.buffer);
-    auto write_buffer = gpu_get_buffer(gpu_write_allocator.buffer);
-
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, write_buffer->handle._u32);
+    auto read_buffer = gpu_get_buffer(gpu_read_allocator.buffer);
 
     // @Cleanup: make it less hardcoded
     auto gpu_allocation = gpu_alloc(sizeof(Gpu_Picking_Data), &gpu_read_allocator);
@@ -90,8 +87,10 @@ void gpu_flush_cmd_buffer(u32 cmd_buffer) {
 
     auto gpu_cmd_buffer = gpu_get_command_buffer(cmd_buffer);
     
-    for (u32 i = 0; i < gpu_cmd_buffer->count; ++i) {
-        const auto &cmd = gpu_cmd_buffer->commands[i];
+    auto it = gpu_iterate_cmds(gpu_cmd_buffer);
+    Gpu_Command cmd;
+    
+    while (gpu_next_cmd(&it, &cmd)) {
         switch (cmd.type) {
         case GPU_CMD_NONE: {
             log(LOG_IDENT_GL, LOG_ERROR, "Empty gpu command 0x%X in gpu command buffer 0x%X", &cmd, gpu_cmd_buffer);
@@ -264,6 +263,22 @@ void gpu_flush_cmd_buffer(u32 cmd_buffer) {
             
             break;
         }
+        case GPU_CMD_STORAGE_BUFFER: {
+            const auto buffer = gpu_get_buffer(cmd.bind_resource);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, cmd.bind_index, buffer->handle._u32, cmd.bind_offset, cmd.bind_size);
+            break;
+        }
+        case GPU_CMD_MEMORY_BARRIER: {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                            GL_TEXTURE_FETCH_BARRIER_BIT  | GL_FRAMEBUFFER_BARRIER_BIT);
+            break;
+        }
+        case GPU_CMD_COPY_BUFFER: {
+            const auto src = gpu_get_buffer(cmd.copy_src);
+            const auto dst = gpu_get_buffer(cmd.copy_dst);
+            glCopyNamedBufferSubData(src->handle._u32, dst->handle._u32, cmd.copy_src_offset, cmd.copy_dst_offset, cmd.copy_size);
+            break;
+        }
         case GPU_CMD_DRAW: {
             const auto gl_topology = to_gl_topology_mode(cmd.topology);
             glDrawArraysInstancedBaseInstance(gl_topology, cmd.first_draw, cmd.draw_count,
@@ -273,9 +288,9 @@ void gpu_flush_cmd_buffer(u32 cmd_buffer) {
         }
         case GPU_CMD_DRAW_INDEXED: {
             const auto gl_topology = to_gl_topology_mode(cmd.topology);
-            glDrawElementsInstancedBaseInstance(gl_topology, cmd.draw_count, index_type,
-                                                (const void *)(u64)(cmd.first_draw * index_size),
-                                                cmd.instance_count, cmd.first_instance);
+            glDrawElementsInstancedBaseVertexBaseInstance(gl_topology, cmd.draw_count, index_type,
+                                                          (const void *)(u64)(cmd.first_draw * index_size),
+                                                          cmd.instance_count, cmd.base_vertex, cmd.first_instance);
             inc_draw_call_count();
             break;
         }
@@ -289,6 +304,9 @@ void gpu_flush_cmd_buffer(u32 cmd_buffer) {
             //                                                   -alex, Oct 31 2025
             
         case GPU_CMD_DRAW_INDIRECT: {
+            const auto buffer = gpu_get_buffer(cmd.indirect_buffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer->handle._u32);
+            
             const auto gl_topology = to_gl_topology_mode(cmd.topology);
             const auto offset = cmd.indirect_offset;
             glMultiDrawArraysIndirect(gl_topology, (const void *)offset, cmd.indirect_count, cmd.indirect_stride);
@@ -296,6 +314,9 @@ void gpu_flush_cmd_buffer(u32 cmd_buffer) {
             break;
         }
         case GPU_CMD_DRAW_INDEXED_INDIRECT: {
+            const auto buffer = gpu_get_buffer(cmd.indirect_buffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer->handle._u32);
+            
             const auto gl_topology = to_gl_topology_mode(cmd.topology);
             const u64 offset = cmd.indirect_offset;
             glMultiDrawElementsIndirect(gl_topology, index_type, (const void *)offset, cmd.indirect_count, cmd.indirect_stride);
@@ -305,7 +326,7 @@ void gpu_flush_cmd_buffer(u32 cmd_buffer) {
         }
     }
 
-    gpu_cmd_buffer->count = 0;
+    gpu_reset_cmd_buffer(gpu_cmd_buffer);
 }
 
 u32 read_pixel(u32 color_attachment_index, u32 x, u32 y) {
@@ -420,6 +441,7 @@ void gpu_init_backend() {
 
 u32 gpu_uniform_buffer_max_size         () { s32 v = 0; glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &v); return v; }
 u32 gpu_uniform_buffer_offset_alignment () { s32 v = 0; glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &v); return v; }
+u32 gpu_storage_buffer_offset_alignment () { s32 v = 0; glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &v); return v; }
 u32 gpu_image_max_size                  () { s32 v = 0; glGetIntegerv(GL_MAX_TEXTURE_SIZE, &v); return v; }
 u32 gpu_vertex_attribute_max_count      () { s32 v = 0; glGetIntegerv(GL_MAX_VERTEX_ATTRIB_BINDINGS, &v); return v; }
 
@@ -561,6 +583,20 @@ u32 gpu_new_image(Gpu_Image_Type type, Gpu_Image_Format format, u32 mipmap_count
     return index;
 }
 
+void gpu_update_image(u32 image, u32 mipmap, u32 x, u32 y, u32 width, u32 height, const void *data) {
+    const auto &gpu_image = gpu.images[image];
+    Assert(mipmap < gpu_image.mipmap_count);
+    Assert(x + width  <= gpu_image.width);
+    Assert(y + height <= gpu_image.height);
+
+    const auto gl_format    = to_gl_format(gpu_image.format);
+    const auto gl_data_type = to_gl_data_type(gpu_image.format);
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, to_gl_unpack_alignment(gpu_image.format));
+    glTextureSubImage2D(gpu_image.handle._u32, mipmap, x, y, width, height, gl_format, gl_data_type, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 u32 gpu_new_image_view(u32 image, Gpu_Image_Type type, Gpu_Image_Format format, u32 mipmap_min, u32 mipmap_count, u32 depth_min, u32 depth_size) {
     const auto index = gpu_next_index(gpu.image_views, gpu.free_image_views);
     
@@ -754,15 +790,13 @@ u32 gpu_new_framebuffer(u32 width, u32 height, const Gpu_Image_Format *color_for
     return index;
 }
 
-u32 gpu_new_command_buffer(u32 capacity) {
+u32 gpu_new_command_buffer(u32 page_size) {
     const auto index = gpu_next_index(gpu.cmd_buffers, gpu.free_cmd_buffers);
 
     auto &cmd_buffer = gpu.cmd_buffers[index];
     auto &gl_id      = cmd_buffer.handle._u32; Assert(!gl_id); // opengl does not support command buffers
 
-    cmd_buffer.commands = New(Gpu_Command, capacity);
-    cmd_buffer.count    = 0;
-    cmd_buffer.capacity = capacity;
+    gpu_init_cmd_buffer(&cmd_buffer, page_size);
 
     return index;
 }
@@ -910,9 +944,10 @@ void gpu_delete_framebuffer(u32 index) {
 
         gpu_delete_image_view(attachment);
         gpu_delete_image(image_view->image);
+        framebuffer.depth_attachment = 0;
     }
 
-    gpu_delete_gl_resource(index, gpu.buffers, gpu.free_buffers, glDeleteFramebuffers);
+    gpu_delete_gl_resource(index, gpu.framebuffers, gpu.free_framebuffers, glDeleteFramebuffers);
 }
 
 Handle gpu_fence_sync() {
@@ -177,6 +177,7 @@ enum Gpu_Resource_Type : u8 {
     GPU_TEXTURE_2D_ARRAY,
     GPU_CONSTANT_BUFFER,
     GPU_MUTABLE_BUFFER,
+    GPU_STRUCTURED_BUFFER,
 };
 
 enum Gpu_Command_Type : u8 {
@@ -208,6 +209,9 @@ enum Gpu_Command_Type : u8 {
     GPU_CMD_INDEX_BUFFER,
     GPU_CMD_FRAMEBUFFER,
     GPU_CMD_CBUFFER_INSTANCE,
+    GPU_CMD_STORAGE_BUFFER,
+    GPU_CMD_MEMORY_BARRIER, // makes shader writes visible to following commands
+    GPU_CMD_COPY_BUFFER,    // copies buffer range on gpu, ranges must not overlap
 
     // Draw commands issue an actual draw call.
     GPU_CMD_DRAW,
@@ -338,6 +342,7 @@ struct Gpu_Command {
         
         struct { s32 x; s32 y; u32 w; u32 h; };
         struct { u32 bind_resource; u32 bind_index; u32 bind_stride; u64 bind_offset; u64 bind_size; };
+        struct { u32 copy_src; u32 copy_dst; u64 copy_src_offset; u64 copy_dst_offset; u64 copy_size; };
         struct { Color4f clear_color; u32 clear_bits; };
         struct { Gpu_Blend_Function blend_src; Gpu_Blend_Function blend_dst; };
         struct { Gpu_Stencil_Function stencil_test; u32 stencil_ref; u32 stencil_mask; };
@@ -346,18 +351,55 @@ struct Gpu_Command {
         struct {
             Gpu_Topology_Mode topology;
             union {
-                struct { u32 draw_count; u32 instance_count; u32 first_draw; u32 first_instance; };
-                struct { u64 indirect_offset; u32 indirect_count; u32 indirect_stride; void *indirect_data; };
+                struct { u32 draw_count; u32 instance_count; u32 first_draw; u32 first_instance; s32 base_vertex; };
+                struct { u64 indirect_offset; u32 indirect_count; u32 indirect_stride; u32 indirect_buffer; };
             };
         };
     };
 };
 
+// Binds recorded since command buffer was last flushed, used to drop commands
+// that would bind the same state again. Unknown state is all ones.
+struct Gpu_Command_State {
+    static constexpr u32 MAX_BINDINGS = 16;
+
+    struct Buffer_Range { u32 buffer; u64 offset; u64 size; };
+    
+    Handle       shader;
+    u32          vertex_input;
+    u32          index_buffer;
+    u32          framebuffer;
+    u32          image_views     [MAX_BINDINGS];
+    u32          samplers        [MAX_BINDINGS];
+    Buffer_Range vertex_buffers  [MAX_BINDINGS]; // size is stride
+    Buffer_Range cbuffers        [MAX_BINDINGS];
+    Buffer_Range storage_buffers [MAX_BINDINGS];
+};
+
+// Commands are recorded packed as 1 byte type followed by payload of the size
+// needed by that type into chain of pages. Chain grows on demand and its pages
+// are reused after flush, commands never cross page boundary.
+struct Gpu_Command_Page {
+    Gpu_Command_Page *next;
+    u32               used;
+    u32               capacity;
+    u8               *data;
+};
+
 struct Gpu_Command_Buffer {
-    Handle       handle;
-    Gpu_Command *commands;
-    u32          count;
-    u32          capacity;
+    Handle            handle;
+    Gpu_Command_Page *first_page;
+    Gpu_Command_Page *current_page;
+    u32               page_size;
+    u32               count; // commands recorded since last flush
+    u64               size;  // bytes recorded since last flush
+    Gpu_Command_State state;
+};
+
+// Decodes packed commands of command buffer one by one, see gpu_next_cmd.
+struct Gpu_Command_Iterator {
+    const Gpu_Command_Page *page = null;
+    u32 pos = 0;
 };
 
 struct Gpu_Vertex_Attribute {
@@ -432,6 +474,7 @@ struct Gpu {
     u32                        default_image;
     u32                        default_image_view;
     u32                        sampler_default_color;
+    u32                        sampler_linear_color;
     u32                        sampler_default_depth_stencil;
     u32                        default_framebuffer;
     u32                        vertex_input_entity;
@@ -443,11 +486,13 @@ void                gpu_init_backend                    ();
 void                gpu_init_frontend                   ();
 u32                 gpu_uniform_buffer_max_size         ();
 u32                 gpu_uniform_buffer_offset_alignment ();
+u32                 gpu_storage_buffer_offset_alignment ();
 u32                 gpu_image_max_size                  ();
 u32                 gpu_vertex_attribute_max_count      ();
 u32                 gpu_new_buffer                      (Gpu_Buffer_Type type, u64 size);
 u32                 gpu_new_image                       (Gpu_Image_Type type, Gpu_Image_Format format, u32 mipmap_count, 
                                                          u32 width, u32 height, u32 depth, const void *base_data);
+void                gpu_update_image                    (u32 image, u32 mipmap, u32 x, u32 y, u32 width, u32 height, const void *data); // 2d region
 u32                 gpu_new_image_view                  (u32 image, Gpu_Image_Type type, Gpu_Image_Format format,
                                                          u32 mipmap_min, u32 mipmap_count, u32 depth_min, u32 depth_size);
 u32                 gpu_new_sampler                     (Gpu_Sampler_Filter filter_min, Gpu_Sampler_Filter filter_mag,
@@ -456,7 +501,7 @@ u32                 gpu_new_sampler                     (Gpu_Sampler_Filter filt
                                                          f32 lod_min, f32 lod_max, Color4f color_border);
 u32                 gpu_new_shader                      (Gpu_Shader_Stage_Type stage, Buffer source);
 u32                 gpu_new_framebuffer                 (u32 width, u32 height, const Gpu_Image_Format *color_formats, u32 color_format_count, Gpu_Image_Format depth_format);
-u32                 gpu_new_command_buffer              (u32 capacity);
+u32                 gpu_new_command_buffer              (u32 page_size);
 u32                 gpu_new_vertex_input                (const Gpu_Vertex_Binding *bindings, u32 count, const Gpu_Vertex_Attribute *attributes, u32 attribute_count);
 u32                 gpu_new_descriptor                  (const Gpu_Descriptor_Binding *bindings, u32 count);
 u32                 gpu_new_pipeline                    (u32 vertex_input, u32 *shaders, u32 shader_count, u32 *descriptors, u32 descriptor_count);
@@ -484,6 +529,11 @@ Gpu_Allocation      gpu_alloc                           (u64 size, u64 alignment
 void                gpu_release                         (Gpu_Allocation *memory,  Gpu_Allocator *alc);
 void                gpu_append                          (Gpu_Allocation *memory, const void *data, u64 size);
 void                gpu_flush_cmd_buffer                (u32 cmd_buffer);
+void                gpu_init_cmd_buffer                 (Gpu_Command_Buffer *buffer, u32 page_size);
+void                gpu_reset_cmd_buffer                (Gpu_Command_Buffer *buffer);
+Gpu_Command_Iterator gpu_iterate_cmds                   (const Gpu_Command_Buffer *buffer);
+bool                gpu_next_cmd                        (Gpu_Command_Iterator *it, Gpu_Command *cmd);
+u32                 gpu_push_cmd                        (Gpu_Command_Buffer *buffer, const Gpu_Command &cmd); // returns packed size
 void                gpu_add_cmds                        (u32 cmd_buffer, Gpu_Command *cmds, u32 count);
 void                gpu_cmd_polygon                     (u32 cmd_buffer, Gpu_Polygon_Mode mode);
 void                gpu_cmd_viewport                    (u32 cmd_buffer, s32 x, s32 y, u32 w, u32 h);
@@ -510,11 +560,14 @@ void                gpu_cmd_vertex_buffer               (u32 cmd_buffer, u32 buf
 //void                gpu_cmd_vertex_binding        (u32 cmd_buffer, Vertex_Binding *binding, Handle descriptor_handle);
 void                gpu_cmd_index_buffer                (u32 cmd_buffer, u32 buffer);
 void                gpu_cmd_cbuffer_instance            (u32 cmd_buffer, struct Constant_Buffer_Instance *instance);
+void                gpu_cmd_storage_buffer              (u32 cmd_buffer, u32 buffer, u32 binding, u64 offset, u64 size);
 void                gpu_cmd_framebuffer                 (u32 cmd_buffer, u32 framebuffer);
+void                gpu_cmd_memory_barrier              (u32 cmd_buffer);
+void                gpu_cmd_copy_buffer                 (u32 cmd_buffer, u32 src, u64 src_offset, u32 dst, u64 dst_offset, u64 size);
 void                gpu_cmd_draw                        (u32 cmd_buffer, Gpu_Topology_Mode topology, u32 vertex_count, u32 instance_count, u32 first_vertex, u32 first_instance);
-void                gpu_cmd_draw_indexed                (u32 cmd_buffer, Gpu_Topology_Mode topology, u32 index_count, u32 instance_count, u32 first_index, u32 first_instance);
-void                gpu_cmd_draw_indirect               (u32 cmd_buffer, Gpu_Topology_Mode topology, void *data, u32 offset, u32 count, u32 stride);
-void                gpu_cmd_draw_indirect_indexed       (u32 cmd_buffer, Gpu_Topology_Mode topology, void *data, u32 offset, u32 count, u32 stride);
+void                gpu_cmd_draw_indexed                (u32 cmd_buffer, Gpu_Topology_Mode topology, u32 index_count, u32 instance_count, u32 first_index, s32 base_vertex, u32 first_instance);
+void                gpu_cmd_draw_indirect               (u32 cmd_buffer, Gpu_Topology_Mode topology, u32 buffer, u64 offset, u32 count, u32 stride);
+void                gpu_cmd_draw_indirect_indexed       (u32 cmd_buffer, Gpu_Topology_Mode topology, u32 buffer, u64 offset, u32 count, u32 stride);
 u32                 gpu_max_mipmap_count                (u32 width, u32 height);
 Gpu_Image_Format    gpu_image_format_from_channel_count (u32 channel_count);
 u32                 gpu_vertex_attribute_size           (Gpu_Vertex_Attribute_Type type);
@@ -541,6 +594,20 @@ inline String to_string(Gpu_Shader_Stage_Type stage) {
     return lut[stage];
 }
 
+inline String to_string(Gpu_Command_Type type) {
+    static const String lut[] = {
+        S("none"), S("polygon"), S("viewport"), S("scissor"), S("scissor_test"),
+        S("cull_face"), S("winding"), S("blend_test"), S("blend_func"),
+        S("depth_test"), S("depth_write"), S("depth_func"), S("stencil_mask"),
+        S("stencil_func"), S("stencil_op"), S("clear"), S("shader"), S("image_view"),
+        S("sampler"), S("vertex_input"), S("vertex_binding"), S("vertex_buffer"),
+        S("index_buffer"), S("framebuffer"), S("cbuffer_instance"), S("storage_buffer"),
+        S("memory_barrier"), S("copy_buffer"), S("draw"), S("draw_indexed"), S("draw_indirect"), S("draw_indexed_indirect"),
+    };
+    static_assert(carray_count(lut) == GPU_CMD_COUNT);
+    return lut[type];
+}
+
 inline Gpu           gpu;
 inline Gpu_Allocator gpu_read_allocator;
 inline Gpu_Allocator gpu_write_allocator;
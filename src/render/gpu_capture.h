@@ -0,0 +1,51 @@
+#pragma once
+
+#include "gpu.h"
+
+inline constexpr u32 GPU_CAPTURE_MAGIC   = U32_PACK('g', 'c', 'a', 'p');
+inline constexpr u32 GPU_CAPTURE_VERSION = 3;
+
+// Gpu capture format specification.
+// 1. Gpu_Capture_Header
+// 2. Buffers, for each: Gpu_Buffer, u64 data size and mapped buffer contents.
+// 3. Gpu_Image, Gpu_Image_View and Gpu_Sampler arrays as is.
+// 4. Framebuffers, for each: Gpu_Framebuffer and its color attachment indices.
+// 5. Vertex inputs, for each: Gpu_Vertex_Input, its bindings and attributes.
+// 6. Packed command stream of one command buffer, see Gpu_Command_Buffer.
+//
+// Resources keep indices commands refer to, pointers and handles stored along
+// are meaningless on load and replaced. Image contents and shader programs are
+// not captured, so capture can be decoded and validated offline, but not drawn.
+
+struct Gpu_Capture_Header {
+    u32 magic              = 0;
+    u32 version            = 0;
+    u64 frame_index        = 0;
+    u32 buffer_count       = 0;
+    u32 image_count        = 0;
+    u32 image_view_count   = 0;
+    u32 sampler_count      = 0;
+    u32 framebuffer_count  = 0;
+    u32 vertex_input_count = 0;
+    u32 command_count      = 0;
+    u32 reserved           = 0;
+    u64 command_size       = 0; // bytes of packed command stream
+};
+
+struct Gpu_Capture {
+    Allocator allocator = context.allocator;
+    
+    Gpu_Capture_Header       header;
+    Array <Gpu_Buffer>       buffers;
+    Array <Gpu_Image>        images;
+    Array <Gpu_Image_View>   image_views;
+    Array <Gpu_Sampler>      samplers;
+    Array <Gpu_Framebuffer>  framebuffers;
+    Array <Gpu_Vertex_Input> vertex_inputs;
+    Gpu_Command_Page         command_page; // whole command stream, see gpu_iterate_cmds
+};
+
+bool                 save_gpu_capture    (String path, const Gpu_Command_Buffer *buffer);
+bool                 load_gpu_capture    (String path, Gpu_Capture *capture);
+Gpu_Command_Iterator gpu_iterate_cmds    (const Gpu_Capture *capture);
+void                 request_gpu_capture (); // saves command buffer of the next rendered frame
@@ -0,0 +1,315 @@
+#include "pch.h"
+#include "gpu.h"
+#include "gpu_capture.h"
+#include "archive.h"
+
+// Payload of each command type is a prefix of command union, so its size is
+// the end of the last member used by that type.
+#define Gpu_Cmd_Payload_Start      offsetof(Gpu_Command, polygon)
+#define Gpu_Cmd_Payload_Until(m)   (u32)(offsetof(Gpu_Command, m) + sizeof(((Gpu_Command *)0)->m) - Gpu_Cmd_Payload_Start)
+
+static u32 gpu_cmd_payload_size(Gpu_Command_Type type) {
+    switch (type) {
+    case GPU_CMD_NONE:
+    case GPU_CMD_MEMORY_BARRIER:   return 0;
+    case GPU_CMD_POLYGON:          return Gpu_Cmd_Payload_Until(polygon);
+    case GPU_CMD_VIEWPORT:
+    case GPU_CMD_SCISSOR:          return Gpu_Cmd_Payload_Until(h);
+    case GPU_CMD_SCISSOR_TEST:     return Gpu_Cmd_Payload_Until(scissor_test);
+    case GPU_CMD_CULL_FACE:        return Gpu_Cmd_Payload_Until(cull_face);
+    case GPU_CMD_WINDING:          return Gpu_Cmd_Payload_Until(winding);
+    case GPU_CMD_BLEND_TEST:       return Gpu_Cmd_Payload_Until(blend_test);
+    case GPU_CMD_BLEND_FUNC:       return Gpu_Cmd_Payload_Until(blend_dst);
+    case GPU_CMD_DEPTH_TEST:       return Gpu_Cmd_Payload_Until(depth_test);
+    case GPU_CMD_DEPTH_WRITE:      return Gpu_Cmd_Payload_Until(depth_write);
+    case GPU_CMD_DEPTH_FUNC:       return Gpu_Cmd_Payload_Until(depth_func);
+    case GPU_CMD_STENCIL_MASK:     return Gpu_Cmd_Payload_Until(stencil_global_mask);
+    case GPU_CMD_STENCIL_FUNC:     return Gpu_Cmd_Payload_Until(stencil_mask);
+    case GPU_CMD_STENCIL_OP:       return Gpu_Cmd_Payload_Until(stencil_depth_fail);
+    case GPU_CMD_CLEAR:            return Gpu_Cmd_Payload_Until(clear_bits);
+    case GPU_CMD_SHADER:           return Gpu_Cmd_Payload_Until(resource_handle);
+    case GPU_CMD_IMAGE_VIEW:
+    case GPU_CMD_SAMPLER:          return Gpu_Cmd_Payload_Until(bind_index);
+    case GPU_CMD_VERTEX_INPUT:
+    case GPU_CMD_INDEX_BUFFER:
+    case GPU_CMD_FRAMEBUFFER:      return Gpu_Cmd_Payload_Until(bind_resource);
+    case GPU_CMD_VERTEX_BUFFER:    return Gpu_Cmd_Payload_Until(bind_offset);
+    case GPU_CMD_CBUFFER_INSTANCE:
+    case GPU_CMD_STORAGE_BUFFER:   return Gpu_Cmd_Payload_Until(bind_size);
+    case GPU_CMD_COPY_BUFFER:      return Gpu_Cmd_Payload_Until(copy_size);
+    case GPU_CMD_DRAW:             return Gpu_Cmd_Payload_Until(first_instance);
+    case GPU_CMD_DRAW_INDEXED:     return Gpu_Cmd_Payload_Until(base_vertex);
+    case GPU_CMD_DRAW_INDIRECT:
+    case GPU_CMD_DRAW_INDEXED_INDIRECT: return Gpu_Cmd_Payload_Until(indirect_buffer);
+    }
+
+    return sizeof(Gpu_Command) - Gpu_Cmd_Payload_Start;
+}
+
+static Gpu_Command_Page *gpu_new_cmd_page(u32 size) {
+    auto page = (Gpu_Command_Page *)alloc(sizeof(Gpu_Command_Page) + size);
+    page->next     = null;
+    page->used     = 0;
+    page->capacity = size;
+    page->data     = (u8 *)(page + 1);
+    return page;
+}
+
+void gpu_init_cmd_buffer(Gpu_Command_Buffer *buffer, u32 page_size) {
+    Assert(page_size >= sizeof(Gpu_Command));
+    
+    buffer->page_size    = page_size;
+    buffer->first_page   = gpu_new_cmd_page(page_size);
+    buffer->current_page = buffer->first_page;
+    buffer->count        = 0;
+    buffer->size         = 0;
+}
+
+void gpu_reset_cmd_buffer(Gpu_Command_Buffer *buffer) {
+    for (auto page = buffer->first_page; page; page = page->next) {
+        if (page->used == 0) break;
+        page->used = 0;
+    }
+    
+    buffer->current_page = buffer->first_page;
+    buffer->count        = 0;
+    buffer->size         = 0;
+}
+
+Gpu_Command_Iterator gpu_iterate_cmds(const Gpu_Command_Buffer *buffer) {
+    Gpu_Command_Iterator it;
+    it.page = buffer->first_page;
+    it.pos  = 0;
+    return it;
+}
+
+bool gpu_next_cmd(Gpu_Command_Iterator *it, Gpu_Command *cmd) {
+    if (!it->page) return false;
+    
+    if (it->pos >= it->page->used) {
+        // Pages after the first empty one are empty as well.
+        const auto next = it->page->next;
+        if (!next || next->used == 0) return false;
+
+        it->page = next;
+        it->pos  = 0;
+    }
+
+    const u8 *data = it->page->data + it->pos;
+    
+    cmd->type = (Gpu_Command_Type)data[0];
+    const u32 payload_size = gpu_cmd_payload_size(cmd->type);
+    copy((u8 *)cmd + Gpu_Cmd_Payload_Start, data + 1, payload_size);
+
+    it->pos += 1 + payload_size;
+    return true;
+}
+
+static u32 gpu_encode_cmd(u8 *data, const Gpu_Command &cmd) {
+    const u32 payload_size = gpu_cmd_payload_size(cmd.type);
+    
+    data[0] = cmd.type;
+    copy(data + 1, (const u8 *)&cmd + Gpu_Cmd_Payload_Start, payload_size);
+
+    return 1 + payload_size;
+}
+
+u32 gpu_push_cmd(Gpu_Command_Buffer *buffer, const Gpu_Command &cmd) {
+    const u32 size = 1 + gpu_cmd_payload_size(cmd.type);
+        
+    auto page = buffer->current_page;
+    if (page->used + size > page->capacity) {
+        if (!page->next) page->next = gpu_new_cmd_page(buffer->page_size);
+        page = buffer->current_page = page->next;
+    }
+
+    gpu_encode_cmd(page->data + page->used, cmd);
+        
+    page->used    += size;
+    buffer->size  += size;
+    buffer->count += 1;
+
+    return size;
+}
+
+// capture
+
+template <typename T>
+static bool serialize_array(Archive &archive, Array <T> &array, u32 count) {
+    if (archive.mode == ARCHIVE_MODE_READ) {
+        array_clear  (array);
+        array_realloc(array, count);
+        array.count = count;
+    }
+
+    const u64 size = (u64)count * sizeof(T);
+    return serialize(archive, array.items, size) == size;
+}
+
+template <typename T>
+static bool serialize_items(Archive &archive, T *&items, u64 count, Allocator alc) {
+    if (archive.mode == ARCHIVE_MODE_READ) {
+        items = count ? New(T, count, alc) : null;
+    }
+
+    const u64 size = (u64)count * sizeof(T);
+    return serialize(archive, items, size) == size;
+}
+
+static bool serialize(Archive &archive, Gpu_Capture &capture) {
+    const bool reading = archive.mode == ARCHIVE_MODE_READ;
+    const auto alc = capture.allocator;
+    
+    auto &header = capture.header;
+    if (serialize(archive, header) != sizeof(header)) return false;
+
+    if (reading) {
+        if (header.magic != GPU_CAPTURE_MAGIC) {
+            log(LOG_ERROR, "Invalid gpu capture magic %u, expected %u", header.magic, GPU_CAPTURE_MAGIC);
+            return false;
+        }
+
+        // Command payloads are not versioned, so only exact version is decoded.
+        if (header.version != GPU_CAPTURE_VERSION) {
+            log(LOG_ERROR, "Unsupported gpu capture version %u, expected %u", header.version, GPU_CAPTURE_VERSION);
+            return false;
+        }
+
+        capture.buffers.allocator       = alc;
+        capture.images.allocator        = alc;
+        capture.image_views.allocator   = alc;
+        capture.samplers.allocator      = alc;
+        capture.framebuffers.allocator  = alc;
+        capture.vertex_inputs.allocator = alc;
+    }
+
+    if (!serialize_array(archive, capture.buffers, header.buffer_count)) return false;
+    
+    For (capture.buffers) {
+        // Deleted buffers keep their mapped pointer, but not handle.
+        u64 data_size = 0;
+        if (!reading && it.handle._u32 && it.mapped_data) data_size = it.size;
+
+        serialize(archive, data_size);
+        
+        auto data = (u8 *)it.mapped_data;
+        if (!serialize_items(archive, data, data_size, alc)) return false;
+        if (reading) it.mapped_data = data;
+    }
+
+    if (!serialize_array(archive, capture.images,      header.image_count))      return false;
+    if (!serialize_array(archive, capture.image_views, header.image_view_count)) return false;
+    if (!serialize_array(archive, capture.samplers,    header.sampler_count))    return false;
+
+    if (!serialize_array(archive, capture.framebuffers, header.framebuffer_count)) return false;
+    
+    For (capture.framebuffers) {
+        auto color_attachments = it.color_attachments;
+        if (!serialize_items(archive, color_attachments, it.color_attachment_count, alc)) return false;
+        if (reading) it.color_attachments = color_attachments;
+    }
+
+    if (!serialize_array(archive, capture.vertex_inputs, header.vertex_input_count)) return false;
+
+    For (capture.vertex_inputs) {
+        auto bindings   = it.bindings;
+        auto attributes = it.attributes;
+        if (!serialize_items(archive, bindings,   it.binding_count,   alc)) return false;
+        if (!serialize_items(archive, attributes, it.attribute_count, alc)) return false;
+        
+        if (reading) {
+            it.bindings   = bindings;
+            it.attributes = attributes;
+        }
+    }
+
+    auto &page = capture.command_page;
+    if (reading) {
+        page.next     = null;
+        page.used     = (u32)header.command_size;
+        page.capacity = (u32)header.command_size;
+    }
+
+    auto data = page.data;
+    if (!serialize_items(archive, data, header.command_size, alc)) return false;
+    if (reading) page.data = data;
+    
+    return true;
+}
+
+bool save_gpu_capture(String path, const Gpu_Command_Buffer *buffer) {
+    Gpu_Capture capture;
+    capture.buffers       = gpu.buffers;
+    capture.images        = gpu.images;
+    capture.image_views   = gpu.image_views;
+    capture.samplers      = gpu.samplers;
+    capture.framebuffers  = gpu.framebuffers;
+    capture.vertex_inputs = gpu.vertex_inputs;
+
+    // Flatten command pages into one.
+    auto &page = capture.command_page;
+    page.next     = null;
+    page.data     = (u8 *)alloc(buffer->size, __temporary_allocator);
+    page.used     = 0;
+    page.capacity = (u32)buffer->size;
+    
+    auto it = gpu_iterate_cmds(buffer);
+    Gpu_Command cmd;
+    
+    while (gpu_next_cmd(&it, &cmd)) {
+        page.used += gpu_encode_cmd(page.data + page.used, cmd);
+    }
+
+    Assert(page.used == buffer->size);
+    
+    auto &header = capture.header;
+    header.magic              = GPU_CAPTURE_MAGIC;
+    header.version            = GPU_CAPTURE_VERSION;
+    header.frame_index        = frame_index;
+    header.buffer_count       = gpu.buffers.count;
+    header.image_count        = gpu.images.count;
+    header.image_view_count   = gpu.image_views.count;
+    header.sampler_count      = gpu.samplers.count;
+    header.framebuffer_count  = gpu.framebuffers.count;
+    header.vertex_input_count = gpu.vertex_inputs.count;
+    header.command_count      = buffer->count;
+    header.command_size       = page.used;
+
+    Archive archive;
+    defer { reset(archive); };
+    
+    if (!start_write(archive, path, true)) return false;
+
+    if (!serialize(archive, capture)) {
+        log(LOG_ERROR, "Failed to write gpu capture to %S", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool load_gpu_capture(String path, Gpu_Capture *capture) {
+    Archive archive;
+    defer { reset(archive); };
+    
+    if (!start_read(archive, path)) return false;
+
+    if (get_current_size(archive) < sizeof(Gpu_Capture_Header)) {
+        log(LOG_ERROR, "Gpu capture %S is too small to even contain header", path);
+        return false;
+    }
+
+    if (!serialize(archive, *capture)) {
+        log(LOG_ERROR, "Failed to read gpu capture from %S", path);
+        return false;
+    }
+    
+    return true;
+}
+
+Gpu_Command_Iterator gpu_iterate_cmds(const Gpu_Capture *capture) {
+    Gpu_Command_Iterator it;
+    it.page = &capture->command_page;
+    it.pos  = 0;
+    return it;
+}
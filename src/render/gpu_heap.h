@@ -0,0 +1,70 @@
+#pragma once
+
+#include "render_frame.h"
+
+// Two level segregated fit allocator of gpu buffer range for persistent data like
+// meshes, alloc and free are O(1). First level splits block sizes by power of two,
+// second level splits each of them linearly, both levels keep bitmaps of non empty
+// free lists. Block bookkeeping lives in cpu memory, gpu range holds only user data.
+//
+// Released blocks may still be read by frames in flight, so they become free only
+// after RENDER_FRAMES_IN_FLIGHT frames. Defragmentation moves movable allocations
+// to free blocks before them a bit each frame and tells their owners new location.
+
+typedef void (*Gpu_Heap_Relocate_Proc) (void *owner, const Gpu_Allocation &memory);
+
+struct Gpu_Heap_Block {
+    u64  offset; // relative to heap start
+    u64  size;
+    u64  alignment;
+    u32  prev_phys;
+    u32  next_phys;
+    u32  prev_free;
+    u32  next_free;
+    bool free;
+
+    void                  *owner;
+    Gpu_Heap_Relocate_Proc relocate; // block is not moved if not set
+};
+
+struct Gpu_Heap_Stats {
+    u64 used_size         = 0;
+    u64 free_size         = 0;
+    u64 pending_size      = 0; // released, but may be in use by frames in flight
+    u64 largest_free_size = 0;
+    u64 moved_size        = 0; // by defragmentation in total
+    u32 allocation_count  = 0;
+    u32 free_block_count  = 0;
+};
+
+struct Gpu_Heap {
+    static constexpr u32 SL_BITS     = 4;
+    static constexpr u32 SL_COUNT    = 1 << SL_BITS;
+    static constexpr u32 FL_COUNT    = 32;
+    static constexpr u64 GRANULARITY = 16;
+    static constexpr u32 NONE        = U32_MAX;
+
+    struct Pending_Free { u32 block; u64 frame; };
+
+    Gpu_Allocation memory; // heap range in gpu buffer
+
+    u32 fl_bitmap = 0;
+    u32 sl_bitmaps [FL_COUNT];
+    u32 free_lists [FL_COUNT][SL_COUNT];
+    u32 last_block = NONE; // physically last, defragmentation starts from it
+
+    Array <Gpu_Heap_Block> blocks;
+    Array <u32>            unused_blocks;
+    Array <Pending_Free>   pending_frees;
+    Table <u64, u32>       block_table; // heap offset to used block
+
+    Gpu_Heap_Stats stats;
+};
+
+inline Gpu_Heap gpu_mesh_heap;
+inline Gpu_Heap gpu_constant_heap; // gpu copies of cbuffer instances, released on material reload
+
+void           init             (Gpu_Heap *heap, Gpu_Allocation memory);
+Gpu_Allocation gpu_alloc        (u64 size, u64 alignment, Gpu_Heap *heap, void *owner = null, Gpu_Heap_Relocate_Proc relocate = null);
+void           gpu_release      (Gpu_Allocation *memory, Gpu_Heap *heap);
+void           update_gpu_heap  (Gpu_Heap *heap, u64 max_move_size); // retires released blocks and defragments
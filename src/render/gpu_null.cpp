@@ -0,0 +1,505 @@
+#include "pch.h"
+#include "gpu.h"
+#include "gpu_null.h"
+#include "render.h"
+#include "shader.h"
+#include "window.h"
+#include "profile.h"
+
+#ifndef NULL_GPU
+#error Null gpu implementation is included, but NULL_GPU macro is not defined
+#endif
+
+static const auto LOG_IDENT_GPU_NULL = S("gpu_null");
+
+const u64 GPU_WAIT_INFINITE = U64_MAX;
+
+// Recorded frame and the last finished one, swapped in swap_buffers.
+static Gpu_Null_Frame gpu_null_frames[2];
+static u32            gpu_null_frame_index = 0;
+
+const Gpu_Null_Frame *gpu_null_get_last_frame() {
+    return &gpu_null_frames[(gpu_null_frame_index + 1) % carray_count(gpu_null_frames)];
+}
+
+static Gpu_Null_Frame *gpu_null_get_current_frame() {
+    return &gpu_null_frames[gpu_null_frame_index];
+}
+
+bool init_render_backend(Window *w) {
+    For (gpu_null_frames) {
+        it.commands.allocator = context.allocator;
+        array_realloc(it.commands, 4096);
+    }
+
+    log(LOG_IDENT_GPU_NULL, "Initialized null gpu backend for window 0x%X", w);
+    return true;
+}
+
+bool post_init_render_backend() {
+    auto gpu_allocation = gpu_alloc(sizeof(Gpu_Picking_Data), &gpu_read_allocator);
+    gpu_picking_data = (Gpu_Picking_Data *)gpu_allocation.mapped_data;
+    *(f32 *)gpu_picking_data = F32_MAX;
+    gpu_picking_data_offset = gpu_allocation.offset;
+
+    return true;
+}
+
+void set_vsync(Window *w, bool enable) {
+    w->vsync = enable;
+}
+
+void swap_buffers(Window *w) {
+    Profile_Zone(__func__);
+
+    gpu_null_frame_index = (gpu_null_frame_index + 1) % carray_count(gpu_null_frames);
+
+    auto frame = gpu_null_get_current_frame();
+    array_clear(frame->commands);
+    frame->stats = {};
+}
+
+void gpu_memory_barrier() {}
+
+void gpu_init_backend() {
+    gpu.vendor                  = S("none");
+    gpu.renderer                = S("null");
+    gpu.backend_version         = S("0.0");
+    gpu.shader_language_version = S("none");
+}
+
+u32 gpu_uniform_buffer_max_size         () { return Kilobytes(64); }
+u32 gpu_uniform_buffer_offset_alignment () { return 256; }
+u32 gpu_storage_buffer_offset_alignment () { return 256; }
+u32 gpu_image_max_size                  () { return 16384; }
+u32 gpu_vertex_attribute_max_count      () { return 16; }
+
+static bool gpu_null_validate(bool condition, const Gpu_Command &cmd, const char *what) {
+    if (condition) return true;
+
+    auto frame = gpu_null_get_current_frame();
+    frame->stats.validation_error_count += 1;
+
+    log(LOG_IDENT_GPU_NULL, LOG_ERROR, "Invalid gpu command %u, %s", cmd.type, what);
+    return false;
+}
+
+template <typename T>
+static bool gpu_null_validate_resource(const Array <T> &resources, const Gpu_Command &cmd, const char *what) {
+    return gpu_null_validate(cmd.bind_resource < resources.count, cmd, what);
+}
+
+void gpu_flush_cmd_buffer(u32 cmd_buffer) {
+    auto gpu_cmd_buffer = gpu_get_command_buffer(cmd_buffer);
+    auto frame = gpu_null_get_current_frame();
+    auto &stats = frame->stats;
+
+    bool has_shader       = false;
+    bool has_vertex_input = false;
+    bool has_index_buffer = false;
+
+    auto it = gpu_iterate_cmds(gpu_cmd_buffer);
+    Gpu_Command cmd;
+    
+    while (gpu_next_cmd(&it, &cmd)) {
+        array_add(frame->commands, cmd);
+        stats.command_count += 1;
+
+        switch (cmd.type) {
+        case GPU_CMD_NONE: {
+            gpu_null_validate(false, cmd, "empty command");
+            break;
+        }
+        case GPU_CMD_POLYGON:
+        case GPU_CMD_VIEWPORT:
+        case GPU_CMD_SCISSOR:
+        case GPU_CMD_CULL_FACE:
+        case GPU_CMD_WINDING:
+        case GPU_CMD_SCISSOR_TEST:
+        case GPU_CMD_BLEND_TEST:
+        case GPU_CMD_BLEND_FUNC:
+        case GPU_CMD_DEPTH_TEST:
+        case GPU_CMD_DEPTH_WRITE:
+        case GPU_CMD_DEPTH_FUNC:
+        case GPU_CMD_STENCIL_MASK:
+        case GPU_CMD_STENCIL_FUNC:
+        case GPU_CMD_STENCIL_OP:
+        case GPU_CMD_CLEAR:
+        case GPU_CMD_MEMORY_BARRIER: {
+            stats.state_change_count += 1;
+            break;
+        }
+        case GPU_CMD_COPY_BUFFER: {
+            const bool valid = gpu_null_validate(cmd.copy_src < gpu.buffers.count && cmd.copy_dst < gpu.buffers.count, cmd, "copy buffer index is out of range");
+            if (!valid) break;
+            
+            const auto src = gpu_get_buffer(cmd.copy_src);
+            const auto dst = gpu_get_buffer(cmd.copy_dst);
+            if (!gpu_null_validate(cmd.copy_src_offset + cmd.copy_size <= src->size && cmd.copy_dst_offset + cmd.copy_size <= dst->size, cmd, "copy range is out of buffer bounds")) break;
+
+            // Buffers are plain memory here, so copy is done right away.
+            copy((u8 *)dst->mapped_data + cmd.copy_dst_offset, (u8 *)src->mapped_data + cmd.copy_src_offset, cmd.copy_size);
+            break;
+        }
+        case GPU_CMD_SHADER: {
+            gpu_null_validate(cmd.resource_handle._u32, cmd, "shader has no linked program");
+            has_shader = true;
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_IMAGE_VIEW: {
+            gpu_null_validate_resource(gpu.image_views, cmd, "image view index is out of range");
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_SAMPLER: {
+            gpu_null_validate_resource(gpu.samplers, cmd, "sampler index is out of range");
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_VERTEX_INPUT: {
+            gpu_null_validate_resource(gpu.vertex_inputs, cmd, "vertex input index is out of range");
+            has_vertex_input = true;
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_VERTEX_BINDING: {
+            break;
+        }
+        case GPU_CMD_VERTEX_BUFFER: {
+            gpu_null_validate_resource(gpu.buffers, cmd, "vertex buffer index is out of range");
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_INDEX_BUFFER: {
+            gpu_null_validate_resource(gpu.buffers, cmd, "index buffer index is out of range");
+            has_index_buffer = true;
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_FRAMEBUFFER: {
+            gpu_null_validate_resource(gpu.framebuffers, cmd, "framebuffer index is out of range");
+            stats.bind_count += 1;
+            break;
+        }
+        case GPU_CMD_CBUFFER_INSTANCE: {
+            if (gpu_null_validate_resource(gpu.buffers, cmd, "cbuffer buffer index is out of range")) {
+                const auto buffer = gpu_get_buffer(cmd.bind_resource);
+                gpu_null_validate(cmd.bind_offset + cmd.bind_size <= buffer->size, cmd, "cbuffer range is out of buffer bounds");
+            }
+
+            stats.bind_count     += 1;
+            stats.bytes_uploaded += cmd.bind_size;
+            break;
+        }
+        case GPU_CMD_STORAGE_BUFFER: {
+            if (gpu_null_validate_resource(gpu.buffers, cmd, "storage buffer index is out of range")) {
+                const auto buffer = gpu_get_buffer(cmd.bind_resource);
+                gpu_null_validate(cmd.bind_offset + cmd.bind_size <= buffer->size, cmd, "storage buffer range is out of buffer bounds");
+                gpu_null_validate(cmd.bind_offset % gpu_storage_buffer_offset_alignment() == 0, cmd, "storage buffer offset is not aligned");
+            }
+
+            stats.bind_count     += 1;
+            stats.bytes_uploaded += cmd.bind_size;
+            break;
+        }
+        case GPU_CMD_DRAW:
+        case GPU_CMD_DRAW_INDIRECT: {
+            gpu_null_validate(has_shader,       cmd, "draw without bound shader");
+            gpu_null_validate(has_vertex_input, cmd, "draw without bound vertex input");
+
+            if (cmd.type == GPU_CMD_DRAW_INDIRECT) {
+                gpu_null_validate(cmd.indirect_buffer < gpu.buffers.count, cmd, "indirect draw from invalid buffer");
+                stats.bytes_uploaded += (u64)cmd.indirect_count * cmd.indirect_stride;
+            }
+
+            stats.draw_count += 1;
+            inc_draw_call_count();
+            break;
+        }
+        case GPU_CMD_DRAW_INDEXED:
+        case GPU_CMD_DRAW_INDEXED_INDIRECT: {
+            gpu_null_validate(has_shader,       cmd, "draw without bound shader");
+            gpu_null_validate(has_vertex_input, cmd, "draw without bound vertex input");
+            gpu_null_validate(has_index_buffer, cmd, "indexed draw without bound index buffer");
+
+            if (cmd.type == GPU_CMD_DRAW_INDEXED_INDIRECT) {
+                gpu_null_validate(cmd.indirect_buffer < gpu.buffers.count, cmd, "indirect draw from invalid buffer");
+                stats.bytes_uploaded += (u64)cmd.indirect_count * cmd.indirect_stride;
+            }
+
+            stats.draw_count += 1;
+            inc_draw_call_count();
+            break;
+        }
+        default: {
+            gpu_null_validate(false, cmd, "unknown command type");
+            break;
+        }
+        }
+    }
+
+    gpu_reset_cmd_buffer(gpu_cmd_buffer);
+}
+
+u32 read_pixel(u32 color_attachment_index, u32 x, u32 y) {
+    return 0;
+}
+
+Shader *new_shader(const Compiled_Shader &compiled_shader) {
+    auto &platform = shader_platform;
+    const auto &shader_file = *compiled_shader.shader_file;
+
+    auto &shader = platform.shader_table[shader_file.name];
+    shader.shader_file = &shader_file;
+    shader.linked_program._u32 = platform.shader_table.count; // any non zero id
+    shader.resource_table.allocator = context.allocator;
+
+    table_clear  (shader.resource_table);
+    table_realloc(shader.resource_table, 8);
+
+    For (compiled_shader.resources) {
+        table_add(shader.resource_table, it.name, it);
+    }
+
+    return &shader;
+}
+
+u32 gpu_new_buffer(Gpu_Buffer_Type type, u64 size) {
+    const auto index = gpu_next_index(gpu.buffers, gpu.free_buffers);
+
+    auto &buffer = gpu.buffers[index];
+    buffer.type        = type;
+    buffer.size        = size;
+    buffer.mapped_data = alloc(size, __default_allocator); // too big for main arena
+    buffer.handle._u32 = index + 1;
+
+    return index;
+}
+
+static inline u32 gpu_null_pixel_size(Gpu_Image_Format format) {
+    constexpr u32 lut[] = { 0, 1, 4, 4, 3, 4, 4, 4 };
+    return lut[format];
+}
+
+u32 gpu_new_image(Gpu_Image_Type type, Gpu_Image_Format format, u32 mipmap_count, u32 width, u32 height, u32 depth, const void *base_data) {
+    Assert(mipmap_count);
+    Assert(mipmap_count <= gpu_max_mipmap_count(width, height));
+
+    const auto index = gpu_next_index(gpu.images, gpu.free_images);
+
+    auto &image = gpu.images[index];
+    image.handle._u32  = index + 1;
+    image.type         = type;
+    image.format       = format;
+    image.mipmap_count = mipmap_count;
+    image.width        = width;
+    image.height       = height;
+    image.depth        = depth;
+
+    if (base_data) {
+        auto frame = gpu_null_get_current_frame();
+        frame->stats.bytes_uploaded += (u64)width * height * depth * gpu_null_pixel_size(format);
+    }
+
+    return index;
+}
+
+void gpu_update_image(u32 image, u32 mipmap, u32 x, u32 y, u32 width, u32 height, const void *data) {
+    Assert(image < gpu.images.count);
+
+    const auto &gpu_image = gpu.images[image];
+    Assert(x + width  <= gpu_image.width);
+    Assert(y + height <= gpu_image.height);
+
+    auto frame = gpu_null_get_current_frame();
+    frame->stats.bytes_uploaded += (u64)width * height * gpu_null_pixel_size(gpu_image.format);
+}
+
+u32 gpu_new_image_view(u32 image, Gpu_Image_Type type, Gpu_Image_Format format, u32 mipmap_min, u32 mipmap_count, u32 depth_min, u32 depth_size) {
+    Assert(image < gpu.images.count);
+
+    const auto index = gpu_next_index(gpu.image_views, gpu.free_image_views);
+
+    auto &image_view = gpu.image_views[index];
+    image_view.handle._u32  = index + 1;
+    image_view.image        = image;
+    image_view.type         = type;
+    image_view.format       = format;
+    image_view.mipmap_min   = mipmap_min;
+    image_view.mipmap_count = mipmap_count;
+    image_view.depth_min    = depth_min;
+    image_view.depth_size   = depth_size;
+
+    return index;
+}
+
+u32 gpu_new_sampler(Gpu_Sampler_Filter filter_min, Gpu_Sampler_Filter filter_mag,
+                    Gpu_Sampler_Wrap wrap_u, Gpu_Sampler_Wrap wrap_v, Gpu_Sampler_Wrap wrap_w,
+                    Gpu_Sampler_Compare_Mode compare_mode, Gpu_Sampler_Compare_Function compare_function,
+                    f32 lod_min, f32 lod_max, Color4f color_border) {
+    const auto index = gpu_next_index(gpu.samplers, gpu.free_samplers);
+
+    auto &sampler = gpu.samplers[index];
+    sampler.handle._u32      = index + 1;
+    sampler.filter_min       = filter_min;
+    sampler.filter_mag       = filter_mag;
+    sampler.wrap_u           = wrap_u;
+    sampler.wrap_v           = wrap_v;
+    sampler.wrap_w           = wrap_w;
+    sampler.compare_mode     = compare_mode;
+    sampler.compare_function = compare_function;
+    sampler.lod_min          = lod_min;
+    sampler.lod_max          = lod_max;
+    sampler.color_border     = color_border;
+
+    return index;
+}
+
+u32 gpu_new_shader(Gpu_Shader_Stage_Type stage, Buffer source) {
+    const auto index = gpu_next_index(gpu.shaders, gpu.free_shaders);
+
+    auto &shader = gpu.shaders[index];
+    shader.handle._u32 = index + 1;
+
+    return index;
+}
+
+u32 gpu_new_framebuffer(u32 width, u32 height, const Gpu_Image_Format *color_formats, u32 color_format_count, Gpu_Image_Format depth_format) {
+    const auto index = gpu_next_index(gpu.framebuffers, gpu.free_framebuffers);
+
+    auto &framebuffer = gpu.framebuffers[index];
+    framebuffer.handle._u32 = index + 1;
+    framebuffer.color_attachments = New(u32, color_format_count, __default_allocator);
+    framebuffer.color_attachment_count = color_format_count;
+
+    for (u32 i = 0; i < color_format_count; ++i) {
+        const auto format = color_formats[i];
+        const auto image  = gpu_new_image(GPU_IMAGE_TYPE_2D, format, 1, width, height, 1, {});
+        framebuffer.color_attachments[i] = gpu_new_image_view(image, GPU_IMAGE_TYPE_2D, format, 0, 1, 0, 1);
+    }
+
+    const auto image = gpu_new_image(GPU_IMAGE_TYPE_2D, depth_format, 1, width, height, 1, {});
+    framebuffer.depth_attachment = gpu_new_image_view(image, GPU_IMAGE_TYPE_2D, depth_format, 0, 1, 0, 1);
+
+    return index;
+}
+
+u32 gpu_new_command_buffer(u32 page_size) {
+    const auto index = gpu_next_index(gpu.cmd_buffers, gpu.free_cmd_buffers);
+
+    auto &cmd_buffer = gpu.cmd_buffers[index];
+    gpu_init_cmd_buffer(&cmd_buffer, page_size);
+
+    return index;
+}
+
+u32 gpu_new_vertex_input(const Gpu_Vertex_Binding *bindings, u32 binding_count,
+                         const Gpu_Vertex_Attribute *attributes, u32 attribute_count) {
+    const auto index = gpu_next_index(gpu.vertex_inputs, gpu.free_vertex_inputs);
+
+    auto &vertex_input = gpu.vertex_inputs[index];
+    vertex_input.handle._u32     = index + 1;
+    vertex_input.bindings        = New(Gpu_Vertex_Binding,   binding_count);
+    vertex_input.attributes      = New(Gpu_Vertex_Attribute, attribute_count);
+    vertex_input.binding_count   = binding_count;
+    vertex_input.attribute_count = attribute_count;
+
+    copy(vertex_input.bindings,   bindings,   binding_count * sizeof(bindings[0]));
+    copy(vertex_input.attributes, attributes, attribute_count * sizeof(attributes[0]));
+
+    return index;
+}
+
+u32 gpu_new_descriptor(const Gpu_Descriptor_Binding *bindings, u32 count) {
+    const auto index = gpu_next_index(gpu.descriptors, gpu.free_descriptors);
+
+    auto &descriptor = gpu.descriptors[index];
+    descriptor.bindings      = New(Gpu_Descriptor_Binding, count);
+    descriptor.binding_count = count;
+
+    copy(descriptor.bindings, bindings, count * sizeof(bindings[0]));
+
+    return index;
+}
+
+u32 gpu_new_pipeline(u32 vertex_input, u32 *shaders, u32 shader_count, u32 *descriptors, u32 descriptor_count) {
+    const auto index = gpu_next_index(gpu.pipelines, gpu.free_pipelines);
+
+    auto &pipeline = gpu.pipelines[index];
+    pipeline.handle._u32      = index + 1;
+    pipeline.vertex_input     = vertex_input;
+    pipeline.shaders          = New(u32, shader_count);
+    pipeline.shader_count     = shader_count;
+    pipeline.descriptors      = New(u32, descriptor_count);
+    pipeline.descriptor_count = descriptor_count;
+
+    copy(pipeline.shaders, shaders, shader_count * sizeof(shaders[0]));
+    copy(pipeline.descriptors, descriptors, descriptor_count * sizeof(descriptors[0]));
+
+    return index;
+}
+
+template <typename T, typename I>
+static void gpu_delete_null_resource(u32 index, Array <T> &resources, Array <I> &free_resources) {
+    if (!index || index >= resources.count) return;
+
+    resources[index].handle = {};
+    array_add(free_resources, index);
+}
+
+void gpu_delete_buffer(u32 index) {
+    if (!index || index >= gpu.buffers.count) return;
+
+    auto &buffer = gpu.buffers[index];
+    release(buffer.mapped_data, __default_allocator);
+    buffer.mapped_data = null;
+    
+    gpu_delete_null_resource(index, gpu.buffers, gpu.free_buffers);
+}
+
+void gpu_delete_image          (u32 index) { gpu_delete_null_resource(index, gpu.images, gpu.free_images); }
+void gpu_delete_image_view     (u32 index) { gpu_delete_null_resource(index, gpu.image_views, gpu.free_image_views); }
+void gpu_delete_sampler        (u32 index) { gpu_delete_null_resource(index, gpu.samplers, gpu.free_samplers); }
+void gpu_delete_shader         (u32 index) { gpu_delete_null_resource(index, gpu.shaders,  gpu.free_shaders); }
+void gpu_delete_command_buffer (u32 index) { gpu_delete_null_resource(index, gpu.cmd_buffers, gpu.free_cmd_buffers); }
+void gpu_delete_vertex_input   (u32 index) { gpu_delete_null_resource(index, gpu.vertex_inputs, gpu.free_vertex_inputs); }
+void gpu_delete_descriptor     (u32 index) { gpu_delete_null_resource(index, gpu.descriptors, gpu.free_descriptors); }
+void gpu_delete_pipeline       (u32 index) { gpu_delete_null_resource(index, gpu.pipelines, gpu.free_pipelines); }
+
+void gpu_delete_framebuffer(u32 index) {
+    if (!index || index >= gpu.framebuffers.count) return;
+    
+    auto &framebuffer = gpu.framebuffers[index];
+
+    for (u32 i = 0; i < framebuffer.color_attachment_count; ++i) {
+        const auto attachment = framebuffer.color_attachments[i];
+        gpu_delete_image(gpu_get_image_view(attachment)->image);
+        gpu_delete_image_view(attachment);
+    }
+
+    if (framebuffer.depth_attachment) {
+        const auto attachment = framebuffer.depth_attachment;
+        gpu_delete_image(gpu_get_image_view(attachment)->image);
+        gpu_delete_image_view(attachment);
+    }
+
+    release(framebuffer.color_attachments, __default_allocator);
+    framebuffer.color_attachments      = null;
+    framebuffer.color_attachment_count = 0;
+    framebuffer.depth_attachment       = 0;
+    
+    gpu_delete_null_resource(index, gpu.framebuffers, gpu.free_framebuffers);
+}
+
+// Null backend executes commands immediately on flush, so syncs are always signaled.
+
+Handle gpu_fence_sync() {
+    Handle sync = {};
+    sync._u64 = 1;
+    return sync;
+}
+
+Gpu_Sync_Result wait_client_sync (Handle sync, u64 timeout) { return GPU_SYNC_RESULT_ALREADY_SIGNALED; }
+void            wait_gpu_sync    (Handle sync) {}
+void            delete_gpu_sync  (Handle sync) {}
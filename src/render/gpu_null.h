@@ -0,0 +1,23 @@
+#pragma once
+
+#include "gpu.h"
+
+// Null gpu backend keeps resource bookkeeping and cpu visible buffers, validates
+// flushed commands and records them per frame without any graphics api, so render
+// code can be profiled and checked without gpu.
+
+struct Gpu_Null_Stats {
+    u32 command_count          = 0;
+    u32 draw_count             = 0;
+    u32 state_change_count     = 0; // fixed function state, like depth or blend
+    u32 bind_count             = 0; // shaders, buffers, images etc.
+    u32 validation_error_count = 0;
+    u64 bytes_uploaded         = 0; // image data, cbuffer and indirect ranges
+};
+
+struct Gpu_Null_Frame {
+    Array <Gpu_Command> commands;
+    Gpu_Null_Stats      stats;
+};
+
+const Gpu_Null_Frame *gpu_null_get_last_frame ();
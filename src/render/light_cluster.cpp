@@ -0,0 +1,302 @@
+#include "pch.h"
+#include "light_cluster.h"
+#include "render_frame.h"
+#include "profile.h"
+#include "atomic.h"
+
+#include <intrin.h>
+
+f32 get_light_radius(const Point_Light_Info &light) {
+    const f32 brightness = Max(Max(Max(light.diffuse.x, light.diffuse.y), light.diffuse.z),
+                               Max(Max(light.ambient.x, light.ambient.y), light.ambient.z));
+    const f32 brightest  = Max(brightness, Max(Max(light.specular.x, light.specular.y), light.specular.z));
+    if (brightest <= 0.0f) return 0.0f;
+
+    // Solve c + l * d + q * d^2 = brightest / cutoff for distance. Positive root is
+    // taken in form without cancellation, -2c / (l + sqrt(l^2 - 4qc)), which is also
+    // -c / l for linear only attenuation. Sqrt is exact sse one, not approximated one
+    // from basic, so radius needs no extra margin.
+    const f32 c = light.attenuation_constant - brightest / LIGHT_CLUSTER_CUTOFF;
+    const f32 l = light.attenuation_linear;
+    const f32 q = light.attenuation_quadratic;
+
+    if (c >= 0.0f) return 0.0f; // never brighter than cutoff
+    if (q <= 0.0f && l <= 0.0f) return F32_MAX; // not attenuated
+
+    const f32 discriminant = l * l - 4.0f * q * c;
+    return -2.0f * c / (l + _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(discriminant))));
+}
+
+// View space x or y of ndc coordinate at given view depth, inverse of projection
+// that works for both perspective and orthographic ones.
+static f32 unproject_ndc(f32 ndc, f32 depth, const Matrix4 &proj, u32 axis) {
+    const f32 z = -depth;
+    const f32 w = z * proj[2][3] + proj[3][3];
+    return (ndc * w - z * proj[2][axis] - proj[3][axis]) / proj[axis][axis];
+}
+
+static f32 get_slice_depth(const Light_Cluster_Grid *grid, u32 slice) {
+    return grid->near_plane * Pow(grid->far_plane / grid->near_plane, (f32)slice / Light_Cluster_Grid::Z_COUNT);
+}
+
+static void bin_light_slice(Light_Cluster_Grid *grid, u32 slice) {
+    constexpr u32 X = Light_Cluster_Grid::X_COUNT;
+    constexpr u32 Y = Light_Cluster_Grid::Y_COUNT;
+    constexpr u32 CAPACITY = Light_Cluster_Grid::LIGHT_CAPACITY;
+    constexpr u32 MAX_LIGHTS = Light_Cluster_Grid::MAX_LIGHTS_PER_CLUSTER;
+
+    const f32 d0 = get_slice_depth(grid, slice);
+    const f32 d1 = get_slice_depth(grid, slice + 1);
+
+    // Keep lights which depth range touches the slice, so cluster tests run only
+    // against small part of them.
+    alignas(16) f32 xs  [CAPACITY];
+    alignas(16) f32 ys  [CAPACITY];
+    alignas(16) f32 zs  [CAPACITY];
+    alignas(16) f32 r2s [CAPACITY];
+    u32 slice_lights[CAPACITY];
+    u32 count = 0;
+
+    for (u32 i = 0; i < grid->light_count; ++i) {
+        const f32 depth = -grid->light_z[i];
+        const f32 r     =  grid->light_r[i];
+        if (depth + r < d0 || depth - r > d1) continue;
+
+        xs [count] = grid->light_x[i];
+        ys [count] = grid->light_y[i];
+        zs [count] = grid->light_z[i];
+        r2s[count] = grid->light_r2[i];
+        slice_lights[count] = i;
+        count += 1;
+    }
+
+    const u32 padded_count = (count + 3) & ~3u;
+    for (u32 i = count; i < padded_count; ++i) {
+        xs[i] = ys[i] = zs[i] = 0.0f;
+        r2s[i] = -1.0f;
+    }
+
+    grid->dropped[slice] = 0;
+
+    const auto zero   = _mm_setzero_ps();
+    const auto min_z  = _mm_set1_ps(-d1);
+    const auto max_z  = _mm_set1_ps(-d0);
+
+    for (u32 y = 0; y < Y; ++y) {
+        const f32 ndc_y0 = (f32)(y + 0) / Y * 2.0f - 1.0f;
+        const f32 ndc_y1 = (f32)(y + 1) / Y * 2.0f - 1.0f;
+
+        const f32 ya = unproject_ndc(ndc_y0, d0, grid->proj, 1);
+        const f32 yb = unproject_ndc(ndc_y0, d1, grid->proj, 1);
+        const f32 yc = unproject_ndc(ndc_y1, d0, grid->proj, 1);
+        const f32 yd = unproject_ndc(ndc_y1, d1, grid->proj, 1);
+
+        const auto min_y = _mm_set1_ps(Min(Min(ya, yb), Min(yc, yd)));
+        const auto max_y = _mm_set1_ps(Max(Max(ya, yb), Max(yc, yd)));
+
+        for (u32 x = 0; x < X; ++x) {
+            const f32 ndc_x0 = (f32)(x + 0) / X * 2.0f - 1.0f;
+            const f32 ndc_x1 = (f32)(x + 1) / X * 2.0f - 1.0f;
+
+            const f32 xa = unproject_ndc(ndc_x0, d0, grid->proj, 0);
+            const f32 xb = unproject_ndc(ndc_x0, d1, grid->proj, 0);
+            const f32 xc = unproject_ndc(ndc_x1, d0, grid->proj, 0);
+            const f32 xd = unproject_ndc(ndc_x1, d1, grid->proj, 0);
+
+            const auto min_x = _mm_set1_ps(Min(Min(xa, xb), Min(xc, xd)));
+            const auto max_x = _mm_set1_ps(Max(Max(xa, xb), Max(xc, xd)));
+
+            const u32 cluster = get_light_cluster_index(x, y, slice);
+            u32 *indices = grid->indices + cluster * MAX_LIGHTS;
+            u32  cluster_count = 0;
+
+            // Squared distance from sphere center to aabb against squared radius,
+            // 4 lights at a time.
+            for (u32 i = 0; i < padded_count; i += 4) {
+                const auto cx = _mm_load_ps(xs + i);
+                const auto cy = _mm_load_ps(ys + i);
+                const auto cz = _mm_load_ps(zs + i);
+
+                const auto dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_x, cx), _mm_sub_ps(cx, max_x)), zero);
+                const auto dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_y, cy), _mm_sub_ps(cy, max_y)), zero);
+                const auto dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_z, cz), _mm_sub_ps(cz, max_z)), zero);
+
+                const auto dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                u32 mask = (u32)_mm_movemask_ps(_mm_cmple_ps(dist2, _mm_load_ps(r2s + i)));
+
+                while (mask) {
+                    unsigned long bit;
+                    _BitScanForward(&bit, mask);
+                    mask &= mask - 1;
+
+                    if (cluster_count == MAX_LIGHTS) {
+                        grid->dropped[slice] += 1;
+                        continue;
+                    }
+
+                    indices[cluster_count] = slice_lights[i + bit];
+                    cluster_count += 1;
+                }
+            }
+
+            grid->counts[cluster] = cluster_count;
+        }
+    }
+}
+
+static void bin_light_slices(Light_Cluster_Grid *grid) {
+    while (true) {
+        const u32 slice = (u32)atomic_increment(&grid->next_slice) - 1;
+        if (slice >= Light_Cluster_Grid::Z_COUNT) break;
+        bin_light_slice(grid, slice);
+    }
+}
+
+static u32 light_cluster_worker_proc(void *data) {
+    auto grid = (Light_Cluster_Grid *)data;
+
+    while (wait_semaphore(grid->work_semaphore, WAIT_INFINITE)) {
+        if (grid->quit) break;
+        
+        bin_light_slices(grid);
+        release_semaphore(grid->done_semaphore, 1);
+    }
+
+    return 0;
+}
+
+void init_light_clusters(Light_Cluster_Grid *grid) {
+    constexpr u32 CLUSTER_COUNT = Light_Cluster_Grid::CLUSTER_COUNT;
+    
+    grid->counts  = New(u32, CLUSTER_COUNT, __default_allocator);
+    grid->indices = New(u32, CLUSTER_COUNT * Light_Cluster_Grid::MAX_LIGHTS_PER_CLUSTER, __default_allocator);
+    
+    // Leave one physical core for main thread, it bins slices as well.
+    const auto topology = get_cpu_topology();
+    const u32 core_count = Max(topology->physical_core_count, 1u);
+
+    grid->worker_count   = Min(core_count - 1, Light_Cluster_Grid::MAX_WORKER_COUNT);
+    grid->work_semaphore = create_semaphore(0, Light_Cluster_Grid::MAX_WORKER_COUNT);
+    grid->done_semaphore = create_semaphore(0, Light_Cluster_Grid::MAX_WORKER_COUNT);
+
+    for (u32 i = 0; i < grid->worker_count; ++i) {
+        grid->workers[i] = create_thread(light_cluster_worker_proc, 0, grid);
+        set_thread_name(grid->workers[i], S("light_cluster_worker"));
+    }
+}
+
+void shutdown_light_clusters(Light_Cluster_Grid *grid) {
+    defer {
+        release(grid->counts,  __default_allocator);
+        release(grid->indices, __default_allocator);
+        grid->counts  = null;
+        grid->indices = null;
+    };
+    
+    if (!grid->worker_count) return;
+    
+    // Workers are idle between builds, so each one wakes up once and sees quit.
+    grid->quit = true;
+    release_semaphore(grid->work_semaphore, grid->worker_count);
+
+    for (u32 i = 0; i < grid->worker_count; ++i) {
+        if (!wait_thread(grid->workers[i], WAIT_INFINITE)) {
+            log(LOG_ERROR, "Failed to wait for light cluster worker 0x%X to quit", grid->workers[i]);
+        }
+        
+        close_thread(grid->workers[i]);
+        grid->workers[i] = THREAD_NONE;
+    }
+
+    grid->worker_count = 0;
+}
+
+void build_light_clusters(Light_Cluster_Grid *grid, const Camera &camera, const Point_Light_Info *lights, u32 light_count) {
+    Profile_Zone(__func__);
+
+    Assert(light_count <= MAX_POINT_LIGHTS);
+
+    constexpr f32 MIN_NEAR_PLANE = 0.01f;
+
+    grid->proj        = camera.proj;
+    grid->near_plane  = Max(camera.near_plane, MIN_NEAR_PLANE);
+    grid->far_plane   = Max(camera.far_plane, grid->near_plane * 2.0f);
+    grid->depth_scale = Light_Cluster_Grid::Z_COUNT / Log2(grid->far_plane / grid->near_plane);
+    grid->light_count = light_count;
+
+    // Transform light centers to view space as row vectors, same as in make_frustum.
+    const auto &v = camera.view;
+    for (u32 i = 0; i < light_count; ++i) {
+        const auto &p = lights[i].position;
+        const f32 r = Min(get_light_radius(lights[i]), grid->far_plane);
+
+        grid->light_x [i] = p.x * v[0][0] + p.y * v[1][0] + p.z * v[2][0] + v[3][0];
+        grid->light_y [i] = p.x * v[0][1] + p.y * v[1][1] + p.z * v[2][1] + v[3][1];
+        grid->light_z [i] = p.x * v[0][2] + p.y * v[1][2] + p.z * v[2][2] + v[3][2];
+        grid->light_r [i] = r;
+        grid->light_r2[i] = r > 0.0f ? r * r : -1.0f;
+    }
+
+    grid->next_slice = 0;
+
+    {
+        Profile_Zone("bin_light_slices");
+
+        u32 worker_count = 0;
+        if (light_count >= Light_Cluster_Grid::MIN_THREADED_LIGHTS) {
+            worker_count = grid->worker_count;
+        }
+
+        if (worker_count) release_semaphore(grid->work_semaphore, worker_count);
+        bin_light_slices(grid);
+
+        for (u32 i = 0; i < worker_count; ++i) {
+            wait_semaphore(grid->done_semaphore, WAIT_INFINITE);
+        }
+
+        grid->stats = {};
+        grid->stats.light_count  = light_count;
+        grid->stats.worker_count = worker_count + 1;
+    }
+
+    auto &stats = grid->stats;
+    for (u32 i = 0; i < Light_Cluster_Grid::CLUSTER_COUNT; ++i) {
+        const u32 count = grid->counts[i];
+        stats.index_count       += count;
+        stats.lit_cluster_count += count > 0;
+        stats.max_cluster_lights = Max(stats.max_cluster_lights, count);
+    }
+
+    for (u32 i = 0; i < Light_Cluster_Grid::Z_COUNT; ++i) {
+        stats.dropped_index_count += grid->dropped[i];
+    }
+
+    // Storage buffers can't be empty, so each of them has at least one element.
+    const u64 alignment = gpu_storage_buffer_offset_alignment();
+    auto ring = get_upload_ring();
+
+    grid->gpu_lights   = gpu_alloc(Max(light_count, 1u) * sizeof(Point_Light_Info), alignment, ring);
+    grid->gpu_clusters = gpu_alloc(Light_Cluster_Grid::CLUSTER_COUNT * 2 * sizeof(u32), alignment, ring);
+    grid->gpu_indices  = gpu_alloc(Max(stats.index_count, 1u) * sizeof(u32), alignment, ring);
+
+    if (light_count) {
+        gpu_append(&grid->gpu_lights, lights, light_count * sizeof(Point_Light_Info));
+    } else {
+        gpu_append(&grid->gpu_lights, Point_Light_Info {});
+    }
+
+    u32 offset = 0;
+    for (u32 i = 0; i < Light_Cluster_Grid::CLUSTER_COUNT; ++i) {
+        const u32 count = grid->counts[i];
+        const u32 cluster[2] = { offset, count };
+
+        gpu_append(&grid->gpu_clusters, cluster);
+        if (count) {
+            gpu_append(&grid->gpu_indices, grid->indices + i * Light_Cluster_Grid::MAX_LIGHTS_PER_CLUSTER, count * sizeof(u32));
+        }
+
+        offset += count;
+    }
+
+    if (offset == 0) gpu_append(&grid->gpu_indices, offset);
+}
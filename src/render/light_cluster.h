@@ -0,0 +1,85 @@
+#pragma once
+
+#include "gpu.h"
+#include "thread.h"
+#include "sync.h"
+#include "shader_globals.h"
+
+// Clustered light assignment. View frustum is split into screen tiles and depth
+// slices growing exponentially from near plane, point lights are binned on cpu
+// into clusters touched by their bounding sphere, so pixel shader iterates only
+// lights of its own cluster. Light radius is distance where attenuation drops
+// below LIGHT_CLUSTER_CUTOFF of its brightest color.
+//
+// Depth slices are binned in parallel by worker threads and main thread, each
+// cluster keeps up to MAX_LIGHTS_PER_CLUSTER light indices in fixed slot and lists
+// are compacted to upload ring when all slices are done. Slots are too big for
+// render frame arena, so they are allocated from heap on init. Shader finds cluster of
+// pixel with the same tile and slice formulas, see get_light_cluster.
+
+inline constexpr f32 LIGHT_CLUSTER_CUTOFF = 1.0f / 256.0f;
+
+struct Light_Cluster_Stats {
+    u32 light_count          = 0;
+    u32 lit_cluster_count    = 0; // clusters with at least one light
+    u32 index_count          = 0; // light indices of all clusters
+    u32 max_cluster_lights   = 0;
+    u32 dropped_index_count  = 0; // did not fit into full clusters
+    u32 worker_count         = 0; // threads that binned slices, main included
+};
+
+struct Light_Cluster_Grid {
+    static constexpr u32 X_COUNT = 16;
+    static constexpr u32 Y_COUNT = 8;
+    static constexpr u32 Z_COUNT = 24;
+    static constexpr u32 SLICE_CLUSTER_COUNT    = X_COUNT * Y_COUNT;
+    static constexpr u32 CLUSTER_COUNT          = SLICE_CLUSTER_COUNT * Z_COUNT;
+    static constexpr u32 MAX_LIGHTS_PER_CLUSTER = 128;
+    static constexpr u32 MAX_WORKER_COUNT       = 8;
+    static constexpr u32 MIN_THREADED_LIGHTS    = 32; // fewer are binned on main thread only
+    static constexpr u32 LIGHT_CAPACITY         = (MAX_POINT_LIGHTS + 3) & ~3u; // padded for simd
+
+    // Input of current build, light centers are in view space and squared radii
+    // of padding lights are negative, so they never pass sphere test.
+    Matrix4 proj;
+    f32     near_plane  = 0.0f;
+    f32     far_plane   = 0.0f;
+    f32     depth_scale = 0.0f; // slice count / log2(far / near)
+    u32     light_count = 0;
+
+    alignas(16) f32 light_x  [LIGHT_CAPACITY];
+    alignas(16) f32 light_y  [LIGHT_CAPACITY];
+    alignas(16) f32 light_z  [LIGHT_CAPACITY];
+    alignas(16) f32 light_r  [LIGHT_CAPACITY];
+    alignas(16) f32 light_r2 [LIGHT_CAPACITY];
+
+    u32 *counts  = null; // CLUSTER_COUNT
+    u32 *indices = null; // CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER
+    u32  dropped [Z_COUNT]; // per slice, summed to stats after build
+
+    s32 next_slice = 0;
+
+    Thread    workers [MAX_WORKER_COUNT];
+    u32       worker_count   = 0;
+    Semaphore work_semaphore = SEMAPHORE_NONE; // released once per worker to start build
+    Semaphore done_semaphore = SEMAPHORE_NONE; // released by worker when no slices are left
+    volatile bool quit = false; // checked by workers after wake up
+
+    // Upload ring memory of current frame, read by shader as point_lights,
+    // light_clusters (offset and count of each cluster) and light_indices.
+    Gpu_Allocation gpu_lights;
+    Gpu_Allocation gpu_clusters;
+    Gpu_Allocation gpu_indices;
+
+    Light_Cluster_Stats stats;
+};
+
+void init_light_clusters     (Light_Cluster_Grid *grid); // allocates cluster slots and starts worker threads
+void shutdown_light_clusters (Light_Cluster_Grid *grid); // signals worker threads to quit, waits for them and releases slots
+void build_light_clusters    (Light_Cluster_Grid *grid, const Camera &camera, const Point_Light_Info *lights, u32 light_count);
+
+f32  get_light_radius        (const Point_Light_Info &light);
+
+inline u32 get_light_cluster_index(u32 x, u32 y, u32 z) {
+    return (z * Light_Cluster_Grid::Y_COUNT + y) * Light_Cluster_Grid::X_COUNT + x;
+}
@@ -2,16 +2,16 @@
 
 struct Ray;
 
+// Lines are gathered on cpu during frame and copied to upload ring when they are
+// drawn, so frames in flight keep reading their own copy.
 struct Line_Geometry {
     static constexpr u32 MAX_LINES    = 1024;
     static constexpr u32 MAX_VERTICES = 2 * MAX_LINES;
     
-    Vector3 *positions;
-    Color32 *colors;
-    u64      positions_offset;
-    u64      colors_offset;
-    u32      vertex_input;
-    u32      vertex_count;
+    Vector3 positions [MAX_VERTICES];
+    Color32 colors    [MAX_VERTICES];
+    u32     vertex_input;
+    u32     vertex_count;
 };
 
 void init_line_geometry ();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "shader_binding_model.h"
+
 inline const auto MATERIAL_EXT = S("material");
 
 struct Shader;
@@ -17,6 +19,7 @@ struct Material {
     Atom    specular_texture;
     bool    use_blending;
     Table <String, Constant_Buffer_Instance> cbi_table;
+    Constant_Buffer_Instance *cbi_slots[MAX_CONSTANT_BUFFER_SLOTS] = {}; // by constant buffer slot, null if shader lacks it
 };
 
 struct Global_Materials {
@@ -30,3 +33,5 @@ Material *new_material     (String path);
 Material *new_material     (Atom name, String contents);
 Material *get_material     (Atom name);
 bool      has_transparency (const Material *material);
+
+Constant_Buffer_Instance *get_cbi (Material *material, const Constant_Buffer *cb);
@@ -0,0 +1,309 @@
+#include "pch.h"
+#include "occlusion.h"
+#include "profile.h"
+
+#include <intrin.h>
+
+// Triangle prepared for rasterization: edge functions and depth plane evaluated as
+// a * x + b * y + c at pixel centers, bounds are inclusive pixel rect.
+struct Occluder_Triangle {
+    f32 edge_a[3];
+    f32 edge_b[3];
+    f32 edge_c[3];
+    f32 depth_a, depth_b, depth_c;
+    s32 x0, y0, x1, y1;
+};
+
+// Points are transformed as row vectors (p * m), same as in make_frustum.
+static Vector4 transform_to_clip(const Vector3 &p, const Matrix4 &m) {
+    return Vector4(p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+                   p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+                   p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2],
+                   p.x * m[0][3] + p.y * m[1][3] + p.z * m[2][3] + m[3][3]);
+}
+
+static bool setup_occluder_triangle(Vector4 v0, Vector4 v1, Vector4 v2, Occluder_Triangle &t) {
+    constexpr f32 W = (f32)Occlusion_Buffer::WIDTH;
+    constexpr f32 H = (f32)Occlusion_Buffer::HEIGHT;
+    constexpr f32 NEAR_W_EPSILON = 1e-5f;
+
+    Vector3 p[3];
+    const Vector4 clip[3] = { v0, v1, v2 };
+    for (u32 i = 0; i < 3; ++i) {
+        const auto &v = clip[i];
+        if (v.w <= NEAR_W_EPSILON || v.z < -v.w) return false;
+
+        const f32 inv_w = 1.0f / v.w;
+        p[i].x = (v.x * inv_w * 0.5f + 0.5f) * W;
+        p[i].y = (v.y * inv_w * 0.5f + 0.5f) * H;
+        p[i].z =  v.z * inv_w * 0.5f + 0.5f;
+    }
+
+    // Edge function of edge i is positive on the inner side of counter clockwise
+    // triangle, so clockwise ones are flipped to rasterize both sides.
+    const auto edge = [] (Vector3 a, Vector3 b, f32 &ea, f32 &eb, f32 &ec) {
+        ea = a.y - b.y;
+        eb = b.x - a.x;
+        ec = -(ea * a.x + eb * a.y);
+    };
+
+    f32 area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+    if (area == 0.0f) return false;
+
+    if (area < 0.0f) {
+        const auto tmp = p[1]; p[1] = p[2]; p[2] = tmp;
+        area = -area;
+    }
+
+    edge(p[1], p[2], t.edge_a[0], t.edge_b[0], t.edge_c[0]); // weight of p0
+    edge(p[2], p[0], t.edge_a[1], t.edge_b[1], t.edge_c[1]); // weight of p1
+    edge(p[0], p[1], t.edge_a[2], t.edge_b[2], t.edge_c[2]); // weight of p2
+
+    const f32 inv_area = 1.0f / area;
+    const f32 dz1 = (p[1].z - p[0].z) * inv_area;
+    const f32 dz2 = (p[2].z - p[0].z) * inv_area;
+    t.depth_a = dz1 * t.edge_a[1] + dz2 * t.edge_a[2];
+    t.depth_b = dz1 * t.edge_b[1] + dz2 * t.edge_b[2];
+    t.depth_c = p[0].z - t.depth_a * p[0].x - t.depth_b * p[0].y;
+
+    const f32 min_x = Min(p[0].x, Min(p[1].x, p[2].x));
+    const f32 min_y = Min(p[0].y, Min(p[1].y, p[2].y));
+    const f32 max_x = Max(p[0].x, Max(p[1].x, p[2].x));
+    const f32 max_y = Max(p[0].y, Max(p[1].y, p[2].y));
+
+    // Pixel centers are at half coords, so pixel x is covered if x + 0.5 is inside.
+    // Bounds are clamped as floats first, vertices close to camera plane may have
+    // coords that do not fit in s32.
+    t.x0 = (s32)Ceil (Clamp(min_x - 0.5f, 0.0f, W));
+    t.y0 = (s32)Ceil (Clamp(min_y - 0.5f, 0.0f, H));
+    t.x1 = (s32)Floor(Clamp(max_x - 0.5f, -1.0f, W - 1.0f));
+    t.y1 = (s32)Floor(Clamp(max_y - 0.5f, -1.0f, H - 1.0f));
+
+    return t.x0 <= t.x1 && t.y0 <= t.y1;
+}
+
+// Reference rasterizer that tests one pixel at a time. It uses exactly the same
+// float expressions as simd one, so their results must match bit by bit.
+static void rasterize_occluder_triangle_reference(f32 *depth, const Occluder_Triangle &t) {
+    for (s32 y = t.y0; y <= t.y1; ++y) {
+        const f32 py = (f32)y + 0.5f;
+        auto row = depth + y * Occlusion_Buffer::WIDTH;
+
+        for (s32 x = t.x0; x <= t.x1; ++x) {
+            const f32 px = (f32)x + 0.5f;
+
+            const f32 e0 = t.edge_a[0] * px + t.edge_b[0] * py + t.edge_c[0];
+            const f32 e1 = t.edge_a[1] * px + t.edge_b[1] * py + t.edge_c[1];
+            const f32 e2 = t.edge_a[2] * px + t.edge_b[2] * py + t.edge_c[2];
+            if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) continue;
+
+            const f32 z = t.depth_a * px + t.depth_b * py + t.depth_c;
+            row[x] = Min(row[x], z);
+        }
+    }
+}
+
+// Rasterize 4 pixels of a row at a time, row start is aligned down to 4 pixels and
+// lanes outside triangle bounds are masked out.
+static void rasterize_occluder_triangle(f32 *depth, const Occluder_Triangle &t) {
+    const auto zero = _mm_setzero_ps();
+    const auto lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+    __m128 ea[3], eb[3], ec[3];
+    for (u32 i = 0; i < 3; ++i) {
+        ea[i] = _mm_set1_ps(t.edge_a[i]);
+        eb[i] = _mm_set1_ps(t.edge_b[i]);
+        ec[i] = _mm_set1_ps(t.edge_c[i]);
+    }
+
+    const auto za = _mm_set1_ps(t.depth_a);
+    const auto zb = _mm_set1_ps(t.depth_b);
+    const auto zc = _mm_set1_ps(t.depth_c);
+
+    const s32 x_start = t.x0 & ~3;
+    const auto x_min  = _mm_set1_epi32(t.x0);
+    const auto x_max  = _mm_set1_epi32(t.x1);
+
+    for (s32 y = t.y0; y <= t.y1; ++y) {
+        const auto py = _mm_set1_ps((f32)y + 0.5f);
+        auto row = depth + y * Occlusion_Buffer::WIDTH;
+
+        for (s32 x = x_start; x <= t.x1; x += 4) {
+            const auto xi = _mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3));
+            const auto px = _mm_add_ps(_mm_set1_ps((f32)x), lane);
+
+            const auto in_x = _mm_andnot_si128(_mm_or_si128(_mm_cmplt_epi32(xi, x_min), _mm_cmpgt_epi32(xi, x_max)),
+                                               _mm_set1_epi32(-1));
+            auto mask = _mm_castsi128_ps(in_x);
+
+            for (u32 i = 0; i < 3; ++i) {
+                const auto e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ea[i], px), _mm_mul_ps(eb[i], py)), ec[i]);
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(e, zero));
+            }
+
+            if (_mm_movemask_ps(mask) == 0) continue;
+
+            const auto z   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(za, px), _mm_mul_ps(zb, py)), zc);
+            const auto old = _mm_loadu_ps(row + x);
+            const auto res = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(old, z)), _mm_andnot_ps(mask, old));
+            _mm_storeu_ps(row + x, res);
+        }
+    }
+}
+
+typedef void (*Rasterize_Occluder_Triangle_Proc) (f32 *depth, const Occluder_Triangle &t);
+
+static void draw_occluder(Occlusion_Buffer *buffer, const Matrix4 &object_to_world,
+                          const Vector3 *positions, const u32 *indices, u32 index_count,
+                          Rasterize_Occluder_Triangle_Proc rasterize) {
+    const auto mvp = object_to_world * buffer->view_proj;
+    auto depth = get_occlusion_level(buffer, 0);
+    auto &stats = buffer->stats;
+
+    stats.occluder_count += 1;
+
+    for (u32 i = 0; i + 3 <= index_count; i += 3) {
+        Vector4 v[3];
+        for (u32 j = 0; j < 3; ++j) {
+            v[j] = transform_to_clip(positions[indices[i + j]], mvp);
+        }
+
+        Occluder_Triangle t;
+        if (!setup_occluder_triangle(v[0], v[1], v[2], t)) {
+            stats.skipped_triangle_count += 1;
+            continue;
+        }
+
+        rasterize(depth, t);
+        stats.triangle_count += 1;
+    }
+}
+
+void begin_occlusion(Occlusion_Buffer *buffer, const Matrix4 &view_proj) {
+    buffer->view_proj = view_proj;
+    buffer->stats     = {};
+
+    u32 offset = 0;
+    for (u32 i = 0; i < Occlusion_Buffer::LEVEL_COUNT; ++i) {
+        buffer->level_offsets[i] = offset;
+        offset += get_occlusion_level_width(i) * get_occlusion_level_height(i);
+    }
+
+    Assert(offset <= Occlusion_Buffer::DEPTH_SIZE);
+
+    auto depth = get_occlusion_level(buffer, 0);
+    const auto one = _mm_set1_ps(1.0f);
+    for (u32 i = 0; i < Occlusion_Buffer::WIDTH * Occlusion_Buffer::HEIGHT; i += 4) {
+        _mm_storeu_ps(depth + i, one);
+    }
+}
+
+void draw_occluder(Occlusion_Buffer *buffer, const Matrix4 &object_to_world, const Vector3 *positions, const u32 *indices, u32 index_count) {
+    draw_occluder(buffer, object_to_world, positions, indices, index_count, rasterize_occluder_triangle);
+}
+
+void draw_occluder_reference(Occlusion_Buffer *buffer, const Matrix4 &object_to_world, const Vector3 *positions, const u32 *indices, u32 index_count) {
+    draw_occluder(buffer, object_to_world, positions, indices, index_count, rasterize_occluder_triangle_reference);
+}
+
+void end_occlusion(Occlusion_Buffer *buffer) {
+    Profile_Zone(__func__);
+
+    for (u32 level = 1; level < Occlusion_Buffer::LEVEL_COUNT; ++level) {
+        const auto src = get_occlusion_level(buffer, level - 1);
+        auto       dst = get_occlusion_level(buffer, level);
+
+        const u32 src_width = get_occlusion_level_width (level - 1);
+        const u32 width     = get_occlusion_level_width (level);
+        const u32 height    = get_occlusion_level_height(level);
+
+        for (u32 y = 0; y < height; ++y) {
+            const auto r0 = src + (2 * y + 0) * src_width;
+            const auto r1 = src + (2 * y + 1) * src_width;
+            auto row = dst + y * width;
+
+            u32 x = 0;
+            for (; x + 4 <= width; x += 4) {
+                const auto a    = _mm_max_ps(_mm_loadu_ps(r0 + 2 * x + 0), _mm_loadu_ps(r1 + 2 * x + 0));
+                const auto b    = _mm_max_ps(_mm_loadu_ps(r0 + 2 * x + 4), _mm_loadu_ps(r1 + 2 * x + 4));
+                const auto even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+                const auto odd  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_ps(row + x, _mm_max_ps(even, odd));
+            }
+
+            for (; x < width; ++x) {
+                row[x] = Max(Max(r0[2 * x], r0[2 * x + 1]), Max(r1[2 * x], r1[2 * x + 1]));
+            }
+        }
+    }
+}
+
+bool is_occluded(const Occlusion_Buffer *buffer, const AABB &aabb) {
+    constexpr f32 W = (f32)Occlusion_Buffer::WIDTH;
+    constexpr f32 H = (f32)Occlusion_Buffer::HEIGHT;
+
+    f32 min_x = F32_MAX, min_y = F32_MAX, min_z = F32_MAX;
+    f32 max_x = -F32_MAX, max_y = -F32_MAX;
+
+    for (u32 i = 0; i < 8; ++i) {
+        const auto p = Vector3(aabb.c.x + ((i & 1) ? aabb.r.x : -aabb.r.x),
+                               aabb.c.y + ((i & 2) ? aabb.r.y : -aabb.r.y),
+                               aabb.c.z + ((i & 4) ? aabb.r.z : -aabb.r.z));
+        const auto v = transform_to_clip(p, buffer->view_proj);
+
+        // Box that reaches camera plane covers unknown part of screen.
+        if (v.w <= 1e-5f || v.z < -v.w) return false;
+
+        const f32 inv_w = 1.0f / v.w;
+        const f32 x = (v.x * inv_w * 0.5f + 0.5f) * W;
+        const f32 y = (v.y * inv_w * 0.5f + 0.5f) * H;
+        const f32 z =  v.z * inv_w * 0.5f + 0.5f;
+
+        min_x = Min(min_x, x); max_x = Max(max_x, x);
+        min_y = Min(min_y, y); max_y = Max(max_y, y);
+        min_z = Min(min_z, z);
+    }
+
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= W || min_y >= H) return false;
+
+    s32 x0 = (s32)Max(min_x, 0.0f);
+    s32 y0 = (s32)Max(min_y, 0.0f);
+    s32 x1 = (s32)Min(max_x, W - 1.0f);
+    s32 y1 = (s32)Min(max_y, H - 1.0f);
+
+    // Pick level where rect covers at most 2x2 texels.
+    u32 level = 0;
+    while (level + 1 < Occlusion_Buffer::LEVEL_COUNT && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level += 1;
+    }
+
+    x0 >>= level; x1 >>= level;
+    y0 >>= level; y1 >>= level;
+
+    const auto depth = get_occlusion_level(buffer, level);
+    const u32  width = get_occlusion_level_width(level);
+
+    for (s32 y = y0; y <= y1; ++y) {
+        for (s32 x = x0; x <= x1; ++x) {
+            if (min_z <= depth[y * width + x]) return false;
+        }
+    }
+
+    return true;
+}
+
+u32 cull_occlusion(Occlusion_Buffer *buffer, const AABB *aabbs, u32 *indices, u32 count) {
+    Profile_Zone(__func__);
+
+    u32 visible_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const u32 index = indices[i];
+        indices[visible_count] = index;
+        visible_count += !is_occluded(buffer, aabbs[index]);
+    }
+
+    buffer->stats.tested_count   += count;
+    buffer->stats.occluded_count += count - visible_count;
+
+    return visible_count;
+}
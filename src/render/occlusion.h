@@ -0,0 +1,55 @@
+#pragma once
+
+#include "collision.h"
+#include "matrix.h"
+
+// Software occlusion culling. Selected occluder meshes are rasterized on cpu to low
+// resolution depth buffer and hierarchical max depth pyramid is built from it, so
+// aabb is occluded if its nearest depth is behind the farthest occluder depth of
+// pyramid texels that cover its screen rect.
+//
+// Depth is ndc z remapped to [0, 1], cleared to 1 (far plane). It is linear in
+// screen space, so it is interpolated without perspective correction. Triangles
+// that cross near plane are skipped, as missing occluder is always conservative.
+
+struct Occlusion_Stats {
+    u32 occluder_count         = 0;
+    u32 triangle_count         = 0; // rasterized
+    u32 skipped_triangle_count = 0; // crossed near plane or degenerate
+    u32 tested_count           = 0;
+    u32 occluded_count         = 0;
+};
+
+struct Occlusion_Buffer {
+    static constexpr u32 WIDTH       = 256;
+    static constexpr u32 HEIGHT      = 128;
+    static constexpr u32 LEVEL_COUNT = 8; // down to 2x1
+    static constexpr u32 DEPTH_SIZE  = WIDTH * HEIGHT * 4 / 3 + 1; // all levels
+
+    static_assert(WIDTH % 4 == 0 && (HEIGHT >> (LEVEL_COUNT - 1)) >= 1);
+
+    Matrix4 view_proj;
+
+    u32 level_offsets [LEVEL_COUNT];
+    f32 depth         [DEPTH_SIZE];
+
+    Occlusion_Stats stats;
+};
+
+void begin_occlusion         (Occlusion_Buffer *buffer, const Matrix4 &view_proj); // clears depth and stats
+void draw_occluder           (Occlusion_Buffer *buffer, const Matrix4 &object_to_world, const Vector3 *positions, const u32 *indices, u32 index_count);
+void draw_occluder_reference (Occlusion_Buffer *buffer, const Matrix4 &object_to_world, const Vector3 *positions, const u32 *indices, u32 index_count);
+void end_occlusion           (Occlusion_Buffer *buffer); // builds depth pyramid
+
+bool is_occluded    (const Occlusion_Buffer *buffer, const AABB &aabb);
+
+// Keep indices of aabbs that are not occluded in place, return their count.
+u32  cull_occlusion (Occlusion_Buffer *buffer, const AABB *aabbs, u32 *indices, u32 count);
+
+inline u32  get_occlusion_level_width  (u32 level) { return Occlusion_Buffer::WIDTH  >> level; }
+inline u32  get_occlusion_level_height (u32 level) { return Occlusion_Buffer::HEIGHT >> level; }
+inline f32 *get_occlusion_level        (Occlusion_Buffer *buffer, u32 level) { return buffer->depth + buffer->level_offsets[level]; }
+
+inline const f32 *get_occlusion_level(const Occlusion_Buffer *buffer, u32 level) {
+    return buffer->depth + buffer->level_offsets[level];
+}
@@ -0,0 +1,216 @@
+#include "pch.h"
+#include "portal.h"
+#include "profile.h"
+#include "entity_manager.h"
+
+struct Portal_Walk_Item {
+    u32         cell;
+    Portal_Rect rect;
+    u32         depth;
+};
+
+static bool is_empty_rect(const Portal_Rect &r) {
+    return r.x0 >= r.x1 || r.y0 >= r.y1;
+}
+
+static bool contains_rect(const Portal_Rect &a, const Portal_Rect &b) {
+    if (is_empty_rect(b)) return true;
+    if (is_empty_rect(a)) return false;
+    return a.x0 <= b.x0 && a.y0 <= b.y0 && a.x1 >= b.x1 && a.y1 >= b.y1;
+}
+
+static Portal_Rect merge_rects(const Portal_Rect &a, const Portal_Rect &b) {
+    if (is_empty_rect(a)) return b;
+    if (is_empty_rect(b)) return a;
+    return Portal_Rect { Min(a.x0, b.x0), Min(a.y0, b.y0), Max(a.x1, b.x1), Max(a.y1, b.y1) };
+}
+
+static Portal_Rect intersect_rects(const Portal_Rect &a, const Portal_Rect &b) {
+    return Portal_Rect { Max(a.x0, b.x0), Max(a.y0, b.y0), Min(a.x1, b.x1), Min(a.y1, b.y1) };
+}
+
+// Ndc rect of aabb corners, whole screen if any corner is behind camera as its
+// projection is not bounded then.
+static Portal_Rect project_portal_rect(const AABB &aabb, const Matrix4 &m) {
+    constexpr f32 NEAR_W_EPSILON = 1e-5f;
+
+    Portal_Rect rect = { F32_MAX, F32_MAX, -F32_MAX, -F32_MAX };
+    for (u32 i = 0; i < 8; ++i) {
+        const auto p = Vector3(aabb.c.x + ((i & 1) ? aabb.r.x : -aabb.r.x),
+                               aabb.c.y + ((i & 2) ? aabb.r.y : -aabb.r.y),
+                               aabb.c.z + ((i & 4) ? aabb.r.z : -aabb.r.z));
+
+        // Points are transformed as row vectors (p * m), same as in make_frustum.
+        const f32 x = p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0];
+        const f32 y = p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1];
+        const f32 w = p.x * m[0][3] + p.y * m[1][3] + p.z * m[2][3] + m[3][3];
+
+        if (w <= NEAR_W_EPSILON) return Portal_Rect { -1.0f, -1.0f, 1.0f, 1.0f };
+
+        rect.x0 = Min(rect.x0, x / w);
+        rect.y0 = Min(rect.y0, y / w);
+        rect.x1 = Max(rect.x1, x / w);
+        rect.y1 = Max(rect.y1, y / w);
+    }
+
+    return rect;
+}
+
+void build_portal_cells(Portal_Visibility *visibility, const Entity_Manager *manager) {
+    Profile_Zone(__func__);
+
+    auto &cells   = visibility->cells;
+    auto &portals = visibility->portals;
+
+    // Cells keep their portal arrays between frames.
+    u32 cell_count = 0;
+    For_Entities (manager->entities, E_CELL) {
+        if (cell_count == cells.count) array_add(cells, {});
+
+        auto &cell = cells[cell_count];
+        cell.bounds = it.aabb;
+        cell.portals.count = 0;
+        cell_count += 1;
+    }
+
+    for (u32 i = cell_count; i < cells.count; ++i) {
+        array_reset(cells[i].portals);
+    }
+
+    cells.count = cell_count;
+    portals.count = 0;
+
+    For_Entities (manager->entities, E_PORTAL) {
+        Portal_Link portal;
+        portal.bounds = it.aabb;
+
+        for (u32 i = 0; i < cells.count; ++i) {
+            if (!overlap(portal.bounds, cells[i].bounds)) continue;
+
+            if (portal.cell_count == Portal_Link::MAX_CELLS) {
+                log(LOG_WARNING, "Portal 0x%X overlaps more than %u cells", it.eid, Portal_Link::MAX_CELLS);
+                break;
+            }
+
+            portal.cells[portal.cell_count] = i;
+            portal.cell_count += 1;
+        }
+
+        if (portal.cell_count < 2) continue;
+
+        array_add(portals, portal);
+        for (u32 i = 0; i < portal.cell_count; ++i) {
+            array_add(cells[portal.cells[i]].portals, portals.count - 1);
+        }
+    }
+
+    visibility->stats.cell_count   = cells.count;
+    visibility->stats.portal_count = portals.count;
+}
+
+u32 find_portal_cell(const Portal_Visibility *visibility, Vector3 p) {
+    const auto &cells = visibility->cells;
+    for (u32 i = 0; i < cells.count; ++i) {
+        if (inside(p, cells[i].bounds)) return i;
+    }
+
+    return Portal_Visibility::NONE;
+}
+
+void update_portal_visibility(Portal_Visibility *visibility, const Camera &camera) {
+    Profile_Zone(__func__);
+
+    auto &cells   = visibility->cells;
+    auto &stats   = visibility->stats;
+    const auto &portals = visibility->portals;
+
+    visibility->view_proj   = camera.view_proj;
+    visibility->camera_cell = find_portal_cell(visibility, camera.position);
+
+    stats.visible_cell_count = 0;
+    stats.visit_count        = 0;
+    stats.portal_test_count  = 0;
+    stats.tested_count       = 0;
+    stats.culled_count       = 0;
+
+    For (cells) it.rect = {};
+
+    if (visibility->camera_cell == Portal_Visibility::NONE) return;
+
+    // Cell is walked again only if it is seen through part of screen it was not
+    // seen before, union rect grows each time, so walk ends.
+    auto stack = Array <Portal_Walk_Item> { .allocator = __temporary_allocator };
+    array_add(stack, Portal_Walk_Item { visibility->camera_cell, Portal_Rect { -1.0f, -1.0f, 1.0f, 1.0f }, 0 });
+
+    while (stack.count) {
+        const auto item = array_pop(stack);
+        auto &cell = cells[item.cell];
+
+        if (contains_rect(cell.rect, item.rect)) continue;
+
+        cell.rect = merge_rects(cell.rect, item.rect);
+        stats.visit_count += 1;
+
+        if (item.depth == Portal_Visibility::MAX_DEPTH) continue;
+
+        const auto &r = item.rect;
+        const auto frustum = make_frustum(visibility->view_proj, r.x0, r.y0, r.x1, r.y1);
+
+        For (cell.portals) {
+            const auto &portal = portals[it];
+
+            stats.portal_test_count += 1;
+            if (!inside(portal.bounds, frustum)) continue;
+
+            const auto rect = intersect_rects(project_portal_rect(portal.bounds, visibility->view_proj), item.rect);
+            if (is_empty_rect(rect)) continue;
+
+            for (u32 i = 0; i < portal.cell_count; ++i) {
+                if (portal.cells[i] == item.cell) continue;
+                array_add(stack, Portal_Walk_Item { portal.cells[i], rect, item.depth + 1 });
+            }
+        }
+    }
+
+    For (cells) {
+        if (is_empty_rect(it.rect)) continue;
+
+        it.frustum = make_frustum(visibility->view_proj, it.rect.x0, it.rect.y0, it.rect.x1, it.rect.y1);
+        stats.visible_cell_count += 1;
+    }
+}
+
+bool is_portal_visible(const Portal_Visibility *visibility, const AABB &aabb) {
+    if (visibility->camera_cell == Portal_Visibility::NONE) return true;
+
+    // Aabb is visible if it is seen from any cell it overlaps.
+    bool in_cell = false;
+    For (visibility->cells) {
+        if (!overlap(aabb, it.bounds)) continue;
+
+        in_cell = true;
+        if (is_empty_rect(it.rect)) continue;
+        if (inside(aabb, it.frustum)) return true;
+    }
+
+    return !in_cell;
+}
+
+u32 cull_portals(Portal_Visibility *visibility, const AABB *aabbs, u32 *indices, u32 count) {
+    Profile_Zone(__func__);
+
+    if (visibility->camera_cell == Portal_Visibility::NONE) return count;
+
+    u32 visible_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (is_portal_visible(visibility, aabbs[indices[i]])) {
+            indices[visible_count] = indices[i];
+            visible_count += 1;
+        }
+    }
+
+    visibility->stats.tested_count += count;
+    visibility->stats.culled_count += count - visible_count;
+
+    return visible_count;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "collision.h"
+#include "matrix.h"
+
+// Cell and portal visibility. Level space is split into cells (E_CELL entities,
+// their aabbs are cell volumes) connected by portals (E_PORTAL entities, their aabbs
+// are openings that should overlap volumes of cells they connect). Visibility walks
+// cells starting from the one with camera, each portal seen through current view
+// narrows it to ndc rect of portal bounds, so each visited cell gets union rect of
+// all views it was reached with.
+//
+// Geometry outside of all cells is never culled, same as everything if camera is
+// outside of all cells, so levels without cells are not affected. Walk has fixed
+// order of cells and portals, so it gives the same result for the same input.
+
+struct Portal_Rect {
+    f32 x0 = 1.0f; // empty by default
+    f32 y0 = 1.0f;
+    f32 x1 = -1.0f;
+    f32 y1 = -1.0f;
+};
+
+struct Portal_Cell {
+    AABB             bounds;
+    Array <u32>      portals; // links to other cells
+    Portal_Rect      rect;    // union of views, empty if cell is not visible
+    Frustum          frustum; // of rect, valid if cell is visible
+};
+
+struct Portal_Link {
+    static constexpr u32 MAX_CELLS = 4;
+
+    AABB bounds;
+    u32  cells[MAX_CELLS];
+    u32  cell_count = 0;
+};
+
+struct Portal_Stats {
+    u32 cell_count         = 0;
+    u32 portal_count       = 0;
+    u32 visible_cell_count = 0;
+    u32 visit_count        = 0; // walk steps, cell can be visited several times
+    u32 portal_test_count  = 0;
+    u32 tested_count       = 0; // aabbs
+    u32 culled_count       = 0;
+};
+
+struct Portal_Visibility {
+    static constexpr u32 NONE      = U32_MAX;
+    static constexpr u32 MAX_DEPTH = 32; // portals walked through from camera cell
+
+    Array <Portal_Cell> cells;
+    Array <Portal_Link> portals;
+
+    Matrix4 view_proj;
+    u32     camera_cell = NONE; // culling is disabled if none
+
+    Portal_Stats stats;
+};
+
+// Collect cells and portals from entities, called each frame as they may move.
+void build_portal_cells      (Portal_Visibility *visibility, const struct Entity_Manager *manager);
+void update_portal_visibility(Portal_Visibility *visibility, const Camera &camera);
+
+u32  find_portal_cell        (const Portal_Visibility *visibility, Vector3 p);
+bool is_portal_visible       (const Portal_Visibility *visibility, const AABB &aabb);
+
+// Keep indices of aabbs that are visible through portals in place, return their count.
+u32  cull_portals            (Portal_Visibility *visibility, const AABB *aabbs, u32 *indices, u32 count);
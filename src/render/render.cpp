@@ -6,6 +6,8 @@
 #include "shader_globals.h"
 #include "shader_binding_model.h"
 #include "render_frame.h"
+#include "gpu_capture.h"
+#include "gpu_heap.h"
 #include "render_batch.h"
 #include "viewport.h"
 #include "line_geometry.h"
@@ -24,7 +26,6 @@
 #include "slang.h"
 #include "slang-com-ptr.h"
 #include <sstream>
-#include <algorithm>
 
 extern bool init_render_backend(Window *window);
 extern bool post_init_render_backend();
@@ -77,6 +78,14 @@ void gpu_init_frontend() {
                                                 GPU_SAMPLER_COMPARE_MODE_NONE,
                                                 GPU_SAMPLER_COMPARE_FUNCTION_NONE,
                                                 -1000.0f, 1000.0f, COLOR4F_BLACK);
+    gpu.sampler_linear_color = gpu_new_sampler(GPU_SAMPLER_FILTER_LINEAR,
+                                               GPU_SAMPLER_FILTER_LINEAR,
+                                               GPU_SAMPLER_WRAP_CLAMP_TO_EDGE,
+                                               GPU_SAMPLER_WRAP_CLAMP_TO_EDGE,
+                                               GPU_SAMPLER_WRAP_CLAMP_TO_EDGE,
+                                               GPU_SAMPLER_COMPARE_MODE_NONE,
+                                               GPU_SAMPLER_COMPARE_FUNCTION_NONE,
+                                               -1000.0f, 1000.0f, COLOR4F_BLACK);
     gpu.sampler_default_depth_stencil = gpu_new_sampler(GPU_SAMPLER_FILTER_NEAREST_MIPMAP_LINEAR,
                                                         GPU_SAMPLER_FILTER_NEAREST,
                                                         GPU_SAMPLER_WRAP_REPEAT,
@@ -86,20 +95,37 @@ void gpu_init_frontend() {
                                                         GPU_SAMPLER_COMPARE_FUNCTION_LESS,
                                                         -1000.0f, 1000.0f, COLOR4F_BLACK);
     
-    gpu_write_allocator.buffer = gpu_new_buffer(GPU_BUFFER_TYPE_STAGING_UNCACHED, Megabytes(8));
+    gpu_write_allocator.buffer = gpu_new_buffer(GPU_BUFFER_TYPE_STAGING_UNCACHED, Megabytes(40));
     gpu_read_allocator.buffer  = gpu_new_buffer(GPU_BUFFER_TYPE_STAGING_CACHED,   Megabytes(1));
 
+    // Meshes are bound from write buffer along with other vertex data, so mesh heap
+    // takes fixed budget of it.
+    init(&gpu_mesh_heap, gpu_alloc(Megabytes(32), &gpu_write_allocator));
+    Assert(gpu_mesh_heap.memory.offset % sizeof(Mesh_Vertex) == 0);
+
+    mesh_vertex_offsets[0] = gpu_mesh_heap.memory.offset + offsetof(Mesh_Vertex, position);
+    mesh_vertex_offsets[1] = gpu_mesh_heap.memory.offset + offsetof(Mesh_Vertex, normal);
+    mesh_vertex_offsets[2] = gpu_mesh_heap.memory.offset + offsetof(Mesh_Vertex, uv);
+    mesh_vertex_offsets[3] = 0; // eid stream, bound per draw
+
+    // Heap aligns blocks relative to gpu buffer, start is aligned for cbuffer binds
+    // anyway, so blocks of constant heap need no padding.
+    gpu_write_allocator.used = Align(gpu_write_allocator.used, gpu_uniform_buffer_offset_alignment());
+    init(&gpu_constant_heap, gpu_alloc(Megabytes(2), &gpu_write_allocator));
+
     {
         Gpu_Vertex_Binding bindings[4];
+        // Mesh vertices are interleaved, each attribute is bound as separate stream
+        // at its offset in vertex, see mesh_vertex_offsets.
         bindings[0].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
         bindings[0].index      = 0;
-        bindings[0].stride     = 12;
+        bindings[0].stride     = sizeof(Mesh_Vertex);
         bindings[1].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
         bindings[1].index      = 1;
-        bindings[1].stride     = 12;
+        bindings[1].stride     = sizeof(Mesh_Vertex);
         bindings[2].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
         bindings[2].index      = 2;
-        bindings[2].stride     = 8;
+        bindings[2].stride     = sizeof(Mesh_Vertex);
         bindings[3].input_rate = GPU_VERTEX_INPUT_RATE_INSTANCE;
         bindings[3].index      = 3;
         bindings[3].stride     = 4;
@@ -195,6 +221,459 @@ void gpu_append(Gpu_Allocation *memory, const void *data, u64 size) {
     memory->used += size;
 }
 
+void init(Gpu_Upload_Ring *ring, u64 size) {
+    Assert(Is_Power_Of_Two(size));
+    
+    ring->buffer = gpu_new_buffer(GPU_BUFFER_TYPE_STAGING_UNCACHED, size);
+    ring->size   = size;
+    ring->head   = 0;
+    ring->tail   = 0;
+    
+    set(ring->frame_ends, 0, sizeof(ring->frame_ends));
+}
+
+static void grow_upload_ring(Gpu_Upload_Ring *ring, u64 min_size) {
+    u64 size = ring->size * 2;
+    while (size < 2 * min_size) size *= 2;
+
+    // Current and in flight frames may still use old buffer.
+    array_add(ring->retired_buffers, { ring->buffer, frame_index });
+
+    log(LOG_WARNING, "Growing gpu upload ring 0x%X from %llu to %llu bytes", ring, ring->size, size);
+    
+    init(ring, size);
+    ring->grow_count += 1;
+}
+
+Gpu_Allocation gpu_alloc(u64 size, u64 alignment, Gpu_Upload_Ring *ring) {
+    u64 head   = Align(ring->head, alignment);
+    u64 offset = head % ring->size;
+
+    // Allocation is contiguous, so rest of the ring is skipped if it does not fit.
+    if (offset + size > ring->size) {
+        head  += ring->size - offset;
+        offset = 0;
+    }
+
+    if (head + size - ring->tail > ring->size) {
+        grow_upload_ring(ring, size + alignment);
+        head   = 0;
+        offset = 0;
+    }
+
+    ring->frame_used += head + size - ring->head;
+    ring->head        = head + size;
+    
+    auto &buffer = gpu.buffers[ring->buffer];
+    
+    Gpu_Allocation memory;
+    memory.buffer      = ring->buffer;
+    memory.size        = size;
+    memory.used        = 0;
+    memory.offset      = offset;
+    memory.mapped_data = (u8 *)buffer.mapped_data + offset;
+
+    return memory;
+}
+
+void retire_upload_frame(Gpu_Upload_Ring *ring) {
+    const u32 slot = frame_index % RENDER_FRAMES_IN_FLIGHT;
+    ring->tail = Max(ring->tail, ring->frame_ends[slot]);
+    ring->frame_used = 0;
+
+    for (u32 i = 0; i < ring->retired_buffers.count;) {
+        const auto &retired = ring->retired_buffers[i];
+        if (retired.frame + RENDER_FRAMES_IN_FLIGHT > frame_index) {
+            i += 1;
+            continue;
+        }
+
+        gpu_delete_buffer(retired.buffer);
+        
+        ring->retired_buffers[i] = ring->retired_buffers[ring->retired_buffers.count - 1];
+        ring->retired_buffers.count -= 1;
+    }
+}
+
+void end_upload_frame(Gpu_Upload_Ring *ring) {
+    const u32 slot = frame_index % RENDER_FRAMES_IN_FLIGHT;
+    ring->frame_ends[slot] = ring->head;
+    ring->last_frame_used  = ring->frame_used;
+    ring->high_water       = Max(ring->high_water, ring->frame_used);
+}
+
+static u32 gpu_heap_msb(u64 x) {
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (u32)index;
+}
+
+static u32 gpu_heap_lsb(u32 x) {
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (u32)index;
+}
+
+static void gpu_heap_mapping(u64 size, u32 *fl, u32 *sl) {
+    const u64 granules = size / Gpu_Heap::GRANULARITY;
+    if (granules < Gpu_Heap::SL_COUNT) {
+        *fl = 0;
+        *sl = (u32)granules;
+        return;
+    }
+
+    const u32 msb = gpu_heap_msb(granules);
+    *fl = msb - Gpu_Heap::SL_BITS + 1;
+    *sl = (u32)(granules >> (msb - Gpu_Heap::SL_BITS)) - Gpu_Heap::SL_COUNT;
+}
+
+static u32 gpu_heap_new_block(Gpu_Heap *heap) {
+    auto &unused = heap->unused_blocks;
+    if (unused.count) {
+        unused.count -= 1;
+        return unused.items[unused.count];
+    }
+
+    array_add(heap->blocks);
+    return heap->blocks.count - 1;
+}
+
+static void gpu_heap_insert_free(Gpu_Heap *heap, u32 index) {
+    auto &block = heap->blocks[index];
+    
+    u32 fl, sl;
+    gpu_heap_mapping(block.size, &fl, &sl);
+
+    const u32 head = heap->free_lists[fl][sl];
+    if (head != Gpu_Heap::NONE) heap->blocks[head].prev_free = index;
+    
+    block.free      = true;
+    block.prev_free = Gpu_Heap::NONE;
+    block.next_free = head;
+    
+    heap->free_lists[fl][sl] = index;
+    heap->fl_bitmap      |= 1u << fl;
+    heap->sl_bitmaps[fl] |= 1u << sl;
+
+    heap->stats.free_size        += block.size;
+    heap->stats.free_block_count += 1;
+}
+
+static void gpu_heap_remove_free(Gpu_Heap *heap, u32 index) {
+    auto &block = heap->blocks[index];
+    
+    u32 fl, sl;
+    gpu_heap_mapping(block.size, &fl, &sl);
+
+    if (block.prev_free != Gpu_Heap::NONE) heap->blocks[block.prev_free].next_free = block.next_free;
+    else heap->free_lists[fl][sl] = block.next_free;
+
+    if (block.next_free != Gpu_Heap::NONE) heap->blocks[block.next_free].prev_free = block.prev_free;
+
+    if (heap->free_lists[fl][sl] == Gpu_Heap::NONE) {
+        heap->sl_bitmaps[fl] &= ~(1u << sl);
+        if (!heap->sl_bitmaps[fl]) heap->fl_bitmap &= ~(1u << fl);
+    }
+    
+    block.free = false;
+    
+    heap->stats.free_size        -= block.size;
+    heap->stats.free_block_count -= 1;
+}
+
+static u32 gpu_heap_find_free(Gpu_Heap *heap, u64 size) {
+    // Round size up to the next second level range, so any block of found list fits.
+    u64 granules = size / Gpu_Heap::GRANULARITY;
+    if (granules >= Gpu_Heap::SL_COUNT) {
+        granules += (1ull << (gpu_heap_msb(granules) - Gpu_Heap::SL_BITS)) - 1;
+    }
+
+    u32 fl, sl;
+    gpu_heap_mapping(granules * Gpu_Heap::GRANULARITY, &fl, &sl);
+    if (fl >= Gpu_Heap::FL_COUNT) return Gpu_Heap::NONE;
+
+    u32 sl_map = heap->sl_bitmaps[fl] & (~0u << sl);
+    if (!sl_map) {
+        const u32 fl_map = fl + 1 < Gpu_Heap::FL_COUNT ? heap->fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (!fl_map) return Gpu_Heap::NONE;
+
+        fl     = gpu_heap_lsb(fl_map);
+        sl_map = heap->sl_bitmaps[fl];
+    }
+
+    sl = gpu_heap_lsb(sl_map);
+    return heap->free_lists[fl][sl];
+}
+
+// Splits block at given size and returns remainder, which is not in free lists yet.
+static u32 gpu_heap_split(Gpu_Heap *heap, u32 index, u64 size) {
+    const u32 rest = gpu_heap_new_block(heap);
+    
+    auto &block     = heap->blocks[index];
+    auto &remainder = heap->blocks[rest];
+
+    remainder = {};
+    remainder.offset    = block.offset + size;
+    remainder.size      = block.size - size;
+    remainder.prev_phys = index;
+    remainder.next_phys = block.next_phys;
+
+    if (block.next_phys != Gpu_Heap::NONE) heap->blocks[block.next_phys].prev_phys = rest;
+    else heap->last_block = rest;
+
+    block.next_phys = rest;
+    block.size      = size;
+
+    return rest;
+}
+
+static void gpu_heap_absorb_next(Gpu_Heap *heap, u32 index) {
+    auto &block = heap->blocks[index];
+    
+    const u32 next = block.next_phys;
+    const auto &next_block = heap->blocks[next];
+
+    block.size     += next_block.size;
+    block.next_phys = next_block.next_phys;
+    
+    if (block.next_phys != Gpu_Heap::NONE) heap->blocks[block.next_phys].prev_phys = index;
+    else heap->last_block = index;
+
+    array_add(heap->unused_blocks, next);
+}
+
+static void gpu_heap_free_block(Gpu_Heap *heap, u32 index) {
+    // Merge with free neighbours, so there are never two free blocks in a row.
+    const u32 next = heap->blocks[index].next_phys;
+    if (next != Gpu_Heap::NONE && heap->blocks[next].free) {
+        gpu_heap_remove_free (heap, next);
+        gpu_heap_absorb_next(heap, index);
+    }
+
+    const u32 prev = heap->blocks[index].prev_phys;
+    if (prev != Gpu_Heap::NONE && heap->blocks[prev].free) {
+        gpu_heap_remove_free (heap, prev);
+        gpu_heap_absorb_next(heap, prev);
+        index = prev;
+    }
+
+    gpu_heap_insert_free(heap, index);
+}
+
+static u32 gpu_heap_alloc_block(Gpu_Heap *heap, u64 size, u64 alignment) {
+    const u64 search_size = alignment > Gpu_Heap::GRANULARITY ? size + alignment - Gpu_Heap::GRANULARITY : size;
+    
+    u32 index = gpu_heap_find_free(heap, search_size);
+    if (index == Gpu_Heap::NONE) return Gpu_Heap::NONE;
+
+    gpu_heap_remove_free(heap, index);
+
+    // Alignment is relative to gpu buffer, not heap start. Found block is surrounded
+    // by used ones, so padding and remainder never have free neighbours.
+    const u64 block_offset = heap->memory.offset + heap->blocks[index].offset;
+    const u64 padding      = Align(block_offset, alignment) - block_offset;
+    
+    if (padding) {
+        const u32 rest = gpu_heap_split(heap, index, padding);
+        gpu_heap_insert_free(heap, index);
+        index = rest;
+    }
+
+    if (heap->blocks[index].size - size >= Gpu_Heap::GRANULARITY) {
+        const u32 rest = gpu_heap_split(heap, index, size);
+        gpu_heap_insert_free(heap, rest);
+    }
+
+    auto &block = heap->blocks[index];
+    block.alignment = alignment;
+    block.owner     = null;
+    block.relocate  = null;
+
+    return index;
+}
+
+static Gpu_Allocation gpu_heap_allocation(const Gpu_Heap *heap, u32 index) {
+    const auto &block = heap->blocks[index];
+    
+    Gpu_Allocation memory;
+    memory.buffer      = heap->memory.buffer;
+    memory.offset      = heap->memory.offset + block.offset;
+    memory.size        = block.size;
+    memory.used        = 0;
+    memory.mapped_data = (u8 *)heap->memory.mapped_data + block.offset;
+
+    return memory;
+}
+
+static u64 gpu_heap_largest_free_size(const Gpu_Heap *heap) {
+    if (!heap->fl_bitmap) return 0;
+
+    const u32 fl = gpu_heap_msb(heap->fl_bitmap);
+    const u32 sl = gpu_heap_msb(heap->sl_bitmaps[fl]);
+
+    u64 size = 0;
+    for (u32 i = heap->free_lists[fl][sl]; i != Gpu_Heap::NONE; i = heap->blocks[i].next_free) {
+        size = Max(size, heap->blocks[i].size);
+    }
+    
+    return size;
+}
+
+void init(Gpu_Heap *heap, Gpu_Allocation memory) {
+    Assert(memory.offset % Gpu_Heap::GRANULARITY == 0);
+    
+    heap->memory      = memory;
+    heap->memory.size = memory.size & ~(Gpu_Heap::GRANULARITY - 1);
+    heap->fl_bitmap   = 0;
+    heap->stats       = {};
+
+    set(heap->sl_bitmaps, 0,    sizeof(heap->sl_bitmaps));
+    set(heap->free_lists, 0xFF, sizeof(heap->free_lists));
+
+    array_clear(heap->blocks);
+    array_clear(heap->unused_blocks);
+    array_clear(heap->pending_frees);
+    table_clear(heap->block_table);
+    table_set_hash(heap->block_table, [](const u64 &offset) { return (u64)hash_pcg((u32)(offset / Gpu_Heap::GRANULARITY)); });
+
+    const u32 index = gpu_heap_new_block(heap);
+    
+    auto &block = heap->blocks[index];
+    block = {};
+    block.offset    = 0;
+    block.size      = heap->memory.size;
+    block.prev_phys = Gpu_Heap::NONE;
+    block.next_phys = Gpu_Heap::NONE;
+
+    heap->last_block = index;
+    gpu_heap_insert_free(heap, index);
+}
+
+Gpu_Allocation gpu_alloc(u64 size, u64 alignment, Gpu_Heap *heap, void *owner, Gpu_Heap_Relocate_Proc relocate) {
+    Assert(Is_Power_Of_Two(alignment));
+    
+    alignment = Max(alignment, Gpu_Heap::GRANULARITY);
+    size      = Align(Max(size, Gpu_Heap::GRANULARITY), Gpu_Heap::GRANULARITY);
+
+    const u32 index = gpu_heap_alloc_block(heap, size, alignment);
+    if (index == Gpu_Heap::NONE) {
+        log(LOG_ERROR, "Failed to allocate %llu bytes from gpu heap, %llu bytes free, largest free block %llu bytes",
+            size, heap->stats.free_size, gpu_heap_largest_free_size(heap));
+        return {};
+    }
+
+    auto &block = heap->blocks[index];
+    block.owner    = owner;
+    block.relocate = relocate;
+
+    table_add(heap->block_table, block.offset, index);
+    
+    heap->stats.used_size        += block.size;
+    heap->stats.allocation_count += 1;
+    
+    return gpu_heap_allocation(heap, index);
+}
+
+void gpu_release(Gpu_Allocation *memory, Gpu_Heap *heap) {
+    if (!memory->size) return;
+    
+    const u64 offset = memory->offset - heap->memory.offset;
+    
+    const auto found = table_find(heap->block_table, offset);
+    if (!found) {
+        log(LOG_ERROR, "Failed to find block at offset %llu in gpu heap to release", memory->offset);
+        return;
+    }
+
+    const u32 index = *found;
+    table_remove(heap->block_table, offset);
+
+    auto &block = heap->blocks[index];
+    block.owner    = null;
+    block.relocate = null;
+
+    heap->stats.used_size        -= block.size;
+    heap->stats.pending_size     += block.size;
+    heap->stats.allocation_count -= 1;
+    
+    array_add(heap->pending_frees, { index, frame_index });
+
+    *memory = {};
+}
+
+void update_gpu_heap(Gpu_Heap *heap, u64 max_move_size) {
+    Profile_Zone(__func__);
+
+    auto &pending_frees = heap->pending_frees;
+    for (u32 i = 0; i < pending_frees.count;) {
+        const auto pending = pending_frees[i];
+        if (pending.frame + RENDER_FRAMES_IN_FLIGHT > frame_index) {
+            i += 1;
+            continue;
+        }
+
+        heap->stats.pending_size -= heap->blocks[pending.block].size;
+        gpu_heap_free_block(heap, pending.block);
+
+        pending_frees[i] = pending_frees[pending_frees.count - 1];
+        pending_frees.count -= 1;
+    }
+
+    // Move allocations from the end of the heap to free blocks before them. Heap
+    // memory is mapped write only, so data is copied on gpu by command recorded
+    // before draws of this frame. Target block is not read by frames in flight as
+    // released blocks become free only after them, old block is released the same
+    // way, as frames in flight may still read it.
+    u64 moved_size = 0;
+    u32 index = heap->last_block;
+    
+    while (index != Gpu_Heap::NONE && moved_size < max_move_size) {
+        const auto block = heap->blocks[index];
+        if (block.free || !block.relocate) {
+            index = block.prev_phys;
+            continue;
+        }
+
+        const u32 target = gpu_heap_alloc_block(heap, block.size, block.alignment);
+        if (target == Gpu_Heap::NONE) break;
+
+        if (heap->blocks[target].offset > block.offset) {
+            gpu_heap_free_block(heap, target);
+            index = heap->blocks[index].prev_phys;
+            continue;
+        }
+
+        const auto memory = gpu_heap_allocation(heap, target);
+        gpu_cmd_copy_buffer(get_command_buffer(), heap->memory.buffer, heap->memory.offset + block.offset,
+                            memory.buffer, memory.offset, block.size);
+
+        auto &target_block = heap->blocks[target];
+        target_block.owner    = block.owner;
+        target_block.relocate = block.relocate;
+
+        table_remove(heap->block_table, block.offset);
+        table_add   (heap->block_table, target_block.offset, target);
+
+        auto &moved_block = heap->blocks[index];
+        moved_block.owner    = null;
+        moved_block.relocate = null;
+        
+        array_add(pending_frees, { index, frame_index });
+
+        heap->stats.used_size    -= block.size;
+        heap->stats.used_size    += target_block.size;
+        heap->stats.pending_size += block.size;
+        heap->stats.moved_size   += block.size;
+        
+        block.relocate(block.owner, memory);
+        
+        moved_size += block.size;
+        index = heap->blocks[index].prev_phys;
+    }
+
+    heap->stats.largest_free_size = gpu_heap_largest_free_size(heap);
+}
+
 u32 gpu_max_mipmap_count(u32 width, u32 height) {
     return (u32)Floor(Log2((f32)Max(width, height))) + 1;
 }
@@ -221,47 +700,250 @@ static Render_Frame *render_frame = null;
 void init_render_frame() {
     auto frame = render_frame = New(Render_Frame);
 
-    frame->opaque_batch      = make_render_batch(256);
-    frame->transparent_batch = make_render_batch(128);
-    frame->hud_batch         = make_render_batch(4096);
+    // Batches do not fit into main arena along with render frame, so they are in heap.
+    frame->opaque_batch      = make_render_batch(256,  __default_allocator);
+    frame->transparent_batch = make_render_batch(128,  __default_allocator);
+    frame->hud_batch         = make_render_batch(4096, __default_allocator);
 
     for (auto i = 0; i < RENDER_FRAMES_IN_FLIGHT; ++i) {
         frame->syncs           [i] = {};
-        frame->command_buffers [i] = gpu_new_command_buffer(512);
-        frame->gpu_indirect_allocations[i] = gpu_alloc(Kilobytes(64), &gpu_write_allocator);
+        frame->command_buffers [i] = gpu_new_command_buffer(Kilobytes(16));
     }
 
-    // @Cleanup: align data here to ensure submit buffers alignment for cbuffers, which is
-    // kinda annoying, maybe create separate gpu buffer for cbuffer data submit.
-    auto write_buffer = gpu_get_buffer(gpu_write_allocator.buffer);
-    write_buffer->used = Align(write_buffer->used, (u64)gpu_uniform_buffer_offset_alignment());
-    
-    for (auto i = 0; i < RENDER_FRAMES_IN_FLIGHT; ++i) {
-        frame->gpu_submit_allocations[i] = gpu_alloc(Kilobytes(32), &gpu_write_allocator);
-    }
+    init(&frame->upload_ring, Megabytes(1));
+    init_light_clusters(&frame->light_clusters);
+}
+
+void shutdown_render_frame() {
+    shutdown_light_clusters(&render_frame->light_clusters);
 }
 
 u32              get_draw_call_count   () { return render_frame->draw_call_count; }
 void             inc_draw_call_count   () { render_frame->draw_call_count += 1; }
 void             reset_draw_call_count () { render_frame->draw_call_count  = 0; }
+u32              get_filtered_command_count () { return render_frame->filtered_command_count; }
+u32              get_emitted_command_count  () { return render_frame->emitted_command_count; }
+u32              get_emitted_command_bytes  () { return render_frame->emitted_command_bytes; }
+void             reset_command_counts       () { render_frame->filtered_command_count = render_frame->emitted_command_count = render_frame->emitted_command_bytes = 0; }
+u32              get_visible_entity_count  () { return render_frame->visible_entity_count; }
+u32              get_culled_entity_count   () { return render_frame->culled_entity_count; }
+u32              get_occluded_entity_count () { return render_frame->occluded_entity_count; }
+u32              get_portal_culled_entity_count () { return render_frame->portal_culled_entity_count; }
 Render_Batch    *get_opaque_batch      () { return &render_frame->opaque_batch; }
 Render_Batch    *get_transparent_batch () { return &render_frame->transparent_batch; }
 Render_Batch    *get_hud_batch         () { return &render_frame->hud_batch; }
 Handle          *get_render_frame_sync () { return &render_frame->syncs[frame_index % RENDER_FRAMES_IN_FLIGHT]; }
 u32             get_command_buffer     () { return render_frame->command_buffers[frame_index % RENDER_FRAMES_IN_FLIGHT]; }
-Gpu_Allocation *get_gpu_indirect_allocation () { return &render_frame->gpu_indirect_allocations[frame_index % RENDER_FRAMES_IN_FLIGHT]; }
-Gpu_Allocation *get_gpu_submit_allocation   () { return &render_frame->gpu_submit_allocations[frame_index % RENDER_FRAMES_IN_FLIGHT]; }
+Gpu_Upload_Ring *get_upload_ring     () { return &render_frame->upload_ring; }
+Static_Render_List *get_static_render_list () { return &render_frame->static_list; }
+Render_Graph       *get_render_graph       () { return &render_frame->graph; }
+Occlusion_Buffer   *get_occlusion_buffer   () { return &render_frame->occlusion; }
+Light_Cluster_Grid *get_light_clusters     () { return &render_frame->light_clusters; }
+Portal_Visibility  *get_portal_visibility  () { return &render_frame->portal_visibility; }
 
-void post_render_cleanup() {
-    auto indirect = get_gpu_indirect_allocation();
-    auto submit   = get_gpu_submit_allocation();
+static bool gpu_capture_requested = false;
+
+void request_gpu_capture() {
+    gpu_capture_requested = true;
+}
+
+// World bounds of entity mesh, collision aabb is gameplay shape and may not
+// cover what is actually drawn.
+static AABB get_cull_aabb(const Entity &e) {
+    // Entities without proper bounds are kept visible with huge extents,
+    // so culling stays conservative for them.
+    constexpr f32 UNBOUNDED_EXTENT = 1e18f;
+
+    const auto mesh = e.mesh ? get_mesh(e.mesh) : null;
+    if (!mesh || !mesh->cpu_positions.count) {
+        return make_aabb(e.position, Vector3(UNBOUNDED_EXTENT));
+    }
+
+    return transform_aabb(mesh->bounds, e.object_to_world);
+}
+
+// Occluders are drawn to occlusion buffer, so testing them against it would hide
+// them behind their own front faces. Indices of kept ones are moved to the front.
+static u32 cull_occlusion_except(Occlusion_Buffer *occlusion, const AABB *aabbs, u32 *indices, u32 count, const bool *keep) {
+    u32 kept_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (!keep[indices[i]]) continue;
+        
+        const u32 index = indices[i];
+        indices[i] = indices[kept_count];
+        indices[kept_count] = index;
+        kept_count += 1;
+    }
+
+    return kept_count + cull_occlusion(occlusion, aabbs, indices + kept_count, count - kept_count);
+}
+
+static AABB merge_aabb(const AABB &a, const AABB &b) {
+    const auto a0 = a.c - a.r, a1 = a.c + a.r;
+    const auto b0 = b.c - b.r, b1 = b.c + b.r;
     
-    indirect->used = 0;
-    submit->used   = 0;
+    const auto p0 = Vector3(Min(a0.x, b0.x), Min(a0.y, b0.y), Min(a0.z, b0.z));
+    const auto p1 = Vector3(Max(a1.x, b1.x), Max(a1.y, b1.y), Max(a1.z, b1.z));
     
-    ui.line_render.line_count = 0;
-    ui.quad_render.quad_count = 0;
-    ui.text_render.char_count = 0;
+    return AABB { (p0 + p1) * 0.5f, (p1 - p0) * 0.5f };
+}
+
+// Shared by render passes of one frame.
+struct Frame_Pass_Data {
+    u32 scene      = 0; // scaled color and depth target of game world
+    u32 backbuffer = 0;
+
+    Render_Target_Desc scene_desc;
+
+    Static_Render_List *static_list = null;
+    u32 *visible_static_groups      = null;
+    u32  visible_static_group_count = 0;
+};
+
+static void world_pass(Render_Graph *graph, u32 pass, void *data) {
+    auto pd                = (Frame_Pass_Data *)data;
+    auto buf               = get_command_buffer();
+    auto opaque_batch      = get_opaque_batch();
+    auto transparent_batch = get_transparent_batch();
+    auto &geo              = line_geometry;
+
+    Profile_Zone("flush_game_world");
+
+    const auto &desc = pd->scene_desc;
+    
+    gpu_cmd_framebuffer (buf, get_render_target_framebuffer(graph, pd->scene));
+    gpu_cmd_polygon     (buf, game_state.polygon_mode);
+    gpu_cmd_viewport    (buf, 0, 0, desc.width, desc.height);
+    gpu_cmd_scissor     (buf, 0, 0, desc.width, desc.height);
+    gpu_cmd_cull_face   (buf, GPU_CULL_FACE_BACK);
+    gpu_cmd_winding     (buf, GPU_WINDING_COUNTER_CLOCKWISE);
+    gpu_cmd_blend_func  (buf, GPU_BLEND_FUNCTION_SRC_ALPHA, GPU_BLEND_FUNCTION_ONE_MINUS_SRC_ALPHA);
+    gpu_cmd_depth_write (buf, true);
+    gpu_cmd_depth_func  (buf, GPU_DEPTH_FUNCTION_LESS);
+    gpu_cmd_stencil_mask(buf, 0x00);
+    gpu_cmd_stencil_func(buf, GPU_STENCIL_FUNCTION_ALWAYS, 1, 0xFF);
+    gpu_cmd_stencil_op  (buf, GPU_STENCIL_FUNCTION_KEEP, GPU_STENCIL_FUNCTION_REPLACE, GPU_STENCIL_FUNCTION_KEEP);
+    // @Temp: clear only color and depth, as no stencil buffer usage for now.
+    gpu_cmd_scissor_test(buf, false);
+    gpu_cmd_clear       (buf, COLOR4F_WHITE, GPU_CLEAR_COLOR_AND_DEPTH_BITS);
+    gpu_cmd_scissor_test(buf, true);
+    
+    gpu_cmd_cbuffer_instance(buf, &cbi_global_parameters);
+    gpu_cmd_cbuffer_instance(buf, &cbi_level_parameters);
+    
+    gpu_cmd_blend_test(buf, false);
+    draw_static_render_list(pd->static_list, pd->visible_static_groups, pd->visible_static_group_count);
+    flush(opaque_batch);
+    
+    gpu_cmd_blend_test(buf, true);
+    flush(transparent_batch);
+    
+    if (geo.vertex_count > 0) {
+        Profile_Zone("flush_line_geometry");
+                
+        static auto shader = get_shader(S("geometry"));
+
+        // Positions followed by colors in one allocation.
+        const u64 positions_size = geo.vertex_count * sizeof(Vector3);
+        const u64 colors_size    = geo.vertex_count * sizeof(Color32);
+        
+        auto memory = gpu_alloc(positions_size + colors_size, 16, get_upload_ring());
+        gpu_append(&memory, geo.positions, positions_size);
+        gpu_append(&memory, geo.colors,    colors_size);
+        
+        gpu_cmd_shader       (buf, shader);
+        gpu_cmd_vertex_input (buf, geo.vertex_input);
+        gpu_cmd_vertex_buffer(buf, memory.buffer, 0, memory.offset, 12);
+        gpu_cmd_vertex_buffer(buf, memory.buffer, 1, memory.offset + positions_size, 4);
+        gpu_cmd_draw         (buf, GPU_TOPOLOGY_LINES, geo.vertex_count, 1, 0, 0);
+
+        geo.vertex_count = 0;
+    }
+}
+
+static void present_pass(Render_Graph *graph, u32 pass, void *data) {
+    auto pd        = (Frame_Pass_Data *)data;
+    auto buf       = get_command_buffer();
+    auto &viewport = screen_viewport;
+
+    static auto shader = get_shader(S("frame_buffer"));
+    static auto quad   = get_mesh(ATOM("quad"));
+
+    const auto screen_image_view = get_render_target_color_view(graph, pd->scene);
+    
+    gpu_cmd_framebuffer      (buf, get_render_target_framebuffer(graph, pd->backbuffer));
+    gpu_cmd_polygon          (buf, GPU_POLYGON_FILL);
+    gpu_cmd_viewport         (buf, viewport.x, viewport.y, viewport.width, viewport.height);
+    gpu_cmd_scissor          (buf, viewport.x, viewport.y, viewport.width, viewport.height);
+    // @Temp: clear only color and depth, as no stencil buffer usage for now.
+    gpu_cmd_scissor_test     (buf, false);
+    gpu_cmd_clear            (buf, COLOR4F_BLACK, GPU_CLEAR_COLOR_AND_DEPTH_BITS);
+    gpu_cmd_scissor_test     (buf, true);
+    gpu_cmd_depth_write      (buf, false);
+    gpu_cmd_shader           (buf, shader);
+    gpu_cmd_vertex_input     (buf, quad->vertex_input);
+
+    // @Cleanup
+    const auto vertex_input = gpu_get_vertex_input(quad->vertex_input);
+    for (u32 i = 0; i < vertex_input->binding_count; ++i) {
+        const auto &binding = vertex_input->bindings[i];
+        const auto offset = quad->vertex_offsets[i];
+        
+        gpu_cmd_vertex_buffer(buf, gpu_write_allocator.buffer, binding.index, offset, binding.stride);
+        gpu_cmd_index_buffer(buf, gpu_write_allocator.buffer);
+    }
+        
+    gpu_cmd_cbuffer_instance (buf, &cbi_frame_buffer_constants);
+    // @Cleanup: 1 because cbuffer before sampler takes 0 in shader right now,
+    // its hardcoded which is kinda bad.
+    gpu_cmd_image_view       (buf, 1, screen_image_view);
+    gpu_cmd_sampler          (buf, 1, gpu.sampler_default_color);
+    gpu_cmd_draw_indexed     (buf, GPU_TOPOLOGY_TRIANGLES, quad->index_count, 1, quad->first_index, quad->base_vertex, 0);
+
+    if (0) {
+        static auto cbi = make_constant_buffer_instance(cbi_frame_buffer_constants.constant_buffer);
+        For (cbi_frame_buffer_constants.value_table) {
+            set_constant(&cbi, it.value.constant->name, it.value.data, it.value.constant->size);
+        }
+
+        //const auto &target     = viewport.render_target;
+        //const auto &resolution = Vector2(target.width, target.height);
+
+        const auto scale = Vector3(0.51f);
+        const auto pos   = Vector3(0.0f);
+        const auto transform = make_transform(pos, {}, scale);
+        set_constant(&cbi, S("transform"),  transform);
+        //set_constant(&cbi, S("resolution"), Vector2(resolution.x * scale.x, resolution.y * scale.y));
+
+        //const auto attachment = viewport.render_target.color_attachments[1];
+        gpu_cmd_cbuffer_instance(buf, &cbi);
+        // @Cleanup: 1 because cbuffer before sampler takes 0 in shader right now,
+        // its hardcoded which is kinda bad.
+        //set_texture         (buf, 1, attachment);
+        gpu_cmd_draw_indexed        (buf, GPU_TOPOLOGY_TRIANGLES, quad->index_count, 1, quad->first_index, quad->base_vertex, 0);
+    }
+}
+
+static void hud_pass(Render_Graph *graph, u32 pass, void *data) {
+    auto pd        = (Frame_Pass_Data *)data;
+    auto buf       = get_command_buffer();
+    auto hud_batch = get_hud_batch();
+    auto &viewport = screen_viewport;
+
+    Profile_Zone("flush_hud");
+            
+    gpu_cmd_framebuffer     (buf, get_render_target_framebuffer(graph, pd->backbuffer));
+    gpu_cmd_polygon         (buf, GPU_POLYGON_FILL);
+    gpu_cmd_viewport        (buf, viewport.x, viewport.y, viewport.width, viewport.height);
+    gpu_cmd_scissor         (buf, viewport.x, viewport.y, viewport.width, viewport.height);
+    gpu_cmd_cull_face       (buf, GPU_CULL_FACE_BACK);
+    gpu_cmd_winding         (buf, GPU_WINDING_COUNTER_CLOCKWISE);
+    gpu_cmd_blend_test      (buf, true);
+    gpu_cmd_blend_func      (buf, GPU_BLEND_FUNCTION_SRC_ALPHA, GPU_BLEND_FUNCTION_ONE_MINUS_SRC_ALPHA);
+    gpu_cmd_depth_write     (buf, false);
+    gpu_cmd_cbuffer_instance(buf, &cbi_global_parameters);
+    
+    flush(hud_batch);
 }
 
 void render_one_frame() {
@@ -277,16 +959,16 @@ void render_one_frame() {
         delete_gpu_sync(*frame_sync);
         *frame_sync = {};
     }
+
+    retire_upload_frame(get_upload_ring());
+    update_gpu_heap(&gpu_mesh_heap, Kilobytes(256));
+    update_gpu_heap(&gpu_constant_heap, 0);
     
-    auto window            = get_window();
-    auto manager           = get_entity_manager();
-    auto buf               = get_command_buffer();
-    auto opaque_batch      = get_opaque_batch();
-    auto transparent_batch = get_transparent_batch();
-    auto hud_batch         = get_hud_batch();
+    auto window  = get_window();
+    auto manager = get_entity_manager();
+    auto buf     = get_command_buffer();
     
     auto &viewport = screen_viewport;
-    auto &geo      = line_geometry;
     
     {
         const auto &res    = Vector2((f32)screen_viewport.width, (f32)screen_viewport.height);
@@ -320,6 +1002,8 @@ void render_one_frame() {
         }
 
         For_Entities (manager->entities, E_POINT_LIGHT) {
+            if (point_infos.count == MAX_POINT_LIGHTS) break;
+            
             Point_Light_Info info;
             info.position              = it.position;
             info.ambient               = it.ambient_factor;
@@ -332,17 +1016,29 @@ void render_one_frame() {
             array_add(point_infos, info);
         }
         
-        set_constant_value(cv_direct_light_count, direct_infos.count);
-        set_constant_value(cv_point_light_count,  point_infos.count);
-        set_constant_value(cv_direct_lights,      direct_infos.items, direct_infos.count * sizeof(direct_infos.items[0]));
-        set_constant_value(cv_point_lights,       point_infos.items, point_infos.count * sizeof(point_infos.items[0]));
+        // Point lights are read by shaders from storage buffers per cluster, see
+        // bind_light_clusters.
+        auto clusters = get_light_clusters();
+        build_light_clusters(clusters, manager->camera, point_infos.items, point_infos.count);
+
+        const u32 cluster_counts[4] = { Light_Cluster_Grid::X_COUNT, Light_Cluster_Grid::Y_COUNT, Light_Cluster_Grid::Z_COUNT, 0 };
+        const auto cluster_depth = Vector2(clusters->near_plane, clusters->depth_scale);
+        
+        set_constant_value(cv_direct_light_count,  direct_infos.count);
+        set_constant_value(cv_direct_lights,       direct_infos.items, direct_infos.count * sizeof(direct_infos.items[0]));
+        set_constant_value(cv_light_cluster_counts, cluster_counts, sizeof(cluster_counts));
+        set_constant_value(cv_light_cluster_depth,  cluster_depth);
     }
 
+    // Game world is rendered to scaled target and then stretched to viewport.
+    Render_Target_Desc scene_desc;
+    scene_desc.width        = (u32)((f32)viewport.width  * viewport.resolution_scale);
+    scene_desc.height       = (u32)((f32)viewport.height * viewport.resolution_scale);
+    scene_desc.color_format = GPU_IMAGE_FORMAT_RGB_8;
+    scene_desc.depth_format = GPU_IMAGE_FORMAT_DEPTH_24_STENCIL_8;
+    
     {
-        const auto framebuffer = gpu_get_framebuffer(viewport.framebuffer);
-        const auto image_view  = gpu_get_image_view(framebuffer->color_attachments[0]);
-        const auto image       = gpu_get_image(image_view->image);
-        const auto &resolution = Vector2((f32)image->width, (f32)image->height);
+        const auto &resolution = Vector2((f32)scene_desc.width, (f32)scene_desc.height);
 
         set_constant_value(cv_fb_transform,                viewport.transform);
         set_constant_value(cv_resolution,                  resolution);
@@ -355,12 +1051,138 @@ void render_one_frame() {
         set_constant_value(cv_scanline_intensity,          viewport.scanline_intensity);
     }
 
+    auto static_list = get_static_render_list();
+    u32 *visible_static_groups      = null;
+    u32  visible_static_group_count = 0;
+    
     {
         Profile_Zone("render_game_world");
 
-        // @Cleanup: lazy draw everything in one loop for now.
-        For (manager->entities) {
-            render_entity(&it);
+        update_static_render_list(static_list, manager);
+        
+        auto &entities = manager->entities;
+        auto candidates = Array <u32>  { .allocator = __temporary_allocator };
+        auto aabbs      = Array <AABB> { .allocator = __temporary_allocator };
+        array_realloc(candidates, entities.count);
+        array_realloc(aabbs,      entities.count);
+        
+        for (u32 i = 0; i < entities.count; ++i) {
+            const auto &e = entities[i];
+            if (!e.mesh || !e.material) continue;
+
+            // @Todo: outline mouse picked entity as before.
+            if (e.bits & E_MOUSE_PICKED_BIT) {
+                draw_cross(e.position, 0.5f);
+            }
+
+            // Static ones are either in static render list or in its other entities.
+            if (e.type == E_STATIC_MESH) continue;
+            
+            array_add(candidates, i);
+            array_add(aabbs, get_cull_aabb(e));
+        }
+
+        For (static_list->other_entities) {
+            array_add(candidates, it);
+            array_add(aabbs, get_cull_aabb(entities[it]));
+        }
+
+        const auto frustum = make_frustum(manager->camera.view_proj);
+        auto visible_indices = New(u32, aabbs.count, __temporary_allocator);
+        const auto frustum_visible_count = cull_frustum(frustum, aabbs.items, aabbs.count, visible_indices);
+
+        const auto &group_bounds = static_list->group_bounds;
+        visible_static_groups      = New(u32, group_bounds.count, __temporary_allocator);
+        visible_static_group_count = cull_frustum(frustum, group_bounds.items, group_bounds.count, visible_static_groups);
+
+        const auto count_static_entities = [&] (u32 group_count) {
+            u32 count = 0;
+            for (u32 i = 0; i < group_count; ++i) {
+                count += static_list->groups[visible_static_groups[i]].entity_count;
+            }
+            return count;
+        };
+
+        const u32 frustum_visible_static_count = count_static_entities(visible_static_group_count);
+
+        // Rooms not seen through portals are dropped before occlusion, so they
+        // are not tested against occluder depth at all.
+        auto portal_visibility = get_portal_visibility();
+        build_portal_cells(portal_visibility, manager);
+        update_portal_visibility(portal_visibility, manager->camera);
+
+        const u32 portal_visible_count        = cull_portals(portal_visibility, aabbs.items, visible_indices, frustum_visible_count);
+        visible_static_group_count            = cull_portals(portal_visibility, group_bounds.items, visible_static_groups, visible_static_group_count);
+        const u32 portal_visible_static_count = count_static_entities(visible_static_group_count);
+
+        auto occlusion = get_occlusion_buffer();
+        begin_occlusion(occlusion, manager->camera.view_proj);
+        
+        For (entities) {
+            if (!(it.bits & E_OCCLUDER_BIT) || !it.mesh) continue;
+
+            const auto aabb = get_cull_aabb(it);
+            if (!inside(aabb, frustum)) continue;
+            if (!is_portal_visible(portal_visibility, aabb)) continue;
+            
+            const auto mesh = get_mesh(it.mesh);
+            if (!mesh) continue;
+            
+            draw_occluder(occlusion, it.object_to_world, mesh->cpu_positions.items, mesh->cpu_indices.items, mesh->cpu_indices.count);
+        }
+        
+        end_occlusion(occlusion);
+
+#if DEVELOPER
+        if (game_state.view_mode_flags & VIEW_MODE_FLAG_OCCLUSION) {
+            for (u32 i = 0; i < portal_visible_count; ++i) {
+                const auto &aabb = aabbs[visible_indices[i]];
+                if (is_occluded(occlusion, aabb)) draw_aabb(aabb, COLOR32_RED);
+            }
+
+            for (u32 i = 0; i < visible_static_group_count; ++i) {
+                const auto &aabb = group_bounds[visible_static_groups[i]];
+                if (is_occluded(occlusion, aabb)) draw_aabb(aabb, COLOR32_PURPLE);
+            }
+
+            For (entities) {
+                if (it.bits & E_OCCLUDER_BIT) draw_aabb(get_cull_aabb(it), COLOR32_YELLOW);
+            }
+
+            // Cells seen through portals are green, others are white.
+            For (portal_visibility->cells) {
+                const bool visible = it.rect.x0 < it.rect.x1 && it.rect.y0 < it.rect.y1;
+                draw_aabb(it.bounds, visible ? COLOR32_GREEN : COLOR32_WHITE);
+            }
+
+            For (portal_visibility->portals) {
+                draw_aabb(it.bounds, COLOR32_CYAN);
+            }
+        }
+#endif
+        
+        auto occluders = New(bool, aabbs.count, __temporary_allocator);
+        for (u32 i = 0; i < aabbs.count; ++i) {
+            occluders[i] = entities[candidates[i]].bits & E_OCCLUDER_BIT;
+        }
+
+        auto group_occluders = New(bool, group_bounds.count, __temporary_allocator);
+        for (u32 i = 0; i < group_bounds.count; ++i) {
+            group_occluders[i] = static_list->groups[i].has_occluder;
+        }
+        
+        const auto visible_count = cull_occlusion_except(occlusion, aabbs.items, visible_indices, portal_visible_count, occluders);
+        visible_static_group_count = cull_occlusion_except(occlusion, group_bounds.items, visible_static_groups, visible_static_group_count, group_occluders);
+
+        const u32 visible_static_count = count_static_entities(visible_static_group_count);
+        
+        render_frame->visible_entity_count       = visible_count + visible_static_count;
+        render_frame->culled_entity_count        = aabbs.count - visible_count + static_list->entity_count - visible_static_count;
+        render_frame->occluded_entity_count      = portal_visible_count - visible_count + portal_visible_static_count - visible_static_count;
+        render_frame->portal_culled_entity_count = frustum_visible_count - portal_visible_count + frustum_visible_static_count - portal_visible_static_count;
+        
+        for (u32 i = 0; i < visible_count; ++i) {
+            render_entity(&entities[candidates[visible_indices[i]]]);
         }
 
 #if DEVELOPER
@@ -385,6 +1207,7 @@ void render_one_frame() {
                 COLOR32_WHITE,
                 COLOR32_BLUE,
                 COLOR32_PURPLE,
+                COLOR32_GREEN,
             };
             
             For (manager->entities) {
@@ -406,140 +1229,55 @@ void render_one_frame() {
     }
 #endif
 
+    flush_ui();
+
     {
-        Profile_Zone("flush_game_world");
+        Profile_Zone("render_graph");
 
-        const auto framebuffer = gpu_get_framebuffer(viewport.framebuffer);
-        const auto image_view  = gpu_get_image_view(framebuffer->color_attachments[0]);
-        const auto image       = gpu_get_image(image_view->image);
-        
-        gpu_cmd_framebuffer (buf, viewport.framebuffer);
-        gpu_cmd_polygon     (buf, game_state.polygon_mode);
-        gpu_cmd_viewport    (buf, 0, 0, image->width, image->height);
-        gpu_cmd_scissor     (buf, 0, 0, image->width, image->height);
-        gpu_cmd_cull_face   (buf, GPU_CULL_FACE_BACK);
-        gpu_cmd_winding     (buf, GPU_WINDING_COUNTER_CLOCKWISE);
-        gpu_cmd_blend_func  (buf, GPU_BLEND_FUNCTION_SRC_ALPHA, GPU_BLEND_FUNCTION_ONE_MINUS_SRC_ALPHA);
-        gpu_cmd_depth_write (buf, true);
-        gpu_cmd_depth_func  (buf, GPU_DEPTH_FUNCTION_LESS);
-        gpu_cmd_stencil_mask(buf, 0x00);
-        gpu_cmd_stencil_func(buf, GPU_STENCIL_FUNCTION_ALWAYS, 1, 0xFF);
-        gpu_cmd_stencil_op  (buf, GPU_STENCIL_FUNCTION_KEEP, GPU_STENCIL_FUNCTION_REPLACE, GPU_STENCIL_FUNCTION_KEEP);
-        // @Temp: clear only color and depth, as no stencil buffer usage for now.
-        gpu_cmd_scissor_test(buf, false);
-        gpu_cmd_clear       (buf, COLOR4F_WHITE, GPU_CLEAR_COLOR_AND_DEPTH_BITS);
-        gpu_cmd_scissor_test(buf, true);
-        
-        gpu_cmd_cbuffer_instance(buf, &cbi_global_parameters);
-        gpu_cmd_cbuffer_instance(buf, &cbi_level_parameters);
-        
-        gpu_cmd_blend_test(buf, false);
-        flush(opaque_batch);
-        
-        gpu_cmd_blend_test(buf, true);
-        flush(transparent_batch);
-    }
-    
-    if (geo.vertex_count > 0) {
-        Profile_Zone("flush_line_geometry");
-                
-        static auto shader = get_shader(S("geometry"));
-        
-        gpu_cmd_shader       (buf, shader);
-        gpu_cmd_vertex_input (buf, geo.vertex_input);
-        gpu_cmd_vertex_buffer(buf, gpu_write_allocator.buffer, 0, geo.positions_offset, 12);
-        gpu_cmd_vertex_buffer(buf, gpu_write_allocator.buffer, 1, geo.colors_offset, 4);
-        gpu_cmd_index_buffer (buf, gpu_write_allocator.buffer);
-        gpu_cmd_draw         (buf, GPU_TOPOLOGY_LINES, geo.vertex_count, 1, 0, 0);
+        Frame_Pass_Data pd;
+        pd.static_list                = static_list;
+        pd.visible_static_groups      = visible_static_groups;
+        pd.visible_static_group_count = visible_static_group_count;
+        pd.scene_desc                 = scene_desc;
 
-        geo.vertex_count = 0;
-    }
+        auto graph = get_render_graph();
+        begin_render_graph(graph);
 
-    {
-        static auto shader = get_shader(S("frame_buffer"));
-        static auto quad   = get_mesh(ATOM("quad"));
+        pd.scene      = create_render_target(graph, S("scene"), scene_desc);
+        pd.backbuffer = import_render_target(graph, S("backbuffer"), gpu.default_framebuffer);
 
-        const auto framebuffer       = gpu_get_framebuffer(viewport.framebuffer);
-        const auto screen_image_view = framebuffer->color_attachments[0];
-        
-        gpu_cmd_framebuffer      (buf, gpu.default_framebuffer);
-        gpu_cmd_polygon          (buf, GPU_POLYGON_FILL);
-        gpu_cmd_viewport         (buf, viewport.x, viewport.y, viewport.width, viewport.height);
-        gpu_cmd_scissor          (buf, viewport.x, viewport.y, viewport.width, viewport.height);
-        // @Temp: clear only color and depth, as no stencil buffer usage for now.
-        gpu_cmd_scissor_test     (buf, false);
-        gpu_cmd_clear            (buf, COLOR4F_BLACK, GPU_CLEAR_COLOR_AND_DEPTH_BITS);
-        gpu_cmd_scissor_test     (buf, true);
-        gpu_cmd_depth_write      (buf, false);
-        gpu_cmd_shader           (buf, shader);
-        gpu_cmd_vertex_input     (buf, quad->vertex_input);
-
-        // @Cleanup
-        const auto vertex_input = gpu_get_vertex_input(quad->vertex_input);
-        for (u32 i = 0; i < vertex_input->binding_count; ++i) {
-            const auto &binding = vertex_input->bindings[i];
-            const auto offset = quad->vertex_offsets[i];
-            
-            gpu_cmd_vertex_buffer(buf, gpu_write_allocator.buffer, binding.index, offset, binding.stride);
-            gpu_cmd_index_buffer(buf, gpu_write_allocator.buffer);
-        }
-            
-        gpu_cmd_cbuffer_instance (buf, &cbi_frame_buffer_constants);
-        // @Cleanup: 1 because cbuffer before sampler takes 0 in shader right now,
-        // its hardcoded which is kinda bad.
-        gpu_cmd_image_view       (buf, 1, screen_image_view);
-        gpu_cmd_sampler          (buf, 1, gpu.sampler_default_color);
-        gpu_cmd_draw_indexed     (buf, GPU_TOPOLOGY_TRIANGLES, quad->index_count, 1, quad->first_index, 0);
-
-        if (0) {
-            static auto cbi = make_constant_buffer_instance(cbi_frame_buffer_constants.constant_buffer);
-            For (cbi_frame_buffer_constants.value_table) {
-                set_constant(&cbi, it.value.constant->name, it.value.data, it.value.constant->size);
-            }
+        const auto world = add_render_pass(graph, S("world"), world_pass, &pd);
+        write_render_target(graph, world, pd.scene);
 
-            //const auto &target     = viewport.render_target;
-            //const auto &resolution = Vector2(target.width, target.height);
-
-            const auto scale = Vector3(0.51f);
-            const auto pos   = Vector3(0.0f);
-            const auto transform = make_transform(pos, {}, scale);
-            set_constant(&cbi, S("transform"),  transform);
-            //set_constant(&cbi, S("resolution"), Vector2(resolution.x * scale.x, resolution.y * scale.y));
-
-            //const auto attachment = viewport.render_target.color_attachments[1];
-            gpu_cmd_cbuffer_instance(buf, &cbi);
-            // @Cleanup: 1 because cbuffer before sampler takes 0 in shader right now,
-            // its hardcoded which is kinda bad.
-            //set_texture         (buf, 1, attachment);
-            gpu_cmd_draw_indexed        (buf, GPU_TOPOLOGY_TRIANGLES, quad->index_count, 1, quad->first_index, 0);
-        }
+        const auto present = add_render_pass(graph, S("present"), present_pass, &pd);
+        read_render_target (graph, present, pd.scene);
+        write_render_target(graph, present, pd.backbuffer);
+
+        const auto hud = add_render_pass(graph, S("hud"), hud_pass, &pd);
+        write_render_target(graph, hud, pd.backbuffer);
+
+        compile_render_graph(graph);
+        execute_render_graph(graph, buf);
     }
 
-    {
-        Profile_Zone("flush_hud");
-                
-        gpu_cmd_polygon         (buf, GPU_POLYGON_FILL);
-        gpu_cmd_viewport        (buf, viewport.x, viewport.y, viewport.width, viewport.height);
-        gpu_cmd_scissor         (buf, viewport.x, viewport.y, viewport.width, viewport.height);
-        gpu_cmd_cull_face       (buf, GPU_CULL_FACE_BACK);
-        gpu_cmd_winding         (buf, GPU_WINDING_COUNTER_CLOCKWISE);
-        gpu_cmd_blend_test      (buf, true);
-        gpu_cmd_blend_func      (buf, GPU_BLEND_FUNCTION_SRC_ALPHA, GPU_BLEND_FUNCTION_ONE_MINUS_SRC_ALPHA);
-        gpu_cmd_depth_write     (buf, false);
-        gpu_cmd_cbuffer_instance(buf, &cbi_global_parameters);
+    if (gpu_capture_requested) {
+        gpu_capture_requested = false;
         
-        flush(hud_batch);
+        const auto path = tprint("gpu_capture_%llu.gcap", frame_index);
+        if (save_gpu_capture(path, gpu_get_command_buffer(buf))) {
+            log("Saved gpu capture of frame %llu to %S", frame_index, path);
+        }
     }
-
+    
     {
         Profile_Zone("flush_command_buffer");
         gpu_flush_cmd_buffer(buf);
     }
 
     *frame_sync = gpu_fence_sync();
+    end_upload_frame(get_upload_ring());
 
     swap_buffers(window);
-    post_render_cleanup();
 }
 
 void init(Viewport &viewport, u32 width, u32 height) {
@@ -585,34 +1323,23 @@ void resize(Viewport &viewport, u32 width, u32 height) {
 
     viewport.orthographic_projection = make_orthographic(0, (f32)viewport.width, 0, (f32)viewport.height, -1, 1);
     
-    const auto internal_width  = (u32)((f32)viewport.width  * viewport.resolution_scale);
-    const auto internal_height = (u32)((f32)viewport.height * viewport.resolution_scale);
-
-    if (viewport.framebuffer) gpu_delete_framebuffer(viewport.framebuffer);
-    
-    const Gpu_Image_Format color_formats[] = { GPU_IMAGE_FORMAT_RGB_8 };
-    viewport.framebuffer = gpu_new_framebuffer(internal_width, internal_height,
-                                               color_formats, carray_count(color_formats),
-                                               GPU_IMAGE_FORMAT_DEPTH_24_STENCIL_8);
-    
     log("Resized viewport 0x%X to %dx%d", &viewport, viewport.width, viewport.height);
 }
 
-static Render_Key get_entity_render_key(Entity *e) {
-    Render_Key key;
-    key.screen_layer = SCREEN_GAME_LAYER;
-
+static Render_Key get_entity_render_key(Entity *e, bool with_depth = true) {
     const bool transparent = has_transparency(get_material(e->material));
-    if (transparent) {
-        key.translucency = NORM_TRANSLUCENT;
-    } else {
-        key.translucency = NOT_TRANSLUCENT;
-    }
-        
+    const auto translucency = transparent ? NORM_TRANSLUCENT : NOT_TRANSLUCENT;
+
+    // Material bits identify mesh and material pair, so opaque entities that can be
+    // instanced end up next to each other after sort.
+    u64 material = (e->material.hash ^ (e->mesh.hash * 0x9E3779B97F4A7C15ull)) >> 32;
+    u64 depth    = 0;
+    
     if (e->type == E_SKYBOX) {
         // Draw skybox at the very end.
-        key.depth = (1u << RENDER_KEY_DEPTH_BITS) - 1;
-    } else {
+        material = (1ull << RENDER_KEY_MATERIAL_BITS) - 1;
+        depth    = (1ull << RENDER_KEY_DEPTH_BITS)    - 1;
+    } else if (with_depth) {
         const auto manager = get_entity_manager();
         const auto &camera = manager->camera;
         const f32 dsqr = length_sqr(e->position - camera.position);
@@ -624,35 +1351,30 @@ static Render_Key get_entity_render_key(Entity *e) {
         u32 bits = *(u32 *)&norm;
         if (transparent) bits = ~bits;
         
-        key.depth = (bits >> 8);
+        depth = (bits >> (32 - RENDER_KEY_DEPTH_BITS));
     }
-    
+
+    Render_Key key;
+    key._u64 = make_render_key(SCREEN_GAME_LAYER, 0, VIEWPORT_GAME_LAYER, translucency, false, depth, material);
     return key;
 }
 
-void render_entity(Entity *e) {
-    if (!e->mesh)     return;
-    if (!e->material) return;
+static bool make_entity_primitive(Entity *e, Render_Primitive &prim) {
+    if (!e->mesh)     return false;
+    if (!e->material) return false;
 
     auto mesh = get_mesh(e->mesh);
-    if (!mesh) return;
+    if (!mesh) return false;
 
     auto material = get_material(e->material);
-    if (!material) return;
+    if (!material) return false;
     
-    auto manager = get_entity_manager();
-    auto &camera = manager->camera;
+    auto shader = get_shader(material->shader);
     
-    // @Todo: outline mouse picked entity as before.
-    auto mouse_picked = e->bits & E_MOUSE_PICKED_BIT;
-
-    auto shader     = get_shader(material->shader);
-    auto &cbi_table = material->cbi_table;
-    
-    Render_Primitive prim;
     prim.topology = GPU_TOPOLOGY_TRIANGLES;
     prim.vertex_input = mesh->vertex_input;
     prim.vertex_offsets = mesh->vertex_offsets;
+    prim.base_vertex = mesh->base_vertex;
     prim.shader = shader;
 
     if (material->diffuse_texture) {
@@ -660,24 +1382,24 @@ void render_entity(Entity *e) {
     }
 
     prim.cbis.allocator = __temporary_allocator;
-    array_realloc(prim.cbis, cbi_table.count);
+    array_realloc(prim.cbis, material->cbi_table.count);
     
-    if (auto cbi = table_find(cbi_table, S("Entity_Constants"))) {
+    if (auto cbi = get_cbi(material, cb_entity_constants)) {
         Material_Info info;
         info.ambient   = material->ambient;
         info.diffuse   = material->diffuse;
         info.specular  = material->specular;
         info.shininess = material->shininess;
             
-        set_constant(cbi, S("material"), info);
+        set_constant(cbi, ch_entity_material, info);
 
         array_add(prim.cbis, cbi);
     }
         
-    if (auto cbi = table_find(cbi_table, S("Entity_Parameters"))) {
-        set_constant(cbi, S("object_to_world"), e->object_to_world);
-        set_constant(cbi, S("uv_scale"),        e->uv_scale);
-        set_constant(cbi, S("uv_offset"),       e->uv_offset);
+    if (auto cbi = get_cbi(material, cb_entity_parameters)) {
+        set_constant(cbi, ch_entity_object_to_world, e->object_to_world);
+        set_constant(cbi, ch_entity_uv_scale,        e->uv_scale);
+        set_constant(cbi, ch_entity_uv_offset,       e->uv_offset);
 
         array_add(prim.cbis, cbi);
     }
@@ -691,17 +1413,22 @@ void render_entity(Entity *e) {
         prim.element_count = mesh->vertex_count;
     }
 
-    auto submit = get_gpu_submit_allocation();
-    prim.is_entity  = true;
-    prim.eid_offset = submit->offset + submit->used;
-    gpu_append(submit, e->eid);
+    prim.is_entity = true;
+    prim.material  = material;
+    prim.instance.object_to_world = e->object_to_world;
+    prim.instance.uv_scale        = e->uv_scale;
+    prim.instance.uv_offset       = e->uv_offset;
+    prim.instance.eid             = e->eid;
 
-    auto render_batch = has_transparency(material) ? get_transparent_batch() : get_opaque_batch();
-    add_primitive(render_batch, prim, get_entity_render_key(e));
+    return true;
+}
+
+void render_entity(Entity *e) {
+    Render_Primitive prim;
+    if (!make_entity_primitive(e, prim)) return;
     
-    if (mouse_picked) {
-        draw_cross(e->position, 0.5f);
-    }
+    auto render_batch = has_transparency(prim.material) ? get_transparent_batch() : get_opaque_batch();
+    add_primitive(render_batch, prim, get_entity_render_key(e));
     
     /*
       if (e->flags & ENTITY_FLAG_SELECTED_IN_EDITOR) {
@@ -742,18 +1469,7 @@ void render_entity(Entity *e) {
 }
 
 void init_line_geometry() {
-    auto &geo = line_geometry;
-
-    auto gpu_allocation = gpu_alloc(geo.MAX_VERTICES * sizeof(Vector3), &gpu_write_allocator);
-    const auto position_buffer_offset = gpu_allocation.offset;
-    geo.positions_offset = gpu_allocation.offset;
-    geo.positions = (Vector3 *)gpu_allocation.mapped_data;
-
-    gpu_allocation = gpu_alloc(geo.MAX_VERTICES * sizeof(u32), &gpu_write_allocator);
-    const auto color_buffer_offset = gpu_allocation.offset;
-    geo.colors_offset = gpu_allocation.offset;
-    geo.colors = (Color32 *)gpu_allocation.mapped_data;
-    
+    auto &geo = line_geometry;
     geo.vertex_count = 0;
 
     Gpu_Vertex_Binding bindings[2];
@@ -889,10 +1605,29 @@ bool operator==(const Obj_Vertex_Key& a, const Obj_Vertex_Key& b) {
     return a.pos == b.pos && a.norm == b.norm && a.uv == b.uv;
 }
 
+static void set_mesh_memory(Triangle_Mesh *mesh, const Gpu_Allocation &memory) {
+    // Vertices come first, indices right after them in the same allocation.
+    const u64 vertex_offset = memory.offset - gpu_mesh_heap.memory.offset;
+    const u64 index_offset  = memory.offset + mesh->vertex_count * sizeof(Mesh_Vertex);
+
+    mesh->gpu_memory  = memory;
+    mesh->base_vertex = (s32)(vertex_offset / sizeof(Mesh_Vertex));
+    mesh->first_index = (u32)(index_offset  / sizeof(u32));
+}
+
+static void relocate_mesh(void *owner, const Gpu_Allocation &memory) {
+    set_mesh_memory((Triangle_Mesh *)owner, memory);
+
+    // Cached indirect commands refer to old base vertex and first index.
+    invalidate_static_render_list();
+}
+
 Triangle_Mesh *new_mesh(Atom name, Buffer contents, Mesh_File_Format format) {
 #define USE_TINYOBJLOADER 1
-    
-    auto &tri_mesh = mesh_table[name];
+
+    // Meshes are stored by pointer, as gpu heap keeps it to patch moved mesh data.
+    auto found = table_find(mesh_table, name);
+    auto &tri_mesh = found ? **found : *table_add(mesh_table, name, New(Triangle_Mesh));
     
     if (format == MESH_FILE_FORMAT_OBJ) {
 #if USE_TINYOBJLOADER
@@ -924,20 +1659,21 @@ Triangle_Mesh *new_mesh(Atom name, Buffer contents, Mesh_File_Format format) {
             return &tri_mesh;
         }
 
-        tri_mesh.index_count = 0;
+        u32 index_count = 0;
         For (shapes) {
             //auto &tri_shape = array_add(tri_mesh.shapes);
             For (it.mesh.num_face_vertices) {
                 //tri_shape.vertex_count += it;
-                tri_mesh.index_count += it;
+                index_count += it;
             }
         }
 #else
         const auto obj = parse_obj_file(path, make_string(contents), __temporary_allocator);
 
+        u32 index_count = 0;
         For (obj.faces) {
             const auto face_index_count = get_obj_face_index_count(it);
-            tri_mesh.index_count += face_index_count;
+            index_count += face_index_count;
         }
 #endif
         
@@ -946,13 +1682,13 @@ Triangle_Mesh *new_mesh(Atom name, Buffer contents, Mesh_File_Format format) {
         auto uvs       = Array <Vector2> { .allocator = __temporary_allocator };
         auto indices   = Array <u32>  { .allocator = __temporary_allocator };
 
-        array_realloc(positions, tri_mesh.index_count);
-        array_realloc(normals,   tri_mesh.index_count);
-        array_realloc(uvs,       tri_mesh.index_count);
-        array_realloc(indices,   tri_mesh.index_count);
+        array_realloc(positions, index_count);
+        array_realloc(normals,   index_count);
+        array_realloc(uvs,       index_count);
+        array_realloc(indices,   index_count);
 
         auto vertex_table = Table <Obj_Vertex_Key, u32> { .allocator = __temporary_allocator };
-        table_realloc (vertex_table, tri_mesh.index_count);
+        table_realloc (vertex_table, index_count);
         table_set_hash(vertex_table, [](const Obj_Vertex_Key& k) -> u64 {
             // Simple hash combine.
             return (k.pos * 73856093) ^ (k.uv * 19349663) ^ (k.norm * 83492791);
@@ -1055,44 +1791,59 @@ Triangle_Mesh *new_mesh(Atom name, Buffer contents, Mesh_File_Format format) {
 #endif
         // Submit collected obj mesh data to gpu.
 
-        const u32 positions_size = positions.count * sizeof(positions[0]);
-        const u32 normals_size   = normals  .count * sizeof(normals  [0]);
-        const u32 uvs_size       = uvs      .count * sizeof(uvs      [0]);
+        const u32 vertices_size = positions.count * sizeof(Mesh_Vertex);
+        const u32 indices_size  = indices  .count * sizeof(indices[0]);
 
-        auto gpu_allocation = gpu_alloc(positions_size, &gpu_write_allocator);
-        const auto positions_offset = gpu_allocation.offset;
-        auto gpu_positions = gpu_allocation.mapped_data;
-        
-        gpu_allocation = gpu_alloc(normals_size, &gpu_write_allocator);
-        const auto normals_offset = gpu_allocation.offset;
-        auto gpu_normals = gpu_allocation.mapped_data;
-
-        gpu_allocation = gpu_alloc(uvs_size, &gpu_write_allocator);
-        const auto uvs_offset = gpu_allocation.offset;
-        auto gpu_uvs = gpu_allocation.mapped_data;
-
-        copy(gpu_positions, positions.items, positions_size);
-        copy(gpu_normals, normals.items, normals_size);
-        copy(gpu_uvs, uvs.items, uvs_size);
-
-        tri_mesh.vertex_input = gpu.vertex_input_entity;
-        tri_mesh.vertex_offsets    = New(u64, 4);
-        tri_mesh.vertex_offsets[0] = positions_offset;
-        tri_mesh.vertex_offsets[1] = normals_offset;
-        tri_mesh.vertex_offsets[2] = uvs_offset;
-        tri_mesh.vertex_offsets[3] = 0;
-        
-        tri_mesh.vertex_count = positions.count;
+        // Mesh vertices are placed in shared vertex stream of mesh heap, so allocation
+        // is aligned to vertex size to be addressed by base vertex. Reloaded mesh keeps
+        // its previous data if new one does not fit.
+        auto memory = gpu_alloc(vertices_size + indices_size, sizeof(Mesh_Vertex), &gpu_mesh_heap, &tri_mesh, relocate_mesh);
+        if (!memory.size) {
+            log(LOG_ERROR, "Failed to allocate gpu memory for mesh %S", get_string(name));
+            return &tri_mesh;
+        }
+
+        // Previous mesh data is released once frames in flight are done with it.
+        gpu_release(&tri_mesh.gpu_memory, &gpu_mesh_heap);
 
-        gpu_allocation = gpu_alloc(indices.count * sizeof(indices[0]), &gpu_write_allocator);
-        const auto index_offset = gpu_allocation.offset;
-        const auto indices_size = indices.count * sizeof(indices[0]);
+        auto vertices = (Mesh_Vertex *)memory.mapped_data;
+        for (u32 i = 0; i < positions.count; ++i) {
+            vertices[i].position = positions[i];
+            vertices[i].normal   = normals[i];
+            vertices[i].uv       = uvs[i];
+        }
 
-        auto gpu_indices = gpu_allocation.mapped_data;
-        copy(gpu_indices, indices.items, indices_size);
+        memory.used = vertices_size;
+        gpu_append(&memory, indices.items, indices_size);
+
+        tri_mesh.cpu_positions.count = 0;
+        tri_mesh.cpu_indices  .count = 0;
+        array_realloc(tri_mesh.cpu_positions, positions.count);
+        array_realloc(tri_mesh.cpu_indices,   indices.count);
+        copy(tri_mesh.cpu_positions.items, positions.items, positions.count * sizeof(positions[0]));
+        copy(tri_mesh.cpu_indices  .items, indices  .items, indices_size);
+        tri_mesh.cpu_positions.count = positions.count;
+        tri_mesh.cpu_indices  .count = indices.count;
+
+        if (positions.count) {
+            auto p0 = positions[0];
+            auto p1 = positions[0];
+            For (positions) {
+                p0 = Vector3(Min(p0.x, it.x), Min(p0.y, it.y), Min(p0.z, it.z));
+                p1 = Vector3(Max(p1.x, it.x), Max(p1.y, it.y), Max(p1.z, it.z));
+            }
+            tri_mesh.bounds = make_aabb((p0 + p1) * 0.5f, (p1 - p0) * 0.5f);
+        } else {
+            tri_mesh.bounds = {};
+        }
 
-        tri_mesh.index_offset = index_offset;
-        tri_mesh.first_index  = (u32)(index_offset) / sizeof(u32);
+        tri_mesh.vertex_input   = gpu.vertex_input_entity;
+        tri_mesh.vertex_offsets = mesh_vertex_offsets;
+        tri_mesh.vertex_count   = positions.count;
+        tri_mesh.index_count    = indices.count;
+        
+        set_mesh_memory(&tri_mesh, memory);
+        invalidate_static_render_list();
     } else {
         log(LOG_ERROR, "Unsupported mesh file format %d in %S", format, get_string(name));
     }
@@ -1102,7 +1853,7 @@ Triangle_Mesh *new_mesh(Atom name, Buffer contents, Mesh_File_Format format) {
 
 Triangle_Mesh *get_mesh(Atom name) {
     auto mesh = table_find(mesh_table, name);
-    if (mesh) return mesh;
+    if (mesh) return *mesh;
 
     log(LOG_ERROR, "Failed to find mesh %S", get_string(name));
     return global_meshes.missing;
@@ -1116,97 +1867,383 @@ Render_Batch make_render_batch(u32 capacity, Allocator alc) {
     return batch;
 }
 
-void flush(Render_Batch *batch) {
-    std::stable_sort(batch->entries, batch->entries + batch->count);
+void radix_sort(Render_Batch_Entry *entries, u32 count) {
+    constexpr u32 DIGIT_BITS   = 8;
+    constexpr u32 DIGIT_COUNT  = 64 / DIGIT_BITS;
+    constexpr u32 BUCKET_COUNT = 1 << DIGIT_BITS;
+    constexpr u64 DIGIT_MASK   = BUCKET_COUNT - 1;
+    
+    // Insertion sort is faster for small batches and stable as well.
+    constexpr u32 INSERTION_SORT_THRESHOLD = 32;
+
+    if (count < 2) return;
+
+    if (count <= INSERTION_SORT_THRESHOLD) {
+        for (u32 i = 1; i < count; ++i) {
+            const auto entry = entries[i];
+            
+            u32 j = i;
+            while (j > 0 && entries[j - 1].render_key._u64 > entry.render_key._u64) {
+                entries[j] = entries[j - 1];
+                j -= 1;
+            }
+            
+            entries[j] = entry;
+        }
+        
+        return;
+    }
+
+    // Gather histograms of all digits at once.
+    u32 histograms[DIGIT_COUNT][BUCKET_COUNT] = {};
+    for (u32 i = 0; i < count; ++i) {
+        const u64 key = entries[i].render_key._u64;
+        for (u32 d = 0; d < DIGIT_COUNT; ++d) {
+            histograms[d][(key >> (d * DIGIT_BITS)) & DIGIT_MASK] += 1;
+        }
+    }
+
+    auto src = entries;
+    auto dst = (Render_Batch_Entry *)alloc(count * sizeof(entries[0]), __temporary_allocator);
+    
+    for (u32 d = 0; d < DIGIT_COUNT; ++d) {
+        const u32 shift = d * DIGIT_BITS;
+        auto &histogram = histograms[d];
+
+        // Skip digit if its the same for all keys, usually upper bits like
+        // screen layer and viewport do not vary inside one batch.
+        const u64 any_digit = (src[0].render_key._u64 >> shift) & DIGIT_MASK;
+        if (histogram[any_digit] == count) continue;
+
+        u32 offset = 0;
+        for (u32 b = 0; b < BUCKET_COUNT; ++b) {
+            const u32 bucket_count = histogram[b];
+            histogram[b] = offset;
+            offset += bucket_count;
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            const auto &entry = src[i];
+            const u64 digit = (entry.render_key._u64 >> shift) & DIGIT_MASK;
+            dst[histogram[digit]] = entry;
+            histogram[digit] += 1;
+        }
+
+        const auto tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != entries) {
+        copy(entries, src, count * sizeof(entries[0]));
+    }
+}
+
+// Merged run of entities is one multi draw with an instanced draw per mesh in it,
+// shader reads per instance data at base instance of the draw plus instance id.
+static const Gpu_Resource *get_instance_resource(const Render_Primitive *prim) {
+    if (!prim->is_entity) return null;
+    return table_find(prim->shader->resource_table, S("entity_instances"));
+}
+
+// Entity shaders iterate point lights of pixel cluster, storage buffers are filled
+// once per frame by build_light_clusters.
+static void bind_light_clusters(u32 buf, const Render_Primitive *prim) {
+    if (!prim->is_entity) return;
+
+    const auto &table    = prim->shader->resource_table;
+    const auto  clusters = get_light_clusters();
+    
+    const auto bind = [&] (String name, const Gpu_Allocation &memory) {
+        if (auto resource = table_find(table, name)) {
+            gpu_cmd_storage_buffer(buf, memory.buffer, resource->binding, memory.offset, memory.used);
+        }
+    };
+
+    bind(S("point_lights"),   clusters->gpu_lights);
+    bind(S("light_clusters"), clusters->gpu_clusters);
+    bind(S("light_indices"),  clusters->gpu_indices);
+}
+
+static u32 get_merge_count(const Render_Batch_Entry *entries, u32 count) {
+    u32 merge_count = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (!can_be_merged(entries[0], entries[i])) break;
+        merge_count += 1;
+    }
     
-    auto buf             = get_command_buffer();
-    auto indirect        = get_gpu_indirect_allocation();
-    auto indirect_offset = (u32)(indirect->offset + indirect->used);
+    return merge_count;
+}
+
+// Entities of the same mesh in a row share one instanced draw, so each mesh run
+// is one draw of merged multi draw, other primitives are one draw each.
+static u32 get_instance_run_count(const Render_Batch_Entry *entries, u32 merge_count, u32 first) {
+    if (!entries[first].primitive->is_entity) return 1;
+
+    u32 count = 1;
+    while (first + count < merge_count && can_be_instanced(entries[first], entries[first + count])) {
+        count += 1;
+    }
+
+    return count;
+}
+
+static u32 get_draw_count(const Render_Batch_Entry *entries, u32 merge_count) {
+    u32 draw_count = 0;
+    for (u32 i = 0; i < merge_count; i += get_instance_run_count(entries, merge_count, i)) {
+        draw_count += 1;
+    }
+
+    return draw_count;
+}
+
+static u64 get_indirect_stride(const Render_Primitive *prim) {
+    return prim->indexed ? sizeof(Gpu_Indirect_Draw_Indexed_Command) : sizeof(Gpu_Indirect_Draw_Command);
+}
+
+// Pack instance data of the whole run, each draw addresses its mesh run in it by
+// first instance, eid vertex stream is advanced by it as well.
+static void append_instances(Gpu_Allocation *instances, const Render_Batch_Entry *entries, u32 merge_count) {
+    for (u32 i = 0; i < merge_count; ++i) {
+        gpu_append(instances, entries[i].primitive->instance);
+    }
+}
+
+static void append_indirect_commands(Gpu_Allocation *indirect, const Render_Batch_Entry *entries, u32 merge_count) {
+    u32 run_count = 0;
+    for (u32 i = 0; i < merge_count; i += run_count) {
+        const auto p = entries[i].primitive;
+        run_count = get_instance_run_count(entries, merge_count, i);
+
+        u32 instance_count = p->instance_count;
+        u32 first_instance = p->first_instance;
             
-    for (u32 i = 0; i < batch->count; ++i) {
-        const auto prim = batch->entries[i].primitive;
-        if (prim->indexed) {
-            Assert(prim->instance_count);
+        if (p->is_entity) {
+            instance_count = run_count;
+            first_instance = i;
+        }
             
+        if (p->indexed) {
             Gpu_Indirect_Draw_Indexed_Command cmd;
-            cmd.index_count    = prim->element_count;
-            cmd.instance_count = prim->instance_count;
-            cmd.first_index    = prim->first_element;
-            cmd.vertex_offset  = 0;
-            cmd.first_instance = prim->first_instance;
+            cmd.index_count    = p->element_count;
+            cmd.instance_count = instance_count;
+            cmd.first_index    = p->first_element;
+            cmd.vertex_offset  = p->base_vertex;
+            cmd.first_instance = first_instance;
 
             gpu_append(indirect, cmd);
         } else {
-            Assert(prim->instance_count);
-
             Gpu_Indirect_Draw_Command cmd;
-            cmd.vertex_count   = prim->element_count;
-            cmd.instance_count = prim->instance_count;
-            cmd.first_vertex   = prim->first_element;
-            cmd.first_instance = prim->first_instance;
+            cmd.vertex_count   = p->element_count;
+            cmd.instance_count = instance_count;
+            cmd.first_vertex   = p->first_element;
+            cmd.first_instance = first_instance;
 
             gpu_append(indirect, cmd);
         }
     }
+}
 
-    u32 merge_count = 0;
-    for (u32 i = 0; i < batch->count; i += merge_count) {
-        merge_count = 0;
-        for (u32 j = i; j < batch->count; ++j) {
-            if (!can_be_merged(batch->entries[i], batch->entries[j])) break;
-            merge_count += 1;
-        }
-        
-        auto prim = batch->entries[i].primitive;
-        
-        // @Todo: textures should be done differently - they should be referenced by
-        // passed "address" to shader and obtained from global sampler array or smth.
-        if (prim->texture) {
-            For (prim->shader->resource_table) {
-                if (it.value.type == GPU_TEXTURE_2D) {
-                    if (it.value.name == S("depth_buffer")) continue;
+// Binds state of given primitive and draws merged run from already filled instance
+// data and indirect commands.
+static void draw_merged(u32 buf, const Render_Primitive *prim, const Gpu_Allocation &instances, const Gpu_Allocation &indirect, u32 draw_count) {
+    // @Todo: textures should be done differently - they should be referenced by
+    // passed "address" to shader and obtained from global sampler array or smth.
+    if (prim->texture) {
+        For (prim->shader->resource_table) {
+            if (it.value.type == GPU_TEXTURE_2D) {
+                if (it.value.name == S("depth_buffer")) continue;
                     
-                    // @Cleanup: find first available texture slot, it will cause
-                    // bugs if shader has several texture slots.
-                    gpu_cmd_image_view(buf, it.value.binding, prim->texture->image_view);
-                    gpu_cmd_sampler   (buf, it.value.binding, prim->texture->sampler);
-                }
+                // @Cleanup: find first available texture slot, it will cause
+                // bugs if shader has several texture slots.
+                gpu_cmd_image_view(buf, it.value.binding, prim->texture->image_view);
+                gpu_cmd_sampler   (buf, it.value.binding, prim->texture->sampler);
             }
         }
+    }
 
-        gpu_cmd_shader      (buf, prim->shader);
-        gpu_cmd_vertex_input(buf, prim->vertex_input);
+    gpu_cmd_shader      (buf, prim->shader);
+    gpu_cmd_vertex_input(buf, prim->vertex_input);
                 
-        // @Cleanup
-        const auto vertex_input = gpu_get_vertex_input(prim->vertex_input);
+    // @Cleanup
+    const auto vertex_input = gpu_get_vertex_input(prim->vertex_input);
 
-        if (prim->is_entity) {
+    if (auto instance_resource = get_instance_resource(prim)) {
+        gpu_cmd_storage_buffer(buf, instances.buffer, instance_resource->binding, instances.offset, instances.used);
+    }
+
+    bind_light_clusters(buf, prim);
+        
+    for (u32 j = 0; j < vertex_input->binding_count; ++j) {
+        const auto &binding = vertex_input->bindings[j];
+        auto buffer = prim->vertex_buffer;
+        auto offset = prim->vertex_offsets[j];
+        auto stride = binding.stride;
+
+        if (buffer == U32_MAX) buffer = gpu_write_allocator.buffer;
+
+        if (prim->is_entity && j == vertex_input->binding_count - 1) {
             // If its entity, then the last binding is eid.
-            prim->vertex_offsets[vertex_input->binding_count - 1] = prim->eid_offset;
+            buffer = instances.buffer;
+            offset = instances.offset + offsetof(Entity_Instance, eid);
+            stride = sizeof(Entity_Instance);
         }
-
-        for (u32 j = 0; j < vertex_input->binding_count; ++j) {
-            const auto &binding = vertex_input->bindings[j];
-            const auto offset = prim->vertex_offsets[j];
             
-            gpu_cmd_vertex_buffer(buf, gpu_write_allocator.buffer, binding.index, offset, binding.stride);
-            gpu_cmd_index_buffer (buf, gpu_write_allocator.buffer);
+        gpu_cmd_vertex_buffer(buf, buffer, binding.index, offset, stride);
+        gpu_cmd_index_buffer (buf, gpu_write_allocator.buffer);
+    }
+        
+    For (prim->cbis) {
+        gpu_cmd_cbuffer_instance(buf, it);
+    }
+
+    if (prim->indexed) {
+        gpu_cmd_draw_indirect_indexed(buf, prim->topology, indirect.buffer, indirect.offset, draw_count, 0);
+    } else {            
+        gpu_cmd_draw_indirect(buf, prim->topology, indirect.buffer, indirect.offset, draw_count, 0);
+    };
+}
+
+void flush(Render_Batch *batch) {
+    radix_sort(batch->entries, batch->count);
+    
+    auto buf  = get_command_buffer();
+    auto ring = get_upload_ring();
+    
+    u32 merge_count = 0;
+    for (u32 i = 0; i < batch->count; i += merge_count) {
+        const auto entries = batch->entries + i;
+        const auto prim    = entries->primitive;
+        Assert(prim->instance_count);
+
+        merge_count = get_merge_count(entries, batch->count - i);
+        
+        Gpu_Allocation instances = {};
+        if (prim->is_entity) {
+            instances = gpu_alloc(merge_count * sizeof(Entity_Instance), gpu_storage_buffer_offset_alignment(), ring);
+            append_instances(&instances, entries, merge_count);
+        }
+
+        const u32 draw_count = get_draw_count(entries, merge_count);
+        auto indirect = gpu_alloc(draw_count * get_indirect_stride(prim), 4, ring);
+        append_indirect_commands(&indirect, entries, merge_count);
+
+        draw_merged(buf, prim, instances, indirect, draw_count);
+    }
+    
+    batch->count = 0;
+}
+
+void invalidate_static_render_list() {
+    if (render_frame) render_frame->static_list.dirty = true;
+}
+
+void update_static_render_list(Static_Render_List *list, Entity_Manager *manager) {
+    if (!list->dirty && list->manager == manager) return;
+
+    Profile_Zone(__func__);
+
+    // Frames in flight may still draw old groups, heap keeps their memory until
+    // those frames are retired.
+    For (list->groups) {
+        gpu_release(&it.instances, &gpu_mesh_heap);
+        gpu_release(&it.indirect,  &gpu_mesh_heap);
+        array_reset(it.primitive.cbis);
+    }
+    
+    array_clear(list->groups);
+    array_clear(list->group_bounds);
+    array_clear(list->other_entities);
+
+    list->manager        = manager;
+    list->dirty          = false;
+    list->entity_count   = 0;
+    list->rebuild_count += 1;
+    
+    auto &entities = manager->entities;
+    auto batch     = make_render_batch(entities.count, __temporary_allocator);
+    auto aabbs     = New(AABB, entities.count, __temporary_allocator); // per batch primitive
+    auto indices   = New(u32,  entities.count, __temporary_allocator); // per batch primitive
+
+    for (u32 i = 0; i < entities.count; ++i) {
+        auto &e = entities[i];
+        if (e.type != E_STATIC_MESH) continue;
+        if (e.bits & E_DELETED_BIT)  continue;
+
+        Render_Primitive prim;
+        if (!make_entity_primitive(&e, prim)) continue;
+
+        // Transparent ones need back to front order from current camera.
+        if (has_transparency(prim.material)) {
+            array_add(list->other_entities, i);
+            continue;
         }
+
+        aabbs  [batch.count] = get_cull_aabb(e);
+        indices[batch.count] = i;
+
+        // Depth is not known in advance, so order is by material only.
+        add_primitive(&batch, prim, get_entity_render_key(&e, false));
+    }
+    
+    radix_sort(batch.entries, batch.count);
+
+    u32 merge_count = 0;
+    for (u32 i = 0; i < batch.count; i += merge_count) {
+        const auto entries = batch.entries + i;
+        const auto prim    = entries->primitive;
+
+        merge_count = get_merge_count(entries, batch.count - i);
         
-        For (prim->cbis) {
-            gpu_cmd_cbuffer_instance(buf, it);
+        Static_Render_Group group;
+        group.draw_count   = get_draw_count(entries, merge_count);
+        group.entity_count = merge_count;
+        group.instances    = gpu_alloc(merge_count * sizeof(Entity_Instance), gpu_storage_buffer_offset_alignment(), &gpu_mesh_heap);
+        group.indirect     = gpu_alloc(group.draw_count * get_indirect_stride(prim), 4, &gpu_mesh_heap);
+
+        if (!group.instances.size || !group.indirect.size) {
+            // Out of persistent memory, these entities go through per frame path.
+            gpu_release(&group.instances, &gpu_mesh_heap);
+            gpu_release(&group.indirect,  &gpu_mesh_heap);
+            
+            for (u32 j = 0; j < merge_count; ++j) {
+                array_add(list->other_entities, indices[entries[j].primitive - batch.primitives]);
+            }
+            
+            continue;
+        }
+
+        append_instances        (&group.instances, entries, merge_count);
+        append_indirect_commands(&group.indirect,  entries, merge_count);
+
+        group.primitive      = *prim;
+        group.primitive.cbis = {};
+        For (prim->cbis) array_add(group.primitive.cbis, it);
+
+        auto bounds = aabbs[entries[0].primitive - batch.primitives];
+        for (u32 j = 1; j < merge_count; ++j) {
+            bounds = merge_aabb(bounds, aabbs[entries[j].primitive - batch.primitives]);
+        }
+
+        for (u32 j = 0; j < merge_count; ++j) {
+            const auto &e = entities[indices[entries[j].primitive - batch.primitives]];
+            if (e.bits & E_OCCLUDER_BIT) group.has_occluder = true;
         }
+
+        array_add(list->groups,       group);
+        array_add(list->group_bounds, bounds);
         
-        if (prim->indexed) {
-            gpu_cmd_draw_indirect_indexed(buf, prim->topology, indirect->mapped_data, indirect_offset, merge_count, 0);
-            indirect_offset += merge_count * sizeof(Gpu_Indirect_Draw_Indexed_Command);
-        } else {            
-            gpu_cmd_draw_indirect(buf, prim->topology, indirect->mapped_data, indirect_offset, merge_count, 0);
-            indirect_offset += merge_count * sizeof(Gpu_Indirect_Draw_Command);
-        };
+        list->entity_count += merge_count;
     }
+}
+
+void draw_static_render_list(Static_Render_List *list, const u32 *visible_groups, u32 visible_group_count) {
+    auto buf = get_command_buffer();
     
-    batch->count = 0;
+    for (u32 i = 0; i < visible_group_count; ++i) {
+        const auto &group = list->groups[visible_groups[i]];
+        draw_merged(buf, &group.primitive, group.instances, group.indirect, group.draw_count);
+    }
 }
 
 void add_primitive(Render_Batch *batch, const Render_Primitive &prim, Render_Key key) {
@@ -1219,12 +2256,21 @@ void add_primitive(Render_Batch *batch, const Render_Primitive &prim, Render_Key
 }
 
 bool can_be_merged(const Render_Primitive &a, const Render_Primitive &b) {
+    // Merged run is drawn with state and cbuffers of its first primitive.
+    if (a.cbis.count != b.cbis.count) return false;
+    for (u32 i = 0; i < a.cbis.count; ++i) {
+        if (a.cbis[i] != b.cbis[i]) return false;
+    }
+    
     return a.shader            == b.shader
+        && a.material          == b.material
         && a.texture           == b.texture
         && a.vertex_input      == b.vertex_input
         && a.topology          == b.topology
         && a.indexed           == b.indexed
-        // @Cleanup: this one should not be here, implement correct draw of merged primitives.
+        && a.vertex_buffer     == b.vertex_buffer
+        // Different meshes share vertex streams and differ by base vertex of each
+        // draw, other primitives have to come from the same streams.
         && a.vertex_offsets[0] == b.vertex_offsets[0];
 }
 
@@ -1232,12 +2278,115 @@ bool can_be_merged(const Render_Batch_Entry &a, const Render_Batch_Entry &b) {
     return can_be_merged(*a.primitive, *b.primitive);
 }
 
+bool can_be_instanced(const Render_Primitive &a, const Render_Primitive &b) {
+    // Meshes share vertex streams, so base vertex and index range tell whether
+    // its the same mesh.
+    return a.is_entity      && b.is_entity
+        && can_be_merged(a, b)
+        && a.vertex_offsets == b.vertex_offsets
+        && a.base_vertex    == b.base_vertex
+        && a.first_element  == b.first_element
+        && a.element_count  == b.element_count
+        && a.indexed        == b.indexed
+        && a.topology       == b.topology;
+}
+
+bool can_be_instanced(const Render_Batch_Entry &a, const Render_Batch_Entry &b) {
+    return can_be_instanced(*a.primitive, *b.primitive);
+}
+
+static bool update_buffer_range(Gpu_Command_State::Buffer_Range *ranges, u32 binding, u32 buffer, u64 offset, u64 size) {
+    if (binding >= Gpu_Command_State::MAX_BINDINGS) return true;
+
+    auto &range = ranges[binding];
+    if (range.buffer == buffer && range.offset == offset && range.size == size) return false;
+
+    range.buffer = buffer;
+    range.offset = offset;
+    range.size   = size;
+    
+    return true;
+}
+
+static bool update_bind(u32 *binds, u32 binding, u32 resource) {
+    if (binding >= Gpu_Command_State::MAX_BINDINGS) return true;
+    if (binds[binding] == resource) return false;
+
+    binds[binding] = resource;
+    return true;
+}
+
+// Update command state with given command, return false if command binds state
+// that is already bound, so it can be dropped.
+static bool update_command_state(Gpu_Command_State &state, const Gpu_Command &cmd) {
+    switch (cmd.type) {
+    case GPU_CMD_SHADER: {
+        if (state.shader._u64 == cmd.resource_handle._u64) return false;
+        state.shader = cmd.resource_handle;
+        return true;
+    }
+    case GPU_CMD_IMAGE_VIEW: {
+        return update_bind(state.image_views, cmd.bind_index, cmd.bind_resource);
+    }
+    case GPU_CMD_SAMPLER: {
+        return update_bind(state.samplers, cmd.bind_index, cmd.bind_resource);
+    }
+    case GPU_CMD_VERTEX_INPUT: {
+        if (state.vertex_input == cmd.bind_resource) return false;
+        state.vertex_input = cmd.bind_resource;
+
+        // Vertex and index buffer binds are part of vertex input state (vao in gl),
+        // so they are unknown after vertex input change.
+        set(&state.index_buffer,   0xFF, sizeof(state.index_buffer));
+        set(state.vertex_buffers,  0xFF, sizeof(state.vertex_buffers));
+        return true;
+    }
+    case GPU_CMD_VERTEX_BUFFER: {
+        return update_buffer_range(state.vertex_buffers, cmd.bind_index, cmd.bind_resource, cmd.bind_offset, cmd.bind_stride);
+    }
+    case GPU_CMD_INDEX_BUFFER: {
+        if (state.index_buffer == cmd.bind_resource) return false;
+        state.index_buffer = cmd.bind_resource;
+        return true;
+    }
+    case GPU_CMD_FRAMEBUFFER: {
+        if (state.framebuffer == cmd.bind_resource) return false;
+        state.framebuffer = cmd.bind_resource;
+        return true;
+    }
+    case GPU_CMD_CBUFFER_INSTANCE: {
+        return update_buffer_range(state.cbuffers, cmd.bind_index, cmd.bind_resource, cmd.bind_offset, cmd.bind_size);
+    }
+    case GPU_CMD_STORAGE_BUFFER: {
+        return update_buffer_range(state.storage_buffers, cmd.bind_index, cmd.bind_resource, cmd.bind_offset, cmd.bind_size);
+    }
+    }
+
+    return true;
+}
+
 void gpu_add_cmds(u32 cmd_buffer, Gpu_Command *cmds, u32 count) {    
     auto buffer = gpu_get_command_buffer(cmd_buffer);
-    Assert(buffer->count + count <= buffer->capacity);
+
+    // Backend may change its state outside of command buffer between flushes,
+    // so start from unknown state for each new batch of commands.
+    if (buffer->count == 0) {
+        set(&buffer->state, 0xFF, sizeof(buffer->state));
+    }
     
-    copy(buffer->commands + buffer->count, cmds, count * sizeof(cmds[0]));
-    buffer->count += count;
+    for (u32 i = 0; i < count; ++i) {
+        const auto &cmd = cmds[i];
+        
+        if (!update_command_state(buffer->state, cmd)) {
+            render_frame->filtered_command_count += 1;
+            continue;
+        }
+
+        const u32 size = gpu_push_cmd(buffer, cmd);
+        
+        render_frame->emitted_command_count += 1;
+        render_frame->emitted_command_bytes += size;
+    }
 }
 
 void gpu_cmd_polygon(u32 cmd_buffer, Gpu_Polygon_Mode mode) {
@@ -1456,22 +2605,36 @@ void gpu_cmd_framebuffer(u32 cmd_buffer, u32 framebuffer) {
 }
 
 void gpu_cmd_cbuffer_instance(u32 cmd_buffer, Constant_Buffer_Instance *instance) {
-    auto cbi = instance;
-    auto cb  = cbi->constant_buffer;
-
-    auto submit = get_gpu_submit_allocation();
-    // Ensure next allocation for submit data is properly 
-    // aligned with cbuffer offset requirements.
-    submit->used = Align(submit->used, (u64)gpu_uniform_buffer_offset_alignment());
-    const auto offset = submit->offset + submit->used;
-
-    For (cbi->value_table) {
-        auto data = it.value.data;
-        auto c    = it.value.constant;
+    auto cbi    = instance;
+    auto cb     = cbi->constant_buffer;
+    auto shadow = cbi->shadow;
+
+    u32 buffer = shadow->bind_buffer;
+    u64 offset = shadow->bind_offset;
+    
+    if (shadow->bind_frame != frame_index) {
+        // First bind this frame, bring persistent copy of this frame up to date.
+        // Its safe to write it, as gpu finished frame that used it last time.
+        const u32 copy_index  = frame_index % RENDER_FRAMES_IN_FLIGHT;
+        const u64 copy_offset = copy_index * shadow->size;
+        
+        auto &begin = shadow->dirty_begin[copy_index];
+        auto &end   = shadow->dirty_end  [copy_index];
+        
+        if (begin < end) {
+            auto gpu_data = (u8 *)shadow->gpu_memory.mapped_data + copy_offset;
+            copy(gpu_data + begin, shadow->data + begin, end - begin);
+            
+            begin = shadow->size;
+            end   = 0;
+        }
 
-        auto gpu_data = (u8 *)submit->mapped_data + submit->used + c->offset;
-        copy(gpu_data, data, c->size);
-                
+        buffer = shadow->gpu_memory.buffer;
+        offset = shadow->gpu_memory.offset + copy_offset;
+    } else if (shadow->changed_since_bind) {
+        // Data changed after it was bound this frame, previous draws may still read
+        // persistent copy, so whole block goes to transient submit memory. Frame
+        // copy stays dirty and will be updated on next frame first bind.
         //
         // This is an interesting discover about difference between updating gpu
         // memory through mapped pointer or by using direct gl call. The former
@@ -1486,18 +2649,54 @@ void gpu_cmd_cbuffer_instance(u32 cmd_buffer, Constant_Buffer_Instance *instance
         //
         // Turned out that the latter version (glNamedBufferSubData) was slow...
         //
-    }
+        auto submit = gpu_alloc(shadow->size, gpu_uniform_buffer_offset_alignment(), get_upload_ring());
+        gpu_append(&submit, shadow->data, shadow->size);
 
-    submit->used += cb->size;
+        buffer = submit.buffer;
+        offset = submit.offset;
+    }
 
-    const auto buffer = gpu_get_buffer(submit->buffer);
+    shadow->bind_frame  = frame_index;
+    shadow->bind_buffer = buffer;
+    shadow->bind_offset = offset;
+    shadow->changed_since_bind = false;
     
     Gpu_Command cmd;
     cmd.type          = GPU_CMD_CBUFFER_INSTANCE;
-    cmd.bind_resource = submit->buffer;
+    cmd.bind_resource = buffer;
     cmd.bind_index    = cb->binding;
     cmd.bind_offset   = offset;
-    cmd.bind_size     = cb->size;
+    cmd.bind_size     = shadow->size;
+    
+    gpu_add_cmds(cmd_buffer, &cmd, 1);
+}
+
+void gpu_cmd_storage_buffer(u32 cmd_buffer, u32 buffer, u32 binding, u64 offset, u64 size) {
+    Gpu_Command cmd;
+    cmd.type          = GPU_CMD_STORAGE_BUFFER;
+    cmd.bind_resource = buffer;
+    cmd.bind_index    = binding;
+    cmd.bind_offset   = offset;
+    cmd.bind_size     = size;
+    
+    gpu_add_cmds(cmd_buffer, &cmd, 1);
+}
+
+void gpu_cmd_memory_barrier(u32 cmd_buffer) {
+    Gpu_Command cmd;
+    cmd.type = GPU_CMD_MEMORY_BARRIER;
+    
+    gpu_add_cmds(cmd_buffer, &cmd, 1);
+}
+
+void gpu_cmd_copy_buffer(u32 cmd_buffer, u32 src, u64 src_offset, u32 dst, u64 dst_offset, u64 size) {
+    Gpu_Command cmd;
+    cmd.type            = GPU_CMD_COPY_BUFFER;
+    cmd.copy_src        = src;
+    cmd.copy_dst        = dst;
+    cmd.copy_src_offset = src_offset;
+    cmd.copy_dst_offset = dst_offset;
+    cmd.copy_size       = size;
     
     gpu_add_cmds(cmd_buffer, &cmd, 1);
 }
@@ -1514,23 +2713,24 @@ void gpu_cmd_draw(u32 cmd_buffer, Gpu_Topology_Mode topology, u32 vertex_count,
     gpu_add_cmds(cmd_buffer, &cmd, 1);
 }
 
-void gpu_cmd_draw_indexed(u32 cmd_buffer, Gpu_Topology_Mode topology, u32 index_count, u32 instance_count, u32 first_index, u32 first_instance) {
+void gpu_cmd_draw_indexed(u32 cmd_buffer, Gpu_Topology_Mode topology, u32 index_count, u32 instance_count, u32 first_index, s32 base_vertex, u32 first_instance) {
     Gpu_Command cmd;
     cmd.type           = GPU_CMD_DRAW_INDEXED;
     cmd.topology       = topology;
     cmd.draw_count     = index_count;
     cmd.instance_count = instance_count;
     cmd.first_draw     = first_index;
+    cmd.base_vertex    = base_vertex;
     cmd.first_instance = first_instance;
     
     gpu_add_cmds(cmd_buffer, &cmd, 1);
 }
 
-void gpu_cmd_draw_indirect(u32 cmd_buffer, Gpu_Topology_Mode topology, void *data, u32 offset, u32 count, u32 stride) {
+void gpu_cmd_draw_indirect(u32 cmd_buffer, Gpu_Topology_Mode topology, u32 buffer, u64 offset, u32 count, u32 stride) {
     Gpu_Command cmd;
     cmd.type            = GPU_CMD_DRAW_INDIRECT;
     cmd.topology        = topology;
-    cmd.indirect_data   = data;
+    cmd.indirect_buffer = buffer;
     cmd.indirect_offset = offset;
     cmd.indirect_count  = count;
     cmd.indirect_stride = stride;
@@ -1538,11 +2738,11 @@ void gpu_cmd_draw_indirect(u32 cmd_buffer, Gpu_Topology_Mode topology, void *dat
     gpu_add_cmds(cmd_buffer, &cmd, 1);
 }
 
-void gpu_cmd_draw_indirect_indexed(u32 cmd_buffer, Gpu_Topology_Mode topology, void *data, u32 offset, u32 count, u32 stride) {
+void gpu_cmd_draw_indirect_indexed(u32 cmd_buffer, Gpu_Topology_Mode topology, u32 buffer, u64 offset, u32 count, u32 stride) {
     Gpu_Command cmd;
     cmd.type            = GPU_CMD_DRAW_INDEXED_INDIRECT;
     cmd.topology        = topology;
-    cmd.indirect_data   = data;
+    cmd.indirect_buffer = buffer;
     cmd.indirect_offset = offset;
     cmd.indirect_count  = count;
     cmd.indirect_stride = stride;
@@ -1669,14 +2869,11 @@ void init_slang_local_session() {
     const auto cdir = (const char *)dir.data;
     
     char s_max_direct_lights[16];
-    char s_max_point_lights [16];
 
     stbsp_snprintf(s_max_direct_lights, carray_count(s_max_direct_lights), "%u", MAX_DIRECT_LIGHTS);
-    stbsp_snprintf(s_max_point_lights,  carray_count(s_max_point_lights),  "%u", MAX_POINT_LIGHTS);
     
     const slang::PreprocessorMacroDesc macros[] = {
         { "MAX_DIRECT_LIGHTS", s_max_direct_lights },
-        { "MAX_POINT_LIGHTS",  s_max_point_lights  },
     };
     
     slang::SessionDesc session_desc = {};
@@ -1992,6 +3189,11 @@ Compiled_Shader compile_shader_file(Shader_File &shader_file) {
                             array_add(compiled_shader.resources, resource);
                             break;
                         }
+                        case SLANG_STRUCTURED_BUFFER: {
+                            auto resource = make_gpu_resource(name, GPU_STRUCTURED_BUFFER, binding);
+                            array_add(compiled_shader.resources, resource);
+                            break;
+                        }
                         }
                     }
                     }
@@ -2072,8 +3274,18 @@ Constant_Buffer *new_constant_buffer(String name, u32 size, u16 binding, u16 con
     size = Align(size, gpu_uniform_buffer_offset_alignment());
     
     auto &platform = shader_platform;
+    const bool is_new = table_find(platform.constant_buffer_table, name) == null;
+    
     auto &cb = platform.constant_buffer_table[name];
 
+    if (is_new) {
+        // Slot stays the same on shader reload, so resolved slots remain valid.
+        cb.slot = (u16)(platform.constant_buffer_table.count - 1);
+        if (cb.slot >= MAX_CONSTANT_BUFFER_SLOTS) {
+            log(LOG_ERROR, "Constant buffer %S slot %u exceeds max slot count %u", name, cb.slot, MAX_CONSTANT_BUFFER_SLOTS);
+        }
+    }
+    
     cb.name    = name;
     cb.binding = binding;
     cb.size    = size;
@@ -2111,12 +3323,41 @@ Constant *add_constant(Constant_Buffer *cb, String name, Constant_Type type, u16
     c.name   = name;
     c.type   = type;
     c.count  = count;
+    c.index  = (u16)cb->constant_table.count;
     c.offset = offset;
     c.size   = size;
 
     return &table_add(cb->constant_table, name, c);
 }
 
+Constant_Handle get_constant_handle(Constant_Buffer *cb, String name) {
+    if (!cb) return {};
+    
+    auto c = table_find(cb->constant_table, name);
+    if (!c) {
+        log(LOG_ERROR, "Failed to find constant %S in constant buffer %S 0x%X", name, cb->name, cb);
+        return {};
+    }
+
+    Constant_Handle handle;
+    handle.type   = c->type;
+    handle.index  = c->index;
+    handle.offset = c->offset;
+    handle.size   = c->size;
+    
+    return handle;
+}
+
+void resolve_entity_constant_handles() {
+    cb_entity_constants  = get_constant_buffer(S("Entity_Constants"));
+    cb_entity_parameters = get_constant_buffer(S("Entity_Parameters"));
+            
+    ch_entity_material        = get_constant_handle(cb_entity_constants,  S("material"));
+    ch_entity_object_to_world = get_constant_handle(cb_entity_parameters, S("object_to_world"));
+    ch_entity_uv_scale        = get_constant_handle(cb_entity_parameters, S("uv_scale"));
+    ch_entity_uv_offset       = get_constant_handle(cb_entity_parameters, S("uv_offset"));
+}
+
 Constant_Buffer_Instance make_constant_buffer_instance(Constant_Buffer *cb) {
     auto &platform = shader_platform;
 
@@ -2126,17 +3367,55 @@ Constant_Buffer_Instance make_constant_buffer_instance(Constant_Buffer *cb) {
     
     table_clear   (cbi.value_table);
     table_realloc (cbi.value_table, cb->constant_table.count);
-        
+
+    auto shadow = cbi.shadow = New(Constant_Buffer_Shadow);
+    shadow->size = cb->size;
+    shadow->data = (u8 *)alloc(cb->size);
+    set(shadow->data, 0, cb->size);
+
+    const u64 alignment = gpu_uniform_buffer_offset_alignment();
+    shadow->gpu_memory = gpu_alloc(RENDER_FRAMES_IN_FLIGHT * cb->size, alignment, &gpu_constant_heap);
+
+    for (u32 i = 0; i < RENDER_FRAMES_IN_FLIGHT; ++i) {
+        shadow->dirty_begin[i] = 0;
+        shadow->dirty_end  [i] = cb->size;
+    }
+    
     For (cb->constant_table) {
         auto &c  = it.value;
         auto &cv = cbi.value_table[c.name];
         cv.constant = &c;
-        cv.data     = alloc(c.size);
+        cv.data     = shadow->data + c.offset;
+        cv.shadow   = shadow;
     }
 
     return cbi;
 }
 
+void release_constant_buffer_instance(Constant_Buffer_Instance *cbi) {
+    if (auto shadow = cbi->shadow) {
+        // Gpu copies may still be read by frames in flight, heap defers their reuse.
+        gpu_release(&shadow->gpu_memory, &gpu_constant_heap);
+        release(shadow->data);
+        Delete(shadow);
+    }
+
+    release(cbi->value_table.entries, cbi->value_table.allocator);
+    
+    *cbi = {};
+}
+
+static void mark_dirty(Constant_Buffer_Shadow *shadow, u32 offset, u32 size) {
+    Assert(offset + size <= shadow->size);
+    
+    for (u32 i = 0; i < RENDER_FRAMES_IN_FLIGHT; ++i) {
+        shadow->dirty_begin[i] = Min(shadow->dirty_begin[i], offset);
+        shadow->dirty_end  [i] = Max(shadow->dirty_end  [i], offset + size);
+    }
+
+    shadow->changed_since_bind = true;
+}
+
 void set_constant(Constant_Buffer_Instance *cbi, String name, const void *data, u32 size) {
     auto cb = cbi->constant_buffer;
     auto cv = table_find(cbi->value_table, name);
@@ -2149,9 +3428,26 @@ void set_constant(Constant_Buffer_Instance *cbi, String name, const void *data,
     set_constant_value(cv, data, size);
 }
 
+void set_constant(Constant_Buffer_Instance *cbi, Constant_Handle handle, const void *data, u32 size) {
+    Assert(handle.size);
+    Assert(handle.index < cbi->constant_buffer->constant_table.count);
+    Assert(size <= handle.size);
+
+    auto shadow = cbi->shadow;
+    if (handle.offset + size > shadow->size) {
+        // Instance was made for layout before shader reload, its material is not reloaded yet.
+        log(LOG_ERROR, "Constant at offset %u of size %u is out of constant buffer instance %S 0x%X", handle.offset, size, cbi->constant_buffer->name, cbi);
+        return;
+    }
+    
+    copy(shadow->data + handle.offset, data, size);
+    mark_dirty(shadow, handle.offset, size);
+}
+
 void set_constant_value(Constant_Value *cv, const void *data, u32 size) {
     Assert(size <= cv->constant->size);
     copy(cv->data, data, size);
+    mark_dirty(cv->shadow, cv->constant->offset, size);
 }
 
 // texture
@@ -2193,7 +3489,6 @@ Texture *new_texture(Atom name, Buffer file_contents) {
     auto &texture = texture_table[name];
 
     if (texture.image_view) gpu_delete_image_view(texture.image_view);
-    if (texture.sampler)    gpu_delete_sampler(texture.sampler);
 
     // @Cleanup: for now assume its just 2D image.
     const auto type   = GPU_IMAGE_TYPE_2D;
@@ -2203,7 +3498,9 @@ Texture *new_texture(Atom name, Buffer file_contents) {
     const auto image = gpu_new_image(type, format, mipmap_count, width, height, depth, data);
     texture.image_view = gpu_new_image_view(image, type, format, 0, mipmap_count, 0, depth);
 
-    texture.sampler = gpu.sampler_default_color;
+    // Samplers are shared and not owned by textures, so sampler assigned to texture
+    // (e.g. linear one of font atlas) is kept on reload.
+    if (!texture.sampler) texture.sampler = gpu.sampler_default_color;
     
     return &texture;
 }
@@ -2267,6 +3564,7 @@ Material *new_material(Atom name, String contents) {
     init_from_memory(&text, contents);
     
     auto &material = material_table[name];
+    For (material.cbi_table) release_constant_buffer_instance(&it.value);
     table_clear  (material.cbi_table);
     table_realloc(material.cbi_table, 8);
 
@@ -2346,6 +3644,12 @@ Material *new_material(Atom name, String contents) {
         }
     }
 
+    set(material.cbi_slots, 0, sizeof(material.cbi_slots));
+    For (material.cbi_table) {
+        const auto slot = it.value.constant_buffer->slot;
+        if (slot < MAX_CONSTANT_BUFFER_SLOTS) material.cbi_slots[slot] = &it.value;
+    }
+    
     return &material;
 }
 
@@ -2357,6 +3661,11 @@ Material *get_material(Atom name) {
     return global_materials.missing;
 }
 
+Constant_Buffer_Instance *get_cbi(Material *material, const Constant_Buffer *cb) {
+    if (!cb || cb->slot >= MAX_CONSTANT_BUFFER_SLOTS) return null;
+    return material->cbi_slots[cb->slot];
+}
+
 bool has_transparency(const Material *material) {
     return material->use_blending || material->base_color.w < 1.0f;
 }
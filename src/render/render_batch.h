@@ -1,10 +1,12 @@
 #pragma once
 
 #include "render_key.h"
+#include "shader_globals.h"
 
 struct Shader;
 struct Texture;
 struct Vertex_Descriptor;
+struct Material;
 struct Constant_Buffer_Instance;
 
 struct Render_Primitive {
@@ -12,6 +14,8 @@ struct Render_Primitive {
     Texture                           *texture = null;
     u32                                vertex_input = 0;
     u64                               *vertex_offsets = null; // per binding in vertex input
+    u32                                vertex_buffer  = U32_MAX; // gpu write allocator buffer if not set
+    s32                                base_vertex    = 0;    // added to indices of indexed draw
     u32                                element_count  = 0;
     u32                                instance_count = 1;
     u32                                first_element  = 0;
@@ -19,7 +23,8 @@ struct Render_Primitive {
     enum Gpu_Topology_Mode             topology;
     bool                               indexed   = false;
     bool                               is_entity = false;
-    u64                                eid_offset;
+    const Material                    *material  = null; // set for entities only
+    Entity_Instance                    instance;
     Array <Constant_Buffer_Instance *> cbis = { .allocator = __temporary_allocator };
 };
 
@@ -41,10 +46,19 @@ Render_Batch make_render_batch (u32 capacity, Allocator alc = context.allocator)
 void         flush             (Render_Batch *batch);
 void         add_primitive     (Render_Batch *batch, const Render_Primitive &prim, Render_Key key = {0});
 
-// Tells whether two given render primitives can be merged into one draw call.
+// Stable lsd radix sort of entries by render key, uses temp storage for scratch.
+void radix_sort (Render_Batch_Entry *entries, u32 count);
+
+// Tells whether two given render primitives can be merged into one multi draw,
+// they have to share state and cbuffer instances.
 bool can_be_merged (const Render_Primitive   &a, const Render_Primitive   &b);
 bool can_be_merged (const Render_Batch_Entry &a, const Render_Batch_Entry &b);
 
+// Tells whether two given entity primitives can be merged and share mesh, so they
+// are drawn as instances of one draw in merged multi draw.
+bool can_be_instanced (const Render_Primitive   &a, const Render_Primitive   &b);
+bool can_be_instanced (const Render_Batch_Entry &a, const Render_Batch_Entry &b);
+
 inline bool operator<(const Render_Batch_Entry &a, const Render_Batch_Entry &b) {
     return a.render_key._u64 < b.render_key._u64;
 }
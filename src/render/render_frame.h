@@ -2,37 +2,123 @@
 
 #include "gpu.h"
 #include "render_batch.h"
+#include "collision.h"
+#include "render_graph.h"
+#include "occlusion.h"
+#include "light_cluster.h"
+#include "portal.h"
 
 #ifndef RENDER_FRAMES_IN_FLIGHT
 #define RENDER_FRAMES_IN_FLIGHT 3
 #endif
 
+// Upload ring for transient gpu data of a frame (indirect commands, instance data,
+// cbuffer copies) in persistently mapped buffer. Each frame allocates linearly
+// after the previous one and its memory is reclaimed when fence of that frame
+// has signaled. Ring that can't fit allocation is replaced by twice bigger one,
+// old buffer is deleted when all frames that could read it are retired.
+struct Gpu_Upload_Ring {
+    struct Retired_Buffer { u32 buffer; u64 frame; };
+    
+    u32 buffer = 0;
+    u64 size   = 0;
+    u64 head   = 0; // grows monotonically, wrapped by size on access
+    u64 tail   = 0; // oldest byte gpu may still read
+    u64 frame_ends [RENDER_FRAMES_IN_FLIGHT] = {}; // head after each frame in flight
+
+    Array <Retired_Buffer> retired_buffers;
+
+    u64 frame_used      = 0; // bytes allocated by current frame, alignment included
+    u64 last_frame_used = 0;
+    u64 high_water      = 0; // max bytes allocated by one frame
+    u32 grow_count      = 0;
+};
+
+void           init                (Gpu_Upload_Ring *ring, u64 size);
+Gpu_Allocation gpu_alloc           (u64 size, u64 alignment, Gpu_Upload_Ring *ring);
+void           retire_upload_frame (Gpu_Upload_Ring *ring); // after fence of current frame slot is waited
+void           end_upload_frame    (Gpu_Upload_Ring *ring);
+
+// Opaque static entities sorted and merged into draws once, their instance data
+// and indirect commands live in persistent gpu memory, so each frame only culls
+// merged groups and records their binds and draws. List is rebuilt on the next
+// frame after it is invalidated, places that add, remove or edit static entities
+// or reload assets they use must call invalidate_static_render_list.
+struct Static_Render_Group {
+    Render_Primitive primitive; // first of merged run, its cbis are persistent copy
+    Gpu_Allocation   instances;
+    Gpu_Allocation   indirect;
+    u32              draw_count   = 0;
+    u32              entity_count = 0;
+    bool             has_occluder = false; // not tested against occlusion buffer
+};
+
+struct Static_Render_List {
+    const struct Entity_Manager *manager = null; // list was built for
+    bool dirty = true;
+    
+    Array <Static_Render_Group> groups;
+    Array <AABB>                group_bounds; // union of entity bounds of each group
+    Array <u32>                 other_entities; // static, but rendered per frame, like transparent ones
+
+    u32 entity_count  = 0;
+    u32 rebuild_count = 0;
+};
+
+void invalidate_static_render_list ();
+void update_static_render_list     (Static_Render_List *list, struct Entity_Manager *manager); // rebuilds if invalid
+void draw_static_render_list       (Static_Render_List *list, const u32 *visible_groups, u32 visible_group_count);
+
 struct Render_Frame {
-    u32 draw_call_count = 0;
+    u32 draw_call_count        = 0;
+    u32 emitted_command_count  = 0; // recorded to command buffers
+    u32 filtered_command_count = 0; // dropped as redundant binds
+    u32 emitted_command_bytes  = 0; // packed size of emitted commands
+    u32 visible_entity_count   = 0; // renderable entities that passed frustum and occlusion culling
+    u32 culled_entity_count    = 0;
+    u32 occluded_entity_count  = 0; // part of culled ones
+    u32 portal_culled_entity_count = 0; // part of culled ones, not seen through portals
 
     Render_Batch opaque_batch;
     Render_Batch transparent_batch;
     Render_Batch hud_batch;
 
-    Handle         syncs                   [RENDER_FRAMES_IN_FLIGHT];
-    u32            command_buffers         [RENDER_FRAMES_IN_FLIGHT];
-    Gpu_Allocation gpu_indirect_allocations[RENDER_FRAMES_IN_FLIGHT];
-    Gpu_Allocation gpu_submit_allocations  [RENDER_FRAMES_IN_FLIGHT];
+    Handle          syncs           [RENDER_FRAMES_IN_FLIGHT];
+    u32             command_buffers [RENDER_FRAMES_IN_FLIGHT];
+    Gpu_Upload_Ring upload_ring;
+
+    Static_Render_List static_list;
+    Render_Graph       graph;
+    Occlusion_Buffer   occlusion;
+    Light_Cluster_Grid light_clusters;
+    Portal_Visibility  portal_visibility;
 };
 
-void init_render_frame   ();
-void post_render_cleanup ();
-void render_one_frame    ();
+void init_render_frame     ();
+void shutdown_render_frame (); // stops render frame worker threads
+void render_one_frame      ();
 
 void render_entity (struct Entity *e);
 
 u32             get_draw_call_count   ();
 void            inc_draw_call_count   ();
 void            reset_draw_call_count ();
+u32             get_emitted_command_count  ();
+u32             get_filtered_command_count ();
+u32             get_emitted_command_bytes  ();
+void            reset_command_counts       ();
+u32             get_visible_entity_count  ();
+u32             get_culled_entity_count   ();
+u32             get_occluded_entity_count ();
+u32             get_portal_culled_entity_count ();
 Handle         *get_render_frame_sync ();
 Render_Batch   *get_opaque_batch      ();
 Render_Batch   *get_transparent_batch ();
 Render_Batch   *get_hud_batch         ();
 u32             get_command_buffer    ();
-Gpu_Allocation *get_gpu_indirect_allocation ();
-Gpu_Allocation *get_gpu_submit_allocation   ();
+Gpu_Upload_Ring *get_upload_ring     ();
+Static_Render_List *get_static_render_list ();
+Render_Graph       *get_render_graph       ();
+Occlusion_Buffer   *get_occlusion_buffer   ();
+Light_Cluster_Grid *get_light_clusters     ();
+Portal_Visibility  *get_portal_visibility  ();
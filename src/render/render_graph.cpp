@@ -0,0 +1,237 @@
+#include "pch.h"
+#include "render_graph.h"
+
+void begin_render_graph(Render_Graph *graph) {
+    // Pass and target arrays live in temporary storage that is reset each frame,
+    // so drop them instead of clearing.
+    graph->passes  = { .allocator = __temporary_allocator };
+    graph->targets = { .allocator = __temporary_allocator };
+    graph->order   = { .allocator = __temporary_allocator };
+
+    graph->culled_pass_count      = 0;
+    graph->barrier_count          = 0;
+    graph->transient_target_count = 0;
+}
+
+u32 add_render_pass(Render_Graph *graph, String name, Render_Pass_Proc proc, void *data) {
+    Render_Graph_Pass pass;
+    pass.name = name;
+    pass.proc = proc;
+    pass.data = data;
+
+    array_add(graph->passes, pass);
+    return graph->passes.count - 1;
+}
+
+u32 create_render_target(Render_Graph *graph, String name, const Render_Target_Desc &desc) {
+    Render_Graph_Target target;
+    target.name = name;
+    target.desc = desc;
+
+    array_add(graph->targets, target);
+    return graph->targets.count - 1;
+}
+
+u32 import_render_target(Render_Graph *graph, String name, u32 framebuffer) {
+    Render_Graph_Target target;
+    target.name        = name;
+    target.framebuffer = framebuffer;
+    target.imported    = true;
+
+    array_add(graph->targets, target);
+    return graph->targets.count - 1;
+}
+
+void read_render_target(Render_Graph *graph, u32 pass, u32 target, Render_Graph_Access access) {
+    Assert(target < graph->targets.count);
+    array_add(graph->passes[pass].reads, Render_Graph_Use { target, access });
+}
+
+void write_render_target(Render_Graph *graph, u32 pass, u32 target, Render_Graph_Access access) {
+    Assert(target < graph->targets.count);
+    array_add(graph->passes[pass].writes, Render_Graph_Use { target, access });
+}
+
+static void cull_render_passes(Render_Graph *graph) {
+    auto &passes  = graph->passes;
+    auto &targets = graph->targets;
+
+    // Walk passes backwards and keep ones that write imported targets or targets
+    // read by already kept passes, all writers of needed target are kept as there
+    // is no way to know whether later write overwrites it completely.
+    auto needed = New(bool, targets.count, __temporary_allocator);
+    set(needed, 0, targets.count * sizeof(needed[0]));
+
+    for (s32 i = (s32)passes.count - 1; i >= 0; --i) {
+        auto &pass = passes[i];
+
+        pass.culled = true;
+        For (pass.writes) {
+            if (targets[it.target].imported || needed[it.target]) {
+                pass.culled = false;
+                break;
+            }
+        }
+
+        if (pass.culled) {
+            graph->culled_pass_count += 1;
+            continue;
+        }
+
+        For (pass.reads) needed[it.target] = true;
+    }
+
+    for (u32 i = 0; i < passes.count; ++i) {
+        if (!passes[i].culled) array_add(graph->order, i);
+    }
+}
+
+static void place_render_barriers(Render_Graph *graph) {
+    auto &passes  = graph->passes;
+    auto &targets = graph->targets;
+
+    // Attachment writes and samples are ordered by api, only shader storage writes
+    // must be made visible explicitly before any following access of the same target.
+    auto storage_written = New(bool, targets.count, __temporary_allocator);
+    set(storage_written, 0, targets.count * sizeof(storage_written[0]));
+
+    For (graph->order) {
+        auto &pass = passes[it];
+
+        bool hazard = false;
+        for (const auto &use : pass.reads)  hazard |= storage_written[use.target];
+        for (const auto &use : pass.writes) hazard |= storage_written[use.target];
+
+        if (hazard) {
+            pass.barrier = true;
+            graph->barrier_count += 1;
+            set(storage_written, 0, targets.count * sizeof(storage_written[0]));
+        }
+
+        for (const auto &use : pass.writes) {
+            if (use.access == RENDER_GRAPH_ACCESS_STORAGE) storage_written[use.target] = true;
+        }
+    }
+}
+
+static void alias_render_targets(Render_Graph *graph) {
+    auto &passes    = graph->passes;
+    auto &targets   = graph->targets;
+    auto &physicals = graph->physicals;
+
+    For (targets) {
+        it.first_use = Render_Graph::NONE;
+        it.last_use  = 0;
+        it.physical  = Render_Graph::NONE;
+    }
+
+    for (u32 i = 0; i < graph->order.count; ++i) {
+        const auto &pass = passes[graph->order[i]];
+
+        auto touch = [&] (const Render_Graph_Use &use) {
+            auto &target = targets[use.target];
+            target.first_use = Min(target.first_use, i);
+            target.last_use  = Max(target.last_use,  i);
+        };
+
+        For (pass.reads)  touch(it);
+        For (pass.writes) touch(it);
+    }
+
+    For (physicals) {
+        it.used       = false;
+        it.busy_until = 0;
+    }
+
+    // Assign targets in order of their first use, so pooled framebuffer becomes
+    // available to next target right after last use of previous one.
+    for (u32 i = 0; i < graph->order.count; ++i) {
+        For (targets) {
+            if (it.imported || it.first_use != i) continue;
+
+            graph->transient_target_count += 1;
+
+            u32 best = Render_Graph::NONE;
+            for (u32 j = 0; j < physicals.count; ++j) {
+                const auto &physical = physicals[j];
+                if (!(physical.desc == it.desc)) continue;
+                if (physical.used && physical.busy_until >= it.first_use) continue;
+
+                // Prefer framebuffer that is already used this frame, so the rest
+                // of pool can be released.
+                best = j;
+                if (physical.used) break;
+            }
+
+            if (best == Render_Graph::NONE) {
+                // Recreate framebuffer not used this frame with new description,
+                // for example after resolution change.
+                for (u32 j = 0; j < physicals.count; ++j) {
+                    auto &physical = physicals[j];
+                    if (physical.used) continue;
+
+                    physical.desc  = it.desc;
+                    physical.stale = true;
+                    best = j;
+                    break;
+                }
+            }
+
+            if (best == Render_Graph::NONE) {
+                Render_Graph_Physical physical;
+                physical.desc = it.desc;
+                array_add(physicals, physical);
+                best = physicals.count - 1;
+            }
+
+            auto &physical = physicals[best];
+            physical.used       = true;
+            physical.busy_until = it.last_use;
+            it.physical         = best;
+        }
+    }
+}
+
+void compile_render_graph(Render_Graph *graph) {
+    cull_render_passes(graph);
+    place_render_barriers(graph);
+    alias_render_targets(graph);
+}
+
+void execute_render_graph(Render_Graph *graph, u32 cmd_buffer) {
+    For (graph->physicals) {
+        if (it.used && !it.stale) continue;
+
+        if (it.framebuffer) {
+            gpu_delete_framebuffer(it.framebuffer);
+            it.framebuffer = 0;
+        }
+
+        if (!it.used) continue;
+
+        const auto &desc = it.desc;
+        const u32 color_count = desc.color_format != GPU_IMAGE_FORMAT_NONE;
+        it.framebuffer = gpu_new_framebuffer(desc.width, desc.height, &desc.color_format, color_count, desc.depth_format);
+        it.stale = false;
+    }
+
+    For (graph->order) {
+        const auto &pass = graph->passes[it];
+        if (pass.barrier) gpu_cmd_memory_barrier(cmd_buffer);
+        pass.proc(graph, it, pass.data);
+    }
+}
+
+u32 get_render_target_framebuffer(const Render_Graph *graph, u32 target) {
+    const auto &t = graph->targets[target];
+    if (t.imported) return t.framebuffer;
+
+    Assert(t.physical != Render_Graph::NONE);
+    return graph->physicals[t.physical].framebuffer;
+}
+
+u32 get_render_target_color_view(const Render_Graph *graph, u32 target) {
+    const auto framebuffer = gpu_get_framebuffer(get_render_target_framebuffer(graph, target));
+    Assert(framebuffer->color_attachment_count > 0);
+    return framebuffer->color_attachments[0];
+}
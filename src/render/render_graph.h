@@ -0,0 +1,97 @@
+#pragma once
+
+#include "gpu.h"
+
+// Render graph of one frame. Passes are added in execution order and declare which
+// render targets they read and write, declaration order defines dependencies, so
+// reader depends on all writers of the same target added before it. Compile culls
+// passes which results are never read and do not write imported targets, marks
+// passes that need memory barrier before them and assigns transient targets to
+// pooled framebuffers, so targets with disjoint lifetimes share one framebuffer.
+// Compile does not touch gpu, execute creates pooled framebuffers if needed and
+// records passes to command buffer.
+
+enum Render_Graph_Access : u8 {
+    RENDER_GRAPH_ACCESS_ATTACHMENT, // rendered to as color or depth attachment
+    RENDER_GRAPH_ACCESS_SAMPLED,    // sampled in shader
+    RENDER_GRAPH_ACCESS_STORAGE,    // image load/store in shader, needs barrier
+};
+
+struct Render_Target_Desc {
+    u32              width        = 0;
+    u32              height       = 0;
+    Gpu_Image_Format color_format = GPU_IMAGE_FORMAT_NONE;
+    Gpu_Image_Format depth_format = GPU_IMAGE_FORMAT_NONE;
+};
+
+inline bool operator==(const Render_Target_Desc &a, const Render_Target_Desc &b) {
+    return a.width == b.width && a.height == b.height
+        && a.color_format == b.color_format && a.depth_format == b.depth_format;
+}
+
+struct Render_Graph;
+typedef void (*Render_Pass_Proc) (Render_Graph *graph, u32 pass, void *data);
+
+struct Render_Graph_Use {
+    u32                 target;
+    Render_Graph_Access access;
+};
+
+struct Render_Graph_Pass {
+    String           name;
+    Render_Pass_Proc proc = null;
+    void            *data = null;
+
+    Array <Render_Graph_Use> reads  = { .allocator = __temporary_allocator };
+    Array <Render_Graph_Use> writes = { .allocator = __temporary_allocator };
+
+    bool culled  = false;
+    bool barrier = false; // memory barrier is recorded before pass
+};
+
+struct Render_Graph_Target {
+    String             name;
+    Render_Target_Desc desc;
+    u32                framebuffer = 0;     // set for imported targets
+    bool               imported    = false; // not owned by graph, like default framebuffer
+
+    u32 first_use = 0; // in executed pass order
+    u32 last_use  = 0;
+    u32 physical  = U32_MAX; // index of pooled framebuffer for transient target
+};
+
+// Framebuffer of graph pool, kept between frames and recreated if reused for target
+// with different description.
+struct Render_Graph_Physical {
+    Render_Target_Desc desc;
+    u32  framebuffer = 0;
+    u32  busy_until  = 0; // last executed pass that uses it this frame
+    bool used        = false;
+    bool stale       = true; // framebuffer does not match desc
+};
+
+struct Render_Graph {
+    static constexpr u32 NONE = U32_MAX;
+
+    Array <Render_Graph_Pass>     passes    = { .allocator = __temporary_allocator };
+    Array <Render_Graph_Target>   targets   = { .allocator = __temporary_allocator };
+    Array <u32>                   order     = { .allocator = __temporary_allocator }; // executed passes
+    Array <Render_Graph_Physical> physicals; // persistent pool
+
+    u32 culled_pass_count      = 0;
+    u32 barrier_count          = 0;
+    u32 transient_target_count = 0;
+};
+
+void begin_render_graph   (Render_Graph *graph); // clears passes and targets, pool is kept
+u32  add_render_pass      (Render_Graph *graph, String name, Render_Pass_Proc proc, void *data = null);
+u32  create_render_target (Render_Graph *graph, String name, const Render_Target_Desc &desc);
+u32  import_render_target (Render_Graph *graph, String name, u32 framebuffer);
+void read_render_target   (Render_Graph *graph, u32 pass, u32 target, Render_Graph_Access access = RENDER_GRAPH_ACCESS_SAMPLED);
+void write_render_target  (Render_Graph *graph, u32 pass, u32 target, Render_Graph_Access access = RENDER_GRAPH_ACCESS_ATTACHMENT);
+void compile_render_graph (Render_Graph *graph);
+void execute_render_graph (Render_Graph *graph, u32 cmd_buffer);
+
+// Valid during execute only, pooled framebuffers may change between frames.
+u32  get_render_target_framebuffer (const Render_Graph *graph, u32 target);
+u32  get_render_target_color_view  (const Render_Graph *graph, u32 target);
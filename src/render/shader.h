@@ -9,7 +9,7 @@ inline const auto SHADER_SOURCE_EXT = S(".sl");
 inline const auto SHADER_HEADER_EXT = S(".slh");
 inline const auto LOG_IDENT_SLANG   = S("slang");
 
-#ifdef OPEN_GL
+#if defined(OPEN_GL) || defined(NULL_GPU)
 #define SHADER_FILE_EXT S(".glsl")
 #else
 #error "Unsupported graphics api"
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "hash_table.h"
+#include "render_frame.h"
 
 // @Todo: handle more types.
 enum Constant_Type : u8 {
@@ -15,12 +16,15 @@ enum Constant_Type : u8 {
     CT_ERROR   // result of trying to get unsupported constant type from slang alternative. @See slang::ScalarType.
 };
 
+inline constexpr u32 MAX_CONSTANT_BUFFER_SLOTS = 32;
+
 struct Constant {
     static constexpr u32 type_sizes[] = { 0, 4, 4, 8, 12, 16, 64, 0, 0 };
     
     String name;
     Constant_Type type = CT_VOID;
     u16 count  = 0;
+    u16 index  = 0; // dense index in constant buffer, order of addition
     u32 offset = 0; // local offset in constant buffer
     u32 size   = 0; // count * size of type
 };
@@ -31,28 +35,60 @@ struct Constant_Buffer {
     String name;
     u32 size    = 0;
     u16 binding = 0;
+    u16 slot    = 0; // dense index across all constant buffers, kept on reload
     Table <String, Constant> constant_table;
 };
 
+// Constant resolved once after shader reflection, so per draw writes are direct
+// stores into constant buffer instance without name lookups.
+struct Constant_Handle {
+    Constant_Type type = CT_VOID;
+    u16 index  = 0;
+    u32 offset = 0;
+    u32 size   = 0; // 0 if handle is not resolved
+};
+
+// Cpu copy of cbuffer data laid out exactly like it is on gpu. Each frame in
+// flight has its own persistent gpu copy with range changed since that copy was
+// last updated, so upload is at most one copy and none for unchanged data.
+struct Constant_Buffer_Shadow {
+    u8 *data = null;
+    u32 size = 0;
+
+    Gpu_Allocation gpu_memory; // RENDER_FRAMES_IN_FLIGHT copies of size each
+    u32 dirty_begin[RENDER_FRAMES_IN_FLIGHT];
+    u32 dirty_end  [RENDER_FRAMES_IN_FLIGHT];
+
+    u64  bind_frame  = U64_MAX; // frame index of last bind
+    u32  bind_buffer = 0;
+    u64  bind_offset = 0;
+    bool changed_since_bind = true;
+};
+
 struct Constant_Value {
     Constant *constant = null;
-    void *data = null;
+    void *data = null; // points to shadow data at constant offset
+    Constant_Buffer_Shadow *shadow = null;
 };
 
 // Represents shader cbuffer and reflects its contents by storing them on cpu,
 // submission to gpu is recorded by adding cbuffer instance to Command_Buffer
-// which then uploads instance data to gpu using submit buffer.
+// which then binds up to date gpu copy of instance shadow data.
 struct Constant_Buffer_Instance {
-    Constant_Buffer *constant_buffer = null;
+    Constant_Buffer        *constant_buffer = null;
+    Constant_Buffer_Shadow *shadow = null;
     Table <String, Constant_Value> value_table;
 };
 
 Constant_Buffer *new_constant_buffer (String name, u32 size, u16 binding, u16 constant_count);
 Constant_Buffer *get_constant_buffer (String name);
 Constant        *add_constant        (Constant_Buffer *cb, String name, Constant_Type type, u16 count, u32 offset, u32 size);
+Constant_Handle  get_constant_handle (Constant_Buffer *cb, String name);
 
 Constant_Buffer_Instance make_constant_buffer_instance (Constant_Buffer *cb);
+void release_constant_buffer_instance (Constant_Buffer_Instance *cbi);
 void set_constant       (Constant_Buffer_Instance *cbi, String name, const void *data, u32 size);
+void set_constant       (Constant_Buffer_Instance *cbi, Constant_Handle handle, const void *data, u32 size);
 void set_constant_value (Constant_Value *cv, const void *data, u32 size);
 
 template <typename T>
@@ -60,6 +96,11 @@ void set_constant(Constant_Buffer_Instance *cbi, String name, const T &data) {
     set_constant(cbi, name, &data, sizeof(data));
 }
 
+template <typename T>
+void set_constant(Constant_Buffer_Instance *cbi, Constant_Handle handle, const T &data) {
+    set_constant(cbi, handle, &data, sizeof(data));
+}
+
 template <typename T>
 void set_constant_value(Constant_Value *cv, const T &data) {
     set_constant_value(cv, &data, sizeof(data));
@@ -77,10 +118,24 @@ inline Constant_Value *cv_camera_proj         = null;
 inline Constant_Value *cv_camera_view_proj    = null;
 
 inline Constant_Buffer_Instance cbi_level_parameters;
-inline Constant_Value *cv_direct_light_count = null;
-inline Constant_Value *cv_point_light_count  = null;
-inline Constant_Value *cv_direct_lights      = null;
-inline Constant_Value *cv_point_lights       = null;
+inline Constant_Value *cv_direct_light_count   = null;
+inline Constant_Value *cv_direct_lights        = null;
+inline Constant_Value *cv_light_cluster_counts = null;
+inline Constant_Value *cv_light_cluster_depth  = null;
+
+// Per entity cbuffers, instances live in materials.
+
+inline Constant_Buffer *cb_entity_constants  = null;
+inline Constant_Handle  ch_entity_material;
+
+inline Constant_Buffer *cb_entity_parameters = null;
+inline Constant_Handle  ch_entity_object_to_world;
+inline Constant_Handle  ch_entity_uv_scale;
+inline Constant_Handle  ch_entity_uv_offset;
+
+// Called after shaders are loaded and again on shader hot reload, as constant
+// layout of entity cbuffers may change.
+void resolve_entity_constant_handles();
 
 inline Constant_Buffer_Instance cbi_frame_buffer_constants;
 inline Constant_Value *cv_fb_transform                = null;
@@ -25,8 +25,12 @@ struct Point_Light_Info {
     float attenuation_constant;
     float attenuation_linear;
     float attenuation_quadratic;
+    f32   _p3[2];
 };
 
+// Point lights are read from storage buffer (std430 layout).
+static_assert(sizeof(Point_Light_Info) == 80);
+
 struct Global_Parameters {
     Vector4 viewport_resolution;
     Matrix4 viewport_ortho_matrix;
@@ -38,12 +42,12 @@ struct Global_Parameters {
 };
 
 struct Level_Parameters {
-    u32 direct_light_count;
-    u32 point_light_count;
+    u32     direct_light_count; u32 _p0[3];
+    u32     light_cluster_counts[4];
+    Vector2 light_cluster_depth; f32 _p1[2]; // near plane, slice count / log2(far / near)
 
-    // Max limits obtained from cpu constants with same name.
+    // Max limit obtained from cpu constant with same name.
     Direct_Light_Info direct_lights[MAX_DIRECT_LIGHTS];
-    Point_Light_Info  point_lights [MAX_POINT_LIGHTS];
 };
 
 struct Entity_Parameters {
@@ -51,3 +55,14 @@ struct Entity_Parameters {
     Vector2 uv_scale  = Vector2(1.0f);
     Vector3 uv_offset = Vector3(0.0f);
 };
+
+// Per instance entity data, uploaded as array for each merged run of entities and
+// read by shader at base instance plus instance id (std430 layout).
+struct Entity_Instance {
+    Matrix4 object_to_world;
+    Vector2 uv_scale  = Vector2(1.0f); f32 _p0[2];
+    Vector3 uv_offset = Vector3(0.0f);
+    u32     eid = 0;
+};
+
+static_assert(sizeof(Entity_Instance) == 96);
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "hash_table.h"
+#include "gpu.h"
+#include "collision.h"
+
+inline const auto OBJ_EXT = S("obj");
 
 enum Mesh_File_Format : u8 {
     MESH_FILE_FORMAT_NONE,
@@ -18,13 +22,33 @@ struct Triangle_Shape {
     Material *material = null;
 };
 
+// All meshes live in gpu mesh heap, that serves as one interleaved vertex stream
+// and one index stream, so each mesh is just base vertex and index range in them
+// and draws of different meshes can be merged into one multi draw.
+struct Mesh_Vertex {
+    Vector3 position;
+    Vector3 normal;
+    Vector2 uv;
+};
+
+static_assert(sizeof(Mesh_Vertex) == 32);
+
 struct Triangle_Mesh {
-    u64 *vertex_offsets; // per binding in vertex input
-    u32 vertex_input;
-    u64 index_offset;
-    u32 vertex_count;
-    u32 first_index;
-    u32 index_count;
+    Gpu_Allocation gpu_memory = {}; // vertices followed by indices in gpu mesh heap
+    
+    u64 *vertex_offsets = null; // per binding in vertex input
+    u32 vertex_input = 0;
+    s32 base_vertex  = 0;
+    u32 vertex_count = 0;
+    u32 first_index  = 0;
+    u32 index_count  = 0;
+
+    // Cpu copy of geometry for software occlusion culling, as mesh heap is write only.
+    Array <Vector3> cpu_positions;
+    Array <u32>     cpu_indices;
+
+    AABB bounds = {}; // local bounds of cpu positions, transformed per entity for culling
+    
     // @Todo: not used for now.
     Array <Triangle_Shape> shapes;
 };
@@ -33,7 +57,8 @@ struct Global_Meshes {
     Triangle_Mesh *missing = null;
 };
 
-inline Table <Atom, Triangle_Mesh> mesh_table;
+inline Table <Atom, Triangle_Mesh *> mesh_table;
+inline u64 mesh_vertex_offsets[4]; // shared by all meshes, per binding of entity vertex input
 inline Global_Meshes global_meshes;
 
 Triangle_Mesh *new_mesh (String path);
@@ -42,7 +67,7 @@ Triangle_Mesh *get_mesh (Atom name);
 
 inline Mesh_File_Format get_mesh_file_format(String path) {
     const auto ext = get_extension(path);
-    if (ext == S("obj")) return MESH_FILE_FORMAT_OBJ;
+    if (ext == OBJ_EXT) return MESH_FILE_FORMAT_OBJ;
     log(LOG_ERROR, "Failed to determine mesh file format from %S", path);
     return MESH_FILE_FORMAT_NONE;
 }
@@ -11,8 +11,11 @@
 #include "collision.h"
 #include "reflection.h"
 #include "hash_table.h"
+#include "render_frame.h"
 #include "stb_sprintf.h"
 
+#include <intrin.h>
+
 constexpr u32 MAX_UI_INPUT_BUFFER_SIZE = Kilobytes(16);
 
 static Render_Key get_ui_render_key(f32 z) {
@@ -50,60 +53,137 @@ static char *get_or_alloc_input_buffer(uiid id, u32 size) {
     return *v;
 }
 
-void init_ui() {
-    table_realloc (ui.input_table, 512);
-    table_set_hash(ui.input_table, [] (const uiid &a) { return (u64)hash_pcg(a.owner + a.item + a.index); });
-
-    ui.input_buffer.data = (u8 *)alloc(MAX_UI_INPUT_BUFFER_SIZE);
-        
-    {
-        auto &render = ui.line_render;
+// Grow by doubling and return pointer to count new items.
+template <typename T>
+static T *push_ui_items(Array <T> &array, u32 count) {
+    if (array.count + count > array.capacity) {
+        array_realloc(array, Max(2 * array.capacity, array.count + count));
+    }
 
-        auto gpu_allocation = gpu_alloc(2 * render.MAX_LINES * sizeof(Vector2), &gpu_write_allocator);
-        const auto pos_buffer_offset = gpu_allocation.offset;
-        render.positions_offset = gpu_allocation.offset;
-        render.positions = (Vector2 *)gpu_allocation.mapped_data;
+    auto items = array.items + array.count;
+    array.count += count;
+    return items;
+}
 
-        gpu_allocation = gpu_alloc(2 * render.MAX_LINES * sizeof(u32), &gpu_write_allocator);
-        const auto color_buffer_offset = gpu_allocation.offset;
-        render.colors_offset = gpu_allocation.offset;
-        render.colors = (Color32 *)gpu_allocation.mapped_data;
+static UI_Vertex_Run &get_vertex_run(UI_Context::Element_Render &render, f32 z) {
+    // Elements of the same z usually come together, so look from the last run.
+    for (u32 i = render.run_count; i > 0; --i) {
+        auto &run = render.runs[i - 1];
+        if (run.z == z) return run;
+    }
 
-        Gpu_Vertex_Binding bindings[2];
-        bindings[0].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
-        bindings[0].index      = 0;
-        bindings[0].stride     = 8;
-        bindings[1].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
-        bindings[1].index      = 1;
-        bindings[1].stride     = 4;
+    if (render.run_count == render.runs.count) array_add(render.runs, {});
+    
+    auto &run = render.runs[render.run_count];
+    run.z = z;
+    run.positions.count = 0;
+    run.colors.count    = 0;
 
-        Gpu_Vertex_Attribute attributes[2];
-        attributes[0].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V2;
-        attributes[0].index   = 0;
-        attributes[0].binding = 0;
-        attributes[0].offset  = 0;
-        attributes[1].type    = GPU_VERTEX_ATTRIBUTE_TYPE_U32;
-        attributes[1].index   = 1;
-        attributes[1].binding = 1;
-        attributes[1].offset  = 0;
+    render.run_count += 1;
+    return run;
+}
 
-        render.material = ATOM("ui_element");
-        render.vertex_input = gpu_new_vertex_input(bindings, carray_count(bindings), attributes, carray_count(attributes));
+static UI_Glyph_Run &get_glyph_run(const Font_Atlas *atlas, f32 z) {
+    auto &render = ui.text_render;
+    for (u32 i = render.run_count; i > 0; --i) {
+        auto &run = render.runs[i - 1];
+        if (run.atlas == atlas && run.z == z) return run;
     }
+
+    if (render.run_count == render.runs.count) array_add(render.runs, {});
+    
+    auto &run = render.runs[render.run_count];
+    run.atlas = atlas;
+    run.z = z;
+    run.glyphs.count = 0;
+
+    render.run_count += 1;
+    return run;
+}
+
+void invalidate_ui_text_layouts() {
+    auto &render = ui.text_render;
+    table_clear(render.layout_table);
+    render.layout_glyphs.count = 0;
+    render.layout_text.count   = 0;
+}
+
+// Lay out utf-8 text glyphs relative to text position, uv rects are in atlas pixels
+// as atlas texture may be reloaded with different size. Set dynamic if any glyph
+// comes from glyph cache, as it may be evicted later.
+static UI_Text_Layout layout_ui_text(String text, const Font_Atlas *atlas, bool *dynamic) {
+    auto &render = ui.text_render;
+    
+    UI_Text_Layout layout;
+    layout.first_glyph = render.layout_glyphs.count;
+
+    // Codepoint count is not greater than byte count.
+    auto glyphs = push_ui_items(render.layout_glyphs, (u32)text.size);
+    
+	f32 x = 0.0f;
+	f32 y = 0.0f;
+
+    *dynamic = false;
+
+    // Text recorded after flush is drawn next frame, its cached glyphs should stay
+    // until then.
+    const u64 draw_frame = ui.flush_frame == frame_index ? frame_index + 1 : frame_index;
+    
+	for (u64 i = 0; i < text.size;) {
+		const u32 c = utf8_next(text.data, text.size, &i);
+
+		if (c == C_SPACE) {
+			x += atlas->space_xadvance;
+			continue;
+		}
+
+		if (c == C_TAB) {
+			x += 4 * atlas->space_xadvance;
+			continue;
+		}
+
+		if (c == C_NEW_LINE) {
+			x = 0.0f;
+			y -= atlas->line_height;
+			continue;
+		}
+
+        bool cached = false;
+		const auto &glyph = *get_glyph(atlas, c, &cached, draw_frame);
+        *dynamic |= cached;
+
+        // Glyph metrics are in baked atlas pixels.
+        const auto gs = atlas->glyph_scale;
+		const auto cw = ((f32)glyph.x1 - glyph.x0) * gs;
+		const auto ch = ((f32)glyph.y1 - glyph.y0) * gs;
+
+        auto &instance = glyphs[layout.glyph_count];
+        instance.rect     = Vector4(x + glyph.xoff * gs, y - (ch + glyph.yoff * gs), cw, ch);
+        instance.uv_rect  = Vector4(glyph.x0, glyph.y0, glyph.x1, glyph.y1);
+        instance.color    = 0;
+        instance.charcode = c;
         
-    {
-        auto &render = ui.quad_render;
+        layout.glyph_count += 1;
+        
+		x += glyph.xadvance * gs;
+	}
 
-        auto gpu_allocation = gpu_alloc(4 * render.MAX_QUADS * sizeof(Vector2), &gpu_write_allocator);
-        const auto pos_buffer_offset = gpu_allocation.offset;
-        render.positions_offset = gpu_allocation.offset;
-        render.positions = (Vector2 *)gpu_allocation.mapped_data;
+    // Whitespace takes no glyphs.
+    render.layout_glyphs.count = layout.first_glyph + layout.glyph_count;
+    
+    return layout;
+}
 
-        gpu_allocation = gpu_alloc(4 * render.MAX_QUADS * sizeof(u32), &gpu_write_allocator);
-        const auto color_buffer_offset = gpu_allocation.offset;
-        render.colors_offset = gpu_allocation.offset;
-        render.colors = (Color32 *)gpu_allocation.mapped_data;
+void init_ui() {
+    table_realloc (ui.input_table, 512);
+    table_set_hash(ui.input_table, [] (const uiid &a) { return (u64)hash_pcg(a.owner + a.item + a.index); });
 
+    ui.input_buffer.data = (u8 *)alloc(MAX_UI_INPUT_BUFFER_SIZE);
+        
+    table_realloc (ui.text_render.layout_table, ui.text_render.MAX_LAYOUTS);
+    table_set_hash(ui.text_render.layout_table, [] (const UI_Text_Layout_Key &a) { return a.hash ^ a.size ^ (u64)a.atlas; });
+    
+    {
         Gpu_Vertex_Binding bindings[2];
         bindings[0].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
         bindings[0].index      = 0;
@@ -121,60 +201,28 @@ void init_ui() {
         attributes[1].index   = 1;
         attributes[1].binding = 1;
         attributes[1].offset  = 0;
-        
-        render.material = ATOM("ui_element");
-        render.vertex_input = gpu_new_vertex_input(bindings, carray_count(bindings), attributes, carray_count(attributes));
+
+        const auto vertex_input = gpu_new_vertex_input(bindings, carray_count(bindings), attributes, carray_count(attributes));
+
+        ui.line_render.material     = ATOM("ui_element");
+        ui.line_render.vertex_input = vertex_input;
+        ui.quad_render.material     = ATOM("ui_element");
+        ui.quad_render.vertex_input = vertex_input;
     }
 
     {
         auto &render = ui.text_render;
-        
-        constexpr f32 vertices[8] = { 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f };
-
-        auto gpu_allocation = gpu_alloc(carray_count(vertices) * sizeof(f32), &gpu_write_allocator);
-        const auto position_buffer_offset = gpu_allocation.offset;
-        render.positions_offset = gpu_allocation.offset;
-        render.positions = (f32 *)gpu_allocation.mapped_data;
-        copy(render.positions, vertices, sizeof(vertices));
-
-        gpu_allocation = gpu_alloc(render.MAX_CHARS * sizeof(Vector4), &gpu_write_allocator);
-        const auto uv_rect_buffer_offset = gpu_allocation.offset;
-        render.uv_rects_offset = gpu_allocation.offset;
-        render.uv_rects = (Vector4 *)gpu_allocation.mapped_data;
-
-        gpu_allocation = gpu_alloc(render.MAX_CHARS * sizeof(u32), &gpu_write_allocator);
-        const auto color_buffer_offset = gpu_allocation.offset;
-        render.colors_offset = gpu_allocation.offset;
-        render.colors = (Color32 *)gpu_allocation.mapped_data;
-
-        gpu_allocation = gpu_alloc(render.MAX_CHARS * sizeof(u32), &gpu_write_allocator);
-        const auto charmap_buffer_offset = gpu_allocation.offset;
-        render.charmap_offset = gpu_allocation.offset;
-        render.charmap = (u32 *)gpu_allocation.mapped_data;
-
-        gpu_allocation = gpu_alloc(render.MAX_CHARS * sizeof(Matrix4), &gpu_write_allocator);
-        const auto transform_buffer_offset = gpu_allocation.offset;
-        render.transforms_offset = gpu_allocation.offset;
-        render.transforms = (Matrix4 *)gpu_allocation.mapped_data;
-
-        Gpu_Vertex_Binding bindings[5];
+
+        // Unit quad corners are per vertex, the rest is per glyph instance.
+        Gpu_Vertex_Binding bindings[2];
         bindings[0].input_rate = GPU_VERTEX_INPUT_RATE_VERTEX;
         bindings[0].index      = 0;
-        bindings[0].stride     = 8;
+        bindings[0].stride     = sizeof(Vector2);
         bindings[1].input_rate = GPU_VERTEX_INPUT_RATE_INSTANCE;
         bindings[1].index      = 1;
-        bindings[1].stride     = 16;
-        bindings[2].input_rate = GPU_VERTEX_INPUT_RATE_INSTANCE;
-        bindings[2].index      = 2;
-        bindings[2].stride     = 4;
-        bindings[3].input_rate = GPU_VERTEX_INPUT_RATE_INSTANCE;
-        bindings[3].index      = 3;
-        bindings[3].stride     = 4;
-        bindings[4].input_rate = GPU_VERTEX_INPUT_RATE_INSTANCE;
-        bindings[4].index      = 4;
-        bindings[4].stride     = 64;
-
-        Gpu_Vertex_Attribute attributes[8];
+        bindings[1].stride     = sizeof(UI_Glyph_Instance);
+
+        Gpu_Vertex_Attribute attributes[5];
         attributes[0].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V2;
         attributes[0].index   = 0;
         attributes[0].binding = 0;
@@ -182,31 +230,19 @@ void init_ui() {
         attributes[1].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V4;
         attributes[1].index   = 1;
         attributes[1].binding = 1;
-        attributes[1].offset  = 0;
-        attributes[2].type    = GPU_VERTEX_ATTRIBUTE_TYPE_U32;
+        attributes[1].offset  = offsetof(UI_Glyph_Instance, rect);
+        attributes[2].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V4;
         attributes[2].index   = 2;
-        attributes[2].binding = 2;
-        attributes[2].offset  = 0;
+        attributes[2].binding = 1;
+        attributes[2].offset  = offsetof(UI_Glyph_Instance, uv_rect);
         attributes[3].type    = GPU_VERTEX_ATTRIBUTE_TYPE_U32;
         attributes[3].index   = 3;
-        attributes[3].binding = 3;
-        attributes[3].offset  = 0;
-        attributes[4].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V4;
+        attributes[3].binding = 1;
+        attributes[3].offset  = offsetof(UI_Glyph_Instance, color);
+        attributes[4].type    = GPU_VERTEX_ATTRIBUTE_TYPE_U32;
         attributes[4].index   = 4;
-        attributes[4].binding = 4;
-        attributes[4].offset  = 0;
-        attributes[5].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V4;
-        attributes[5].index   = 5;
-        attributes[5].binding = 4;
-        attributes[5].offset  = 16;
-        attributes[6].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V4;
-        attributes[6].index   = 6;
-        attributes[6].binding = 4;
-        attributes[6].offset  = 32;
-        attributes[7].type    = GPU_VERTEX_ATTRIBUTE_TYPE_V4;
-        attributes[7].index   = 7;
-        attributes[7].binding = 4;
-        attributes[7].offset  = 48;
+        attributes[4].binding = 1;
+        attributes[4].offset  = offsetof(UI_Glyph_Instance, charcode);
         
         render.material = ATOM("ui_text");
         render.vertex_input = gpu_new_vertex_input(bindings, carray_count(bindings), attributes, carray_count(attributes));
@@ -543,100 +579,75 @@ void ui_text(String text, Vector2 pos, Color32 color, f32 z, const Font_Atlas *a
     if (color.a == 0) return;
     
     auto &render = ui.text_render;
-    Assert(render.char_count + text.size <= render.MAX_CHARS);
+
+    UI_Text_Layout_Key key;
+    key.atlas = atlas;
+    key.hash  = hash_fnv(text);
+    key.size  = text.size;
+
+    UI_Text_Layout layout;
+    bool dynamic = false;
+
+    auto cached = table_find(render.layout_table, key);
+    if (cached) {
+        const auto cached_text = String { render.layout_text.items + cached->first_char, text.size };
+        if (cached_text == text) {
+            layout = *cached;
+            render.layout_hit_count += 1;
+        } else {
+            // Hash collision, other text keeps its layout and this one is laid
+            // out each time like dynamic one.
+            layout = layout_ui_text(text, atlas, &dynamic);
+            dynamic = true;
+            render.layout_miss_count += 1;
+        }
+    } else {
+        if (render.layout_table.count >= render.MAX_LAYOUTS
+            || render.layout_text.count + text.size > render.MAX_LAYOUT_GLYPHS) {
+            invalidate_ui_text_layouts();
+        }
+
+        layout = layout_ui_text(text, atlas, &dynamic);
+        render.layout_miss_count += 1;
+
+        // Text with cached glyphs is laid out each time, so its glyphs are kept
+        // used and are not evicted.
+        if (!dynamic) {
+            layout.first_char = render.layout_text.count;
+            copy(push_ui_items(render.layout_text, (u32)text.size), text.data, text.size);
+            table_add(render.layout_table, key, layout);
+        }
+    }
+
+    // Glyphs of not cached layout are dropped from layout glyphs after emit.
+    defer { if (dynamic) render.layout_glyphs.count = layout.first_glyph; };
+    
+    if (layout.glyph_count == 0) return;
 
     const auto image_view = gpu_get_image_view(atlas->texture->image_view);
     const auto image      = gpu_get_image(image_view->image);
-    
-    const auto material = get_material(render.material);
-    
-    Render_Primitive prim;
-    prim.topology = GPU_TOPOLOGY_TRIANGLE_STRIP;
-    prim.shader = get_shader(material->shader);
-    prim.texture = atlas->texture;
-    prim.vertex_input = render.vertex_input;
-    prim.vertex_offsets = New(u64, 5, __temporary_allocator);
-    prim.vertex_offsets[0] = render.positions_offset;
-    prim.vertex_offsets[1] = render.uv_rects_offset;
-    prim.vertex_offsets[2] = render.colors_offset;
-    prim.vertex_offsets[3] = render.charmap_offset;
-    prim.vertex_offsets[4] = render.transforms_offset;
-    prim.first_element = 0;
-    prim.element_count = 4;
-    prim.first_instance = render.char_count;
-    prim.instance_count = 0;
-
-    // array_reserve(prim.cb_instances, material->cbi_table.count);
-    // For (material->cbi_table) {
-    //     array_add_no_expand(prim.cb_instances) = it.value;
-    // }
-
-    // // @Cleanup: correct resource binding, material should have their own copies?
-    // array_reserve(prim.resources, material->shader->resources.count);
-    // For (material->shader->resources) {
-    //     array_add_no_expand(prim.resources) = &it;
-    // }
-    
-	f32 x = pos.x;
-	f32 y = pos.y;
-
-	for (u32 i = 0; i < text.size; ++i) {
-        if (render.char_count >= render.MAX_CHARS) break;
-        
-		char c = text.data[i];
 
-		if (c == C_SPACE) {
-			x += atlas->space_xadvance;
-			continue;
-		}
+    auto &run = get_glyph_run(atlas, z);
+    
+    const auto src = render.layout_glyphs.items + layout.first_glyph;
+    const auto dst = push_ui_items(run.glyphs, layout.glyph_count);
+    
+    // Each instance is 3 lanes of 4: rect is offset by text position, uv rect is
+    // scaled to texture space and color is or'ed to zero color of layout.
+    const auto offset   = _mm_setr_ps(pos.x, pos.y, 0.0f, 0.0f);
+    const auto uv_scale = _mm_setr_ps(1.0f / image->width, 1.0f / image->height, 1.0f / image->width, 1.0f / image->height);
+    const auto color_v  = _mm_setr_epi32((s32)color.hex, 0, 0, 0);
 
-		if (c == C_TAB) {
-			x += 4 * atlas->space_xadvance;
-			continue;
-		}
+    for (u32 i = 0; i < layout.glyph_count; ++i) {
+        const auto s = (const f32 *)(src + i);
+        const auto d = (f32 *)(dst + i);
 
-		if (c == C_NEW_LINE) {
-			x = pos.x;
-			y -= atlas->line_height;
-			continue;
-		}
+        _mm_storeu_ps(d + 0, _mm_add_ps(_mm_loadu_ps(s + 0), offset));
+        _mm_storeu_ps(d + 4, _mm_mul_ps(_mm_loadu_ps(s + 4), uv_scale));
+        _mm_storeu_si128((__m128i *)(d + 8), _mm_or_si128(_mm_loadu_si128((const __m128i *)(s + 8)), color_v));
+    }
 
-        if (c < atlas->start_charcode || c > atlas->end_charcode) {
-            constexpr char fallback = '?';
-            //log(LOG_VERBOSE, "Got unsupported character %d for text render, using '%c' as fallback", c, fallback);
-            c = fallback;
-        }
-        
-		const auto ci = c - atlas->start_charcode;
-		const auto &glyph = atlas->glyphs[ci];
-
-		const auto cw = (f32)glyph.x1 - glyph.x0;
-		const auto ch = (f32)glyph.y1 - glyph.y0;
-		const auto cx = x + glyph.xoff;
-		const auto cy = y - (ch + glyph.yoff);
-
-        const auto cp = Vector3(cx, cy, 0.0f);
-        const auto cs = Vector3(cw, ch, 0.0f);
-        const auto transform = translate(scale(Matrix4_identity(), cs), cp);
-
-        const auto u0 = (f32)glyph.x0 / image->width;
-        const auto v0 = (f32)glyph.y0 / image->height;
-        const auto u1 = (f32)glyph.x1 / image->width;
-        const auto v1 = (f32)glyph.y1 / image->height;
-
-        render.uv_rects[render.char_count] = Vector4(u0, v0, u1, v1);
-        render.colors[render.char_count] = color;
-        render.charmap[render.char_count] = ci;
-		render.transforms[render.char_count] = transform;
-        render.char_count += 1;
-
-        prim.instance_count += 1;
-        
-		x += glyph.xadvance;
-	}
-    
-    auto hud_batch = get_hud_batch();
-    add_primitive(hud_batch, prim, get_ui_render_key(z));
+    render.glyph_count += layout.glyph_count;
 }
 
 void ui_text_with_shadow(String text, Vector2 pos, Color32 color, Vector2 shadow_offset, Color32 shadow_color, f32 z, const Font_Atlas *atlas) {
@@ -648,72 +659,38 @@ void ui_quad(Vector2 p0, Vector2 p1, Color32 color, f32 z) {
     if (color.a == 0) return;
 
     auto &render = ui.quad_render;
-    Assert(render.quad_count < render.MAX_QUADS);
-
-    const auto material = get_material(render.material);
-        
-    Render_Primitive prim;
-    prim.topology = GPU_TOPOLOGY_TRIANGLE_STRIP;
-    prim.shader = get_shader(material->shader);
-    prim.vertex_input = render.vertex_input;
-    prim.vertex_offsets = New(u64, 2, __temporary_allocator);
-    prim.vertex_offsets[0] = render.positions_offset;
-    prim.vertex_offsets[1] = render.colors_offset;
-    prim.first_element = 4 * render.quad_count;
-    prim.element_count = 4;
-    prim.first_instance = render.quad_count;
-    prim.instance_count = 1;
-    
-    auto hud_batch = get_hud_batch();
-    add_primitive(hud_batch, prim, get_ui_render_key(z));
+    auto &run = get_vertex_run(render, z);
 
     const auto x0 = Min(p0.x, p1.x);
     const auto y0 = Min(p0.y, p1.y);
 
     const auto x1 = Max(p0.x, p1.x);
     const auto y1 = Max(p0.y, p1.y);
-    
-    auto vp = render.positions + 4 * render.quad_count;
-    auto vc = render.colors    + 4 * render.quad_count;
+
+    // Two triangles, so quads of the whole run are drawn at once.
+    auto vp = push_ui_items(run.positions, 6);
+    auto vc = push_ui_items(run.colors,    6);
 
     vp[0] = Vector2(x0, y0);
     vp[1] = Vector2(x1, y0);
     vp[2] = Vector2(x0, y1);    
-    vp[3] = Vector2(x1, y1);
+    vp[3] = Vector2(x0, y1);    
+    vp[4] = Vector2(x1, y0);
+    vp[5] = Vector2(x1, y1);
 
     // @Cleanup: thats a bit unfortunate that we can't use instanced vertex advance rate
     // for color, maybe there is a clever solution somewhere.
-    vc[0] = color;
-    vc[1] = color;
-    vc[2] = color;
-    vc[3] = color;
+    for (u32 i = 0; i < 6; ++i) vc[i] = color;
     
-    render.quad_count += 1;
+    render.vertex_count += 6;
 }
 
 void ui_line(Vector2 start, Vector2 end, Color32 color, f32 z) {
     auto &render = ui.line_render;
-    Assert(render.line_count < render.MAX_LINES);
-
-    const auto material = get_material(render.material);
-    
-    Render_Primitive prim;
-    prim.topology = GPU_TOPOLOGY_LINES;
-    prim.shader = get_shader(material->shader);
-    prim.vertex_input = render.vertex_input;
-    prim.vertex_offsets = New(u64, 2, __temporary_allocator);
-    prim.vertex_offsets[0] = render.positions_offset;
-    prim.vertex_offsets[1] = render.colors_offset;
-    prim.first_element = 2 * render.line_count;
-    prim.element_count = 2;
-    prim.first_instance = render.line_count;
-    prim.instance_count = 1;
-    
-    auto hud_batch = get_hud_batch();
-    add_primitive(hud_batch, prim, get_ui_render_key(z));
-    
-    auto vp = render.positions + 2 * render.line_count;
-    auto vc = render.colors    + 2 * render.line_count;
+    auto &run = get_vertex_run(render, z);
+
+    auto vp = push_ui_items(run.positions, 2);
+    auto vc = push_ui_items(run.colors,    2);
         
     vp[0] = start;
     vp[1] = end;
@@ -721,7 +698,7 @@ void ui_line(Vector2 start, Vector2 end, Color32 color, f32 z) {
     vc[0] = color;
     vc[1] = color;
 
-    render.line_count += 1;
+    render.vertex_count += 2;
 }
 
 void ui_world_line(Vector3 start, Vector3 end, Color32 color, f32 z) {
@@ -734,3 +711,120 @@ void ui_world_line(Vector3 start, Vector3 end, Color32 color, f32 z) {
     
     ui_line(s, e, color, z);
 }
+
+static void flush_vertex_runs(UI_Context::Element_Render &render, Gpu_Topology_Mode topology) {
+    if (render.vertex_count == 0) return;
+
+    // Positions of all runs followed by their colors in one allocation.
+    const u64 positions_size = render.vertex_count * sizeof(Vector2);
+    const u64 colors_size    = render.vertex_count * sizeof(Color32);
+    
+    auto memory = gpu_alloc(positions_size + colors_size, 16, get_upload_ring());
+
+    auto vertex_offsets = New(u64, 2, __temporary_allocator);
+    vertex_offsets[0] = memory.offset;
+    vertex_offsets[1] = memory.offset + positions_size;
+
+    const auto positions = (Vector2 *)memory.mapped_data;
+    const auto colors    = (Color32 *)((u8 *)memory.mapped_data + positions_size);
+    
+    const auto material  = get_material(render.material);
+    const auto hud_batch = get_hud_batch();
+    
+    u32 first_vertex = 0;
+    for (u32 i = 0; i < render.run_count; ++i) {
+        const auto &run = render.runs[i];
+        if (run.positions.count == 0) continue;
+        
+        copy(positions + first_vertex, run.positions.items, run.positions.count * sizeof(Vector2));
+        copy(colors    + first_vertex, run.colors.items,    run.colors.count    * sizeof(Color32));
+        
+        Render_Primitive prim;
+        prim.topology = topology;
+        prim.shader = get_shader(material->shader);
+        prim.vertex_input = render.vertex_input;
+        prim.vertex_buffer = memory.buffer;
+        prim.vertex_offsets = vertex_offsets;
+        prim.first_element = first_vertex;
+        prim.element_count = run.positions.count;
+        prim.instance_count = 1;
+        
+        add_primitive(hud_batch, prim, get_ui_render_key(run.z));
+
+        first_vertex += run.positions.count;
+    }
+
+    ui.stats.vertex_count += render.vertex_count;
+    ui.stats.run_count    += render.run_count;
+    
+    render.run_count    = 0;
+    render.vertex_count = 0;
+}
+
+static void flush_glyph_runs() {
+    auto &render = ui.text_render;
+
+    ui.stats.glyph_count       = render.glyph_count;
+    ui.stats.layout_count      = render.layout_table.count;
+    ui.stats.layout_hit_count  = render.layout_hit_count;
+    ui.stats.layout_miss_count = render.layout_miss_count;
+    
+    render.layout_hit_count  = 0;
+    render.layout_miss_count = 0;
+    
+    if (render.glyph_count == 0) return;
+
+    constexpr f32 corners[8] = { 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f };
+
+    // Unit quad corners followed by glyph instances of all runs.
+    const u64 instances_size = render.glyph_count * sizeof(UI_Glyph_Instance);
+    auto memory = gpu_alloc(sizeof(corners) + instances_size, 16, get_upload_ring());
+    gpu_append(&memory, corners, sizeof(corners));
+
+    auto vertex_offsets = New(u64, 2, __temporary_allocator);
+    vertex_offsets[0] = memory.offset;
+    vertex_offsets[1] = memory.offset + sizeof(corners);
+    
+    const auto material  = get_material(render.material);
+    const auto hud_batch = get_hud_batch();
+
+    u32 first_instance = 0;
+    for (u32 i = 0; i < render.run_count; ++i) {
+        const auto &run = render.runs[i];
+        if (run.glyphs.count == 0) continue;
+
+        gpu_append(&memory, run.glyphs.items, run.glyphs.count * sizeof(UI_Glyph_Instance));
+
+        Render_Primitive prim;
+        prim.topology = GPU_TOPOLOGY_TRIANGLE_STRIP;
+        prim.shader = get_shader(material->shader);
+        prim.texture = run.atlas->texture;
+        prim.vertex_input = render.vertex_input;
+        prim.vertex_buffer = memory.buffer;
+        prim.vertex_offsets = vertex_offsets;
+        prim.first_element = 0;
+        prim.element_count = 4;
+        prim.first_instance = first_instance;
+        prim.instance_count = run.glyphs.count;
+
+        add_primitive(hud_batch, prim, get_ui_render_key(run.z));
+
+        first_instance += run.glyphs.count;
+    }
+
+    ui.stats.run_count += render.run_count;
+
+    render.run_count   = 0;
+    render.glyph_count = 0;
+}
+
+void flush_ui() {
+    Profile_Zone(__func__);
+
+    ui.stats = {};
+    ui.flush_frame = frame_index;
+    
+    flush_vertex_runs(ui.line_render, GPU_TOPOLOGY_LINES);
+    flush_vertex_runs(ui.quad_render, GPU_TOPOLOGY_TRIANGLES);
+    flush_glyph_runs();
+}
@@ -2,6 +2,9 @@
 
 #include "font.h"
 
+// Greater z is drawn on top. Elements of equal z are drawn by kind, not in order
+// they were submitted: lines first, then quads, then text, so text is always on
+// top of quad of the same z, but quad that should cover text needs greater z.
 inline constexpr f32 UI_MAX_Z = 1000.0f;
 
 inline constexpr s32 UI_DEFAULT_FONT_ATLAS_INDEX       = 0;
@@ -72,61 +75,112 @@ struct UI_Combo_Style : UI_Style {
 
 struct Material;
 
-struct UI_Context {    
-    struct Line_Render {
-        static constexpr u16 MAX_LINES = 4096;
-    
-        Vector2  *positions;
-        Color32  *colors;
-        u64       positions_offset;
-        u64       colors_offset;
-        u32       line_count;
-        u32       vertex_input;
-        Atom      material;
-    };
+// Ui elements are not drawn one by one, lines, quads and glyphs are gathered to
+// runs of the same z (and font atlas for glyphs) and each run becomes one draw when
+// ui is flushed. All runs of a kind share one upload ring allocation, so neighbour
+// runs are merged even further by hud batch. Runs recorded after flush are drawn
+// next frame. Kinds are flushed in order of lines, quads and text and hud batch
+// sort is stable, which gives order of equal z described at UI_MAX_Z. Run and
+// layout arrays grow on demand, so they are in heap, where grow frees old items.
+
+struct UI_Vertex_Run {
+    f32             z = 0.0f;
+    Array <Vector2> positions = { .allocator = __default_allocator };
+    Array <Color32> colors    = { .allocator = __default_allocator };
+};
 
-    struct Quad_Render {
-        static constexpr u32 MAX_QUADS = 128;
-    
-        Vector2  *positions;
-        Color32  *colors;
-        u64       positions_offset;
-        u64       colors_offset;
-        u32       quad_count;
-        u32       vertex_input;
-        Atom      material;
+// Instance of glyph quad, rect is screen position and size and uv rect is in atlas
+// pixels until flush. Size is multiple of 16, so instances are copied with sse.
+struct UI_Glyph_Instance {
+    Vector4 rect;
+    Vector4 uv_rect;
+    u32     color;
+    u32     charcode;
+    u32     _p0[2];
+};
+
+static_assert(sizeof(UI_Glyph_Instance) == 48);
+
+struct UI_Glyph_Run {
+    const Font_Atlas          *atlas = null;
+    f32                        z     = 0.0f;
+    Array <UI_Glyph_Instance>  glyphs = { .allocator = __default_allocator };
+};
+
+// Text is laid out once and its glyphs relative to text position are cached by
+// atlas, text hash and size, so text drawn every frame is only offset and colored.
+// Layout keeps copy of its text, which is compared on hit against hash collision.
+struct UI_Text_Layout_Key {
+    const Font_Atlas *atlas = null;
+    u64               hash  = 0;
+    u64               size  = 0;
+};
+
+inline bool operator==(const UI_Text_Layout_Key &a, const UI_Text_Layout_Key &b) {
+    return a.atlas == b.atlas && a.hash == b.hash && a.size == b.size;
+}
+
+struct UI_Text_Layout {
+    u32 first_glyph = 0; // in layout glyphs
+    u32 glyph_count = 0;
+    u32 first_char  = 0; // in layout text, size is in key
+};
+
+struct UI_Stats {
+    u32 vertex_count      = 0; // lines and quads
+    u32 glyph_count       = 0;
+    u32 run_count         = 0; // draws before hud batch merge
+    u32 layout_count      = 0; // cached
+    u32 layout_hit_count  = 0;
+    u32 layout_miss_count = 0;
+};
+
+struct UI_Context {    
+    struct Element_Render {
+        Array <UI_Vertex_Run> runs = { .allocator = __default_allocator }; // kept between frames, first run_count are used
+        u32  run_count    = 0;
+        u32  vertex_count = 0;
+        u32  vertex_input;
+        Atom material;
     };
 
     struct Text_Render {
-        static constexpr u16 MAX_CHARS = 4096;
-
-        f32      *positions;
-        Vector4  *uv_rects;
-        Color32  *colors;
-        u32      *charmap;
-        Matrix4  *transforms;
-        u64       positions_offset;
-        u64       uv_rects_offset;
-        u64       colors_offset;
-        u64       charmap_offset;
-        u64       transforms_offset;
-        u32       char_count;
-        u32       vertex_input;
-        Atom      material;
+        // Cache is dropped as a whole when it is full, text that is still drawn
+        // is laid out again on next use. Layout glyphs are not more than text
+        // bytes, so one limit is used for both.
+        static constexpr u32 MAX_LAYOUTS       = 4096;
+        static constexpr u32 MAX_LAYOUT_GLYPHS = 64 * 1024;
+
+        Array <UI_Glyph_Run> runs = { .allocator = __default_allocator }; // kept between frames, first run_count are used
+        u32  run_count   = 0;
+        u32  glyph_count = 0;
+
+        Table <UI_Text_Layout_Key, UI_Text_Layout> layout_table;
+        Array <UI_Glyph_Instance>                  layout_glyphs = { .allocator = __default_allocator }; // color is not set
+        Array <u8>                                 layout_text   = { .allocator = __default_allocator }; // of cached layouts
+
+        u32  layout_hit_count  = 0;
+        u32  layout_miss_count = 0;
+        u32  vertex_input;
+        Atom material;
     };
     
     uiid                 id_hot;
     uiid                 id_active;
     Table <uiid, char *> input_table;
     String               input_buffer;
-    Line_Render          line_render;
+    Element_Render       line_render;
+    Element_Render       quad_render;
     Text_Render          text_render;
-    Quad_Render          quad_render;
+    UI_Stats             stats; // of last flush
+    u64                  flush_frame = 0;
 };
 
 inline UI_Context ui;
 
 void init_ui             ();
+void flush_ui            (); // upload runs and add them to hud batch
+void invalidate_ui_text_layouts ();
 u16  ui_button           (uiid id, String text, UI_Button_Style style);
 u16  ui_input_text       (uiid id, char *text, u32 size, UI_Input_Style style);
 u16  ui_input_f32        (uiid id, f32 *v, UI_Input_Style style);
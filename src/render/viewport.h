@@ -19,8 +19,6 @@ struct Viewport {
     Vector2 cursor_pos = Vector2_zero;
     
     Matrix4 orthographic_projection;
-
-    u32 framebuffer = 0;
     
     f32 pixel_size                  = 1.0f;
     f32 curve_distortion_factor     = 0.0f;
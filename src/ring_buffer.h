@@ -0,0 +1,111 @@
+#pragma once
+
+#include "memory.h"
+#include "atomic.h"
+
+// Byte ring buffer with its memory mapped twice in a row, so any write or read of
+// up to ring size is contiguous even if it wraps around the end, no split copies.
+// Producer reserves space, writes it in place and commits, consumer then peeks all
+// commited bytes and releases what it has processed. Offsets grow monotonically and
+// are wrapped only on access.
+//
+// Single consumer only, producers can be single (reserve_write) or multiple
+// (reserve_write_concurrent). Plain volatile access relies on msvc x86/x64
+// volatile semantics (acquire loads, release stores).
+struct Ring_Buffer {
+    u8 *data = null;
+    u64 size = 0;
+
+    volatile s64 write  = 0; // reserved by producers
+    volatile s64 commit = 0; // visible to consumer
+    volatile s64 read   = 0; // released by consumer
+};
+
+struct Ring_Write {
+    u8 *data   = null;
+    s64 offset = 0;
+    u64 size   = 0;
+};
+
+inline bool init(Ring_Buffer *ring, u64 size) {
+    Assert(!ring->data);
+    
+    size = Align(size, get_allocation_granularity());
+    Assert(Is_Power_Of_Two(size), "Ring buffer size must be power of two");
+
+    ring->data = (u8 *)virtual_reserve_ring(size);
+    if (!ring->data) {
+        log(LOG_ERROR, "Failed to reserve ring memory of size %llu bytes for ring buffer 0x%X", size, ring);
+        return false;
+    }
+
+    ring->size   = size;
+    ring->write  = 0;
+    ring->commit = 0;
+    ring->read   = 0;
+    
+    return true;
+}
+
+inline void release(Ring_Buffer *ring) {
+    if (!ring->data) return;
+    
+    if (!virtual_release_ring(ring->data, ring->size)) {
+        log(LOG_ERROR, "Failed to release ring memory 0x%X of size %llu bytes in ring buffer 0x%X", ring->data, ring->size, ring);
+        return;
+    }
+
+    ring->data = null;
+    ring->size = 0;
+}
+
+inline u8 *get_ring_data(const Ring_Buffer *ring, s64 offset) {
+    return ring->data + (offset & (ring->size - 1));
+}
+
+// Returns write with null data if there is not enough free space.
+inline Ring_Write reserve_write(Ring_Buffer *ring, u64 size) {
+    const s64 offset = ring->write;
+    if ((u64)(offset + size - ring->read) > ring->size) return {};
+    
+    ring->write = offset + size;
+    return { get_ring_data(ring, offset), offset, size };
+}
+
+inline Ring_Write reserve_write_concurrent(Ring_Buffer *ring, u64 size) {
+    while (1) {
+        const s64 offset = ring->write;
+        if ((u64)(offset + size - ring->read) > ring->size) return {};
+
+        if (atomic_cmp_swap((s64 *)&ring->write, offset + size, offset) == offset) {
+            return { get_ring_data(ring, offset), offset, size };
+        }
+    }
+}
+
+// Commits go in reservation order, so concurrent producer waits for previous ones.
+inline void commit_write(Ring_Buffer *ring, const Ring_Write &write) {
+    const s64 end = write.offset + write.size;
+    while (atomic_cmp_swap((s64 *)&ring->commit, end, write.offset) != write.offset) {}
+}
+
+inline Ring_Write reserve_and_copy(Ring_Buffer *ring, const void *data, u64 size) {
+    auto write = reserve_write(ring, size);
+    if (write.data) {
+        copy(write.data, data, size);
+        commit_write(ring, write);
+    }
+    return write;
+}
+
+// Returns commited data pointer and its size, contiguous due to memory mirror.
+inline u8 *peek_read(Ring_Buffer *ring, u64 *size) {
+    const s64 offset = ring->read;
+    *size = ring->commit - offset;
+    return get_ring_data(ring, offset);
+}
+
+inline void commit_read(Ring_Buffer *ring, u64 size) {
+    Assert((s64)(ring->read + size) <= ring->commit);
+    ring->read = ring->read + size;
+}
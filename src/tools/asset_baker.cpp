@@ -28,13 +28,9 @@ struct Asset_Set_Description {
     Catalog catalog;
 };
 
-struct Font_Bake_Data {
-    s32 pixel_height;
-    s32 width;
-    s32 height;
-};
-
 s32 main() {
+    init_cpu_timer();
+    
     set_process_cwd(get_process_directory());
 
     Asset_Set_Description sets[] = {
@@ -211,18 +207,16 @@ s32 main() {
         switch (set.asset_type) {
             // Font bake produces atlas images, so it should run before texture bake.
         case ASSET_TYPE_FONT: {
-            static u8              pixels[1 << 22];
-            static stbtt_bakedchar cdata [96]; // ASCII 32..126 is 95 glyphs
+            // Fonts are baked once to signed distance field atlas page, ui scales glyphs
+            // to any pixel height and shader reconstructs edges. Rest of page is left
+            // for glyphs rasterized at runtime from font file that is baked along.
+            static u8 pixels[FONT_PAGE_SIZE * FONT_PAGE_SIZE];
 
-            static const Font_Bake_Data font_bake_data[] = {
-                { 16, 128, 128 },
-                { 24, 256, 256 },
-            };
+            const auto first_char = 32;
+            const auto char_count = 95; // ASCII 32..126
             
             For (set.catalog.entries) {
                 const auto buffer = read_file(it.path, __temporary_allocator);
-                const auto first_char = 32;
-                const auto char_count = carray_count(cdata);
 
                 stbtt_fontinfo font;
                 if (!stbtt_InitFont(&font, buffer.data, 0)) {
@@ -233,84 +227,115 @@ s32 main() {
                 s32 ascent, descent, line_gap;
                 stbtt_GetFontVMetrics(&font, &ascent, &descent, &line_gap);
 
-                for (u32 j = 0; j < carray_count(font_bake_data); ++j) {
-                    const auto &bake_data   = font_bake_data[j];
-                    const auto pixel_height = bake_data.pixel_height;
-                    const auto width        = bake_data.width;
-                    const auto height       = bake_data.height;
+                const auto px_h_scale = stbtt_ScaleForPixelHeight(&font, (float)FONT_SDF_PIXEL_HEIGHT);
+                const auto dist_scale = (f32)FONT_SDF_ON_EDGE / FONT_SDF_PADDING;
+
+                set(pixels, 0, sizeof(pixels));
+                
+                // Glyphs are packed to rows from top left with 1 pixel gap, so
+                // linear filter does not pick neighbours.
+                auto glyphs = New(Glyph, char_count, __temporary_allocator);
+                s32 x = 1, y = 1, row_height = 0;
+                bool packed = true;
+                
+                for (s32 j = 0; j < char_count; ++j) {
+                    const auto codepoint = first_char + j;
+                    auto &glyph = glyphs[j];
+                    
+                    s32 advance, left_side_bearing;
+                    stbtt_GetCodepointHMetrics(&font, codepoint, &advance, &left_side_bearing);
 
-                    const auto atlas_dir  = DIR_TEXTURES;
-                    const auto atlas_name = get_file_name_no_ext(it.path);
-                    const auto atlas_ext  = S(".png");
-                    const auto atlas_path = tprint("%S%S_%d%S", atlas_dir, atlas_name, pixel_height, atlas_ext);
+                    glyph = {};
+                    glyph.xadvance = advance * px_h_scale;
                     
-                    const auto stbtt_n = stbtt_BakeFontBitmap(buffer.data, 0, (float)pixel_height,
-                                                              pixels, width, height,
-                                                              first_char, char_count, cdata);
-                    if (stbtt_n == 0) {
-                        print("[stbtt] Failed to bake %S\n", it.path);
-                        continue;
+                    s32 w, h, xoff, yoff;
+                    auto sdf = stbtt_GetCodepointSDF(&font, px_h_scale, codepoint, FONT_SDF_PADDING, FONT_SDF_ON_EDGE, dist_scale, &w, &h, &xoff, &yoff);
+                    if (!sdf) continue; // empty glyph, like space
+
+                    if (x + w + 1 > FONT_PAGE_SIZE) {
+                        x = 1;
+                        y += row_height + 1;
+                        row_height = 0;
                     }
 
-                    const auto atlas_cpath = temp_c_string(atlas_path);
-                    if (!stbi_write_png(atlas_cpath, width, abs(stbtt_n), 1, pixels, width * sizeof(pixels[0]))) {
-                        print("[stbi] Failed to bake %S\n", atlas_path);
-                        continue;
+                    if (y + h + 1 > FONT_PAGE_SIZE) {
+                        stbtt_FreeSDF(sdf, null);
+                        packed = false;
+                        break;
                     }
 
-                    // Find texture catalog and add baked font atlas image there.
-                    for (s32 k = i; k < carray_count(sets); ++k) {
-                        auto &set = sets[k];
-                        if (set.asset_type == ASSET_TYPE_TEXTURE) {
-                            Catalog_Entry entry;
-                            entry.path = atlas_path;
-                            entry.name = atlas_name;
-                            // @Todo: fix entry add if baked atlases already exist on disk.
-                            add_entry(&set.catalog, entry);
-                        }
+                    for (s32 row = 0; row < h; ++row) {
+                        copy(pixels + (y + row) * FONT_PAGE_SIZE + x, sdf + row * w, w);
                     }
+                    
+                    stbtt_FreeSDF(sdf, null);
 
-                    const auto px_h_scale  = stbtt_ScaleForPixelHeight(&font, (float)pixel_height);
-                    const auto line_height = (s32)((ascent - descent + line_gap) * px_h_scale);
-
-                    Baked_Font_Meta meta;
-                    meta.atlas_path_size = (u32)atlas_path.size;
-                    meta.start_charcode  = first_char;
-                    meta.charcode_count  = char_count;
-                    meta.ascent          = ascent;
-                    meta.descent         = descent;
-                    meta.line_gap        = line_gap;
-                    meta.px_h_scale      = px_h_scale;
-                    meta.px_height       = pixel_height;
-                    meta.line_height     = line_height;
-
-                    // Ensure correct glyphs.
-                    auto glyphs = New(Glyph, meta.charcode_count, __temporary_allocator);
-                    for (u32 i = 0; i < meta.charcode_count; ++i) {
-                        glyphs[i].x0       = cdata[i].x0;
-                        glyphs[i].y0       = cdata[i].y0;
-                        glyphs[i].x1       = cdata[i].x1;
-                        glyphs[i].y1       = cdata[i].y1;
-                        glyphs[i].xoff     = cdata[i].xoff;
-                        glyphs[i].yoff     = cdata[i].yoff;
-                        glyphs[i].xadvance = cdata[i].xadvance;
-                    }
+                    glyph.x0   = (u16)x;
+                    glyph.y0   = (u16)y;
+                    glyph.x1   = (u16)(x + w);
+                    glyph.y1   = (u16)(y + h);
+                    glyph.xoff = (f32)xoff;
+                    glyph.yoff = (f32)yoff;
 
-                    String_Builder sb;
-                    sb.allocator = __temporary_allocator;
+                    x += w + 1;
+                    row_height = Max(row_height, h);
+                }
 
-                    put   (sb, meta);
-                    append(sb, atlas_path.data, atlas_path.size);                    
-                    append(sb, glyphs, meta.charcode_count * sizeof(glyphs[0]));
+                if (!packed) {
+                    print("[stbtt] Failed to pack %S to %dx%d atlas\n", it.path, FONT_PAGE_SIZE, FONT_PAGE_SIZE);
+                    continue;
+                }
 
-                    const auto meta_dir  = DIR_FONTS;
-                    const auto meta_name = get_file_name_no_ext(it.path);
-                    const auto meta_ext  = get_extension(it.path);
-                    const auto meta_path = tprint("%S%S_%d.%S", meta_dir, meta_name, pixel_height, meta_ext);
-                    
-                    const auto baked_font_meta = make_buffer(builder_to_string(sb));
-                    save_to_pak(meta_path, baked_font_meta, ASSET_TYPE_FONT);
+                const auto atlas_dir    = DIR_TEXTURES;
+                const auto atlas_name   = get_file_name_no_ext(it.path);
+                const auto atlas_ext    = S(".png");
+                const auto atlas_path   = tprint("%S%S_sdf%S", atlas_dir, atlas_name, atlas_ext);
+                
+                const auto atlas_cpath = temp_c_string(atlas_path);
+                if (!stbi_write_png(atlas_cpath, FONT_PAGE_SIZE, FONT_PAGE_SIZE, 1, pixels, FONT_PAGE_SIZE * sizeof(pixels[0]))) {
+                    print("[stbi] Failed to bake %S\n", atlas_path);
+                    continue;
+                }
+
+                // Find texture catalog and add baked font atlas image there.
+                for (s32 k = i; k < carray_count(sets); ++k) {
+                    auto &set = sets[k];
+                    if (set.asset_type == ASSET_TYPE_TEXTURE) {
+                        Catalog_Entry entry;
+                        entry.path = atlas_path;
+                        entry.name = atlas_name;
+                        // @Todo: fix entry add if baked atlases already exist on disk.
+                        add_entry(&set.catalog, entry);
+                    }
                 }
+
+                Baked_Font_Meta meta;
+                meta.atlas_path_size = (u32)atlas_path.size;
+                meta.start_charcode  = first_char;
+                meta.charcode_count  = char_count;
+                meta.ascent          = ascent;
+                meta.descent         = descent;
+                meta.line_gap        = line_gap;
+                meta.px_h_scale      = px_h_scale;
+                meta.px_height       = FONT_SDF_PIXEL_HEIGHT;
+                meta.line_height     = (s32)((ascent - descent + line_gap) * px_h_scale);
+                meta.font_file_size  = (u32)buffer.size;
+
+                String_Builder sb;
+                sb.allocator = __temporary_allocator;
+
+                put   (sb, meta);
+                append(sb, atlas_path.data, atlas_path.size);                    
+                append(sb, glyphs, meta.charcode_count * sizeof(glyphs[0]));
+                append(sb, buffer.data, buffer.size);
+
+                const auto meta_dir  = DIR_FONTS;
+                const auto meta_name = get_file_name_no_ext(it.path);
+                const auto meta_ext  = get_extension(it.path);
+                const auto meta_path = tprint("%S%S_sdf.%S", meta_dir, meta_name, meta_ext);
+                    
+                const auto baked_font_meta = make_buffer(builder_to_string(sb));
+                save_to_pak(meta_path, baked_font_meta, ASSET_TYPE_FONT);
             }
             
             break;
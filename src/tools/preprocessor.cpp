@@ -153,6 +153,8 @@ void reflection_pass() {
 }
 
 s32 main() {
+    init_cpu_timer();
+    
     set_process_cwd(get_process_directory());
 
     reflection_pass();
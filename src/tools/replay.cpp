@@ -0,0 +1,163 @@
+#define SPRINTF_CUSTOM_STRING
+
+#include "basic.cpp"
+#include "os.cpp"
+
+#ifdef _WIN32
+#pragma comment(lib, "user32.lib")
+#pragma comment(lib, "kernel32.lib")
+#pragma comment(lib, "shell32.lib")
+#pragma comment(lib, "shlwapi.lib")
+#pragma comment(lib, "dbghelp.lib")
+#include "win32.cpp"
+#endif
+
+#include "cpu_time.h"
+#include "gpu_command.cpp"
+
+#include <stdlib.h>
+
+// Replays gpu capture saved by capture_gpu console command against stub backend,
+// that only decodes commands and validates them against captured resources, so
+// render cpu side changes can be measured on the same fixed workload. Time of each
+// command type is its decode and validation, stub does no driver work.
+//
+// Usage: replay capture_path [loop_count]
+
+struct Replay_Stats {
+    u64 counts [GPU_CMD_COUNT] = {};
+    u64 cycles [GPU_CMD_COUNT] = {};
+    u32 validation_error_count = 0;
+};
+
+static bool replay_validate(Replay_Stats &stats, bool condition) {
+    if (condition) return true;
+    stats.validation_error_count += 1;
+    return false;
+}
+
+static bool replay_validate_range(Replay_Stats &stats, const Gpu_Capture &capture, const Gpu_Command &cmd) {
+    if (!replay_validate(stats, cmd.bind_resource < capture.buffers.count)) return false;
+
+    const auto &buffer = capture.buffers[cmd.bind_resource];
+    return replay_validate(stats, cmd.bind_offset + cmd.bind_size <= buffer.size);
+}
+
+static void replay_cmd(Replay_Stats &stats, const Gpu_Capture &capture, const Gpu_Command &cmd) {
+    switch (cmd.type) {
+    case GPU_CMD_NONE: {
+        replay_validate(stats, false);
+        break;
+    }
+    case GPU_CMD_MEMORY_BARRIER: {
+        break;
+    }
+    case GPU_CMD_COPY_BUFFER: {
+        replay_validate(stats, cmd.copy_src < capture.buffers.count && cmd.copy_dst < capture.buffers.count);
+        break;
+    }
+    case GPU_CMD_IMAGE_VIEW: {
+        replay_validate(stats, cmd.bind_resource < capture.image_views.count);
+        break;
+    }
+    case GPU_CMD_SAMPLER: {
+        replay_validate(stats, cmd.bind_resource < capture.samplers.count);
+        break;
+    }
+    case GPU_CMD_VERTEX_INPUT: {
+        replay_validate(stats, cmd.bind_resource < capture.vertex_inputs.count);
+        break;
+    }
+    case GPU_CMD_FRAMEBUFFER: {
+        replay_validate(stats, cmd.bind_resource < capture.framebuffers.count);
+        break;
+    }
+    case GPU_CMD_VERTEX_BUFFER:
+    case GPU_CMD_INDEX_BUFFER: {
+        replay_validate(stats, cmd.bind_resource < capture.buffers.count);
+        break;
+    }
+    case GPU_CMD_CBUFFER_INSTANCE:
+    case GPU_CMD_STORAGE_BUFFER: {
+        replay_validate_range(stats, capture, cmd);
+        break;
+    }
+    case GPU_CMD_DRAW:
+    case GPU_CMD_DRAW_INDEXED: {
+        replay_validate(stats, cmd.draw_count && cmd.instance_count);
+        break;
+    }
+    case GPU_CMD_DRAW_INDIRECT:
+    case GPU_CMD_DRAW_INDEXED_INDIRECT: {
+        replay_validate(stats, cmd.indirect_count && cmd.indirect_buffer < capture.buffers.count);
+        break;
+    }
+    }
+}
+
+s32 main(s32 argc, char **argv) {
+    if (argc < 2) {
+        print("Usage: replay capture_path [loop_count]\n");
+        return 1;
+    }
+
+    init_cpu_timer();
+
+    const auto path       = make_string(argv[1]);
+    const u32  loop_count = argc > 2 ? (u32)Max(atoi(argv[2]), 1) : 1000;
+
+    Gpu_Capture capture;
+    if (!load_gpu_capture(path, &capture)) {
+        print("Failed to load gpu capture %S\n", path);
+        return 1;
+    }
+
+    const auto &header = capture.header;
+    print("Loaded %S of frame %llu, %u commands (%llu bytes), %u buffers, %u images, %u image views, %u samplers, %u framebuffers, %u vertex inputs\n\n",
+          path, header.frame_index, header.command_count, header.command_size,
+          header.buffer_count, header.image_count, header.image_view_count,
+          header.sampler_count, header.framebuffer_count, header.vertex_input_count);
+
+    Replay_Stats stats;
+    u64 min_loop_cycles   = U64_MAX;
+    u64 total_loop_cycles = 0;
+
+    for (u32 i = 0; i < loop_count; ++i) {
+        const u64 loop_start = get_cpu_cycles();
+        u64 start = loop_start;
+
+        auto it = gpu_iterate_cmds(&capture);
+        Gpu_Command cmd;
+
+        while (gpu_next_cmd(&it, &cmd)) {
+            replay_cmd(stats, capture, cmd);
+
+            const u64 end = get_cpu_cycles();
+            stats.counts[cmd.type] += 1;
+            stats.cycles[cmd.type] += end - start;
+            start = end;
+        }
+
+        const u64 loop_cycles = start - loop_start;
+        min_loop_cycles    = Min(min_loop_cycles, loop_cycles);
+        total_loop_cycles += loop_cycles;
+    }
+
+    print("%-24s %10s %12s %10s\n", "command", "count", "total ms", "ns/cmd");
+
+    for (u32 i = 0; i < GPU_CMD_COUNT; ++i) {
+        const auto count = stats.counts[i] / loop_count;
+        if (!count) continue;
+
+        const f64 total_ns = (f64)cycles_to_ns(stats.cycles[i]);
+        print("%-24s %10llu %12.3f %10.2f\n", temp_c_string(to_string((Gpu_Command_Type)i)),
+              count, total_ns / 1000000.0 / loop_count, total_ns / stats.counts[i]);
+    }
+
+    print("\nReplayed %u times, frame min %.3fms avg %.3fms, %u validation errors\n",
+          loop_count, cycles_to_ns(min_loop_cycles) / 1000000.0,
+          cycles_to_ns(total_loop_cycles) / 1000000.0 / loop_count,
+          stats.validation_error_count / loop_count);
+
+    return stats.validation_error_count ? 1 : 0;
+}
@@ -15,6 +15,13 @@ struct Virtual_Arena {
     u64 reserve_size      = VIRTUAL_ARENA_RESERVE_SIZE;
     u64 commit_alignment  = get_page_size();
     u64 alignment         = VIRTUAL_ARENA_ALIGNMENT;
+
+    // Try to back whole reserve by large pages, falls back to regular ones if failed.
+    // Large pages are commited once on reserve and never decommited. Fallback is
+    // silent as arena may be reserved from inside allocation of logger, check
+    // large_pages after reserve instead.
+    bool use_large_pages = false;
+    bool large_pages     = false;
     
     void *base     = null;
     u64   reserved = 0;
@@ -24,6 +31,21 @@ struct Virtual_Arena {
 
 inline bool reserve(Virtual_Arena *arena, u64 size) {
     Assert(!arena->base);
+
+    if (arena->use_large_pages) {
+        const auto page_size = get_large_page_size();
+        if (page_size) {
+            const auto large_size = Align(size, page_size);
+            arena->base = virtual_reserve_large(null, large_size);
+            
+            if (arena->base) {
+                arena->large_pages = true;
+                arena->reserved    = large_size;
+                arena->commited    = large_size;
+                return true;
+            }
+        }
+    }
     
     size = Align(size, arena->reserve_alignment);
     arena->base = virtual_reserve(null, size);
@@ -80,6 +102,11 @@ inline void *get(Virtual_Arena *arena, u64 size) {
 }
 
 inline void reset(Virtual_Arena *arena) {
+    if (arena->large_pages) {
+        arena->used = 0;
+        return;
+    }
+    
     if (!virtual_decommit(arena->base, arena->commited)) {
         log(LOG_ERROR, "Failed to decommit virtual memory 0x%X of size %llu bytes in virtual arena 0x%X", arena->base, arena->commited, arena);
         return;
@@ -97,10 +124,11 @@ inline void release(Virtual_Arena *arena) {
         return;
     }
 
-    arena->base     = null;
-    arena->reserved = 0;
-    arena->commited = 0;
-    arena->used     = 0;
+    arena->base        = null;
+    arena->reserved    = 0;
+    arena->commited    = 0;
+    arena->used        = 0;
+    arena->large_pages = false;
 }
 
 inline void *virtual_arena_allocator_proc(Allocator_Mode mode, u64 size, u64 old_size, void *old_memory, void *allocator_data) {